@@ -0,0 +1,137 @@
+//
+//  bench_json.cpp
+//  Routes
+//
+
+#include <serialize/json.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/**
+ * Builds the response the way the server did before the JSON writer, with string concatenation and std::to_string.
+ *
+ * @param evaluated
+ * The points on the curve
+ *
+ * @param elevations
+ * The elevations along the curve
+ *
+ * @return
+ * The response
+ */
+static std::string concatenate(const std::vector<glm::vec3>& evaluated, const std::vector<glm::vec2>& elevations) {
+
+    std::string JSON = "   [";
+
+    for (size_t i = 0; i < evaluated.size(); i++) {
+
+        if (i)
+            JSON += "    ";
+
+        JSON += "[" + std::to_string(evaluated[i].x) + ", " +
+                std::to_string(evaluated[i].y) + ", " +
+                std::to_string(evaluated[i].z) + "]";
+
+        if (i != evaluated.size() - 1)
+            JSON += ", \n";
+
+    }
+
+    JSON += "]   [";
+
+    for (size_t i = 0; i < elevations.size(); i++) {
+
+        if (i)
+            JSON += "    ";
+
+        JSON += "[" + std::to_string(elevations[i].x) + ", " + std::to_string(elevations[i].y) + "]";
+
+        if (i != elevations.size() - 1)
+            JSON += ", \n";
+
+    }
+
+    JSON += "]";
+
+    return JSON;
+
+}
+
+/**
+ * Builds the same response with the JSON writer.
+ *
+ * @param evaluated
+ * The points on the curve
+ *
+ * @param elevations
+ * The elevations along the curve
+ *
+ * @param compact
+ * Whether to leave out the whitespace
+ *
+ * @return
+ * The response
+ */
+static std::string write(const std::vector<glm::vec3>& evaluated, const std::vector<glm::vec2>& elevations,
+                         bool compact) {
+
+    JSONWriter writer = JSONWriter(compact, evaluated.size() * 40 + elevations.size() * 30);
+
+    writer.beginArray();
+    writer.value(evaluated);
+    writer.value(elevations);
+    writer.endArray();
+
+    return writer.str();
+
+}
+
+/**
+ * Times how long it takes to build the response of a route with the old concatenation and with the JSON writer, and
+ * how big each response is. This is not a test, it only reports.
+ *
+ * Usage: Routes-Bench [runs]
+ */
+int main(int argc, const char* argv[]) {
+
+    int runs = argc > 1 ? std::max(std::atoi(argv[1]), 1) : 20;
+
+    // A route is usually about this big
+    std::vector<glm::vec3> evaluated;
+    std::vector<glm::vec2> elevations;
+
+    for (int i = 0; i < 2400; i++) {
+        evaluated.push_back(glm::vec3(-122.41942f + i * 1e-4f, 37.77493f + i * 1e-4f, 12.5f + i));
+        elevations.push_back(glm::vec2(i * 173.2f, 12.5f + i));
+    }
+
+    // Times one way of building the response and prints the average
+    auto time = [&](const std::string& name, const std::function<std::string()>& build) {
+
+        size_t size = 0;
+
+        auto start = std::chrono::high_resolution_clock::now();
+
+        for (int run = 0; run < runs; run++)
+            size = build().size();
+
+        auto elapsed = std::chrono::high_resolution_clock::now() - start;
+
+        std::cout << name << ": " << std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() / runs
+                  << "us " << size << " bytes" << std::endl;
+
+    };
+
+    time("Concatenation", [&] { return concatenate(evaluated, elevations); });
+    time("JSONWriter, indented", [&] { return write(evaluated, elevations, false); });
+    time("JSONWriter, compact", [&] { return write(evaluated, elevations, true); });
+
+    return 0;
+
+}
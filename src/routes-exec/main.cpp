@@ -61,9 +61,21 @@ int main(int argc, const char* argv[]) {
 
             #endif
 
+            // Convert the virtual dataset into tiles that can be mapped straight into memory
+            try {
+
+                TileStore::build(GDAL_DB_PATH, TILE_STORE_PATH);
+
+            } catch (const std::exception& e) {
+                std::cerr << e.what() << std::endl;
+            }
+
             break;
 
     }
 
+    // Join the history writer so the process can exit
+    GenerationLogger::stop();
+
     return 0;
 }
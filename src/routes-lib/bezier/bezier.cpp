@@ -4,15 +4,19 @@
 
 #include "bezier.h"
 
-std::map<int, std::vector<int>> Bezier::binomial_coeffs;
+std::map<int, std::vector<double>> Bezier::binomial_coeffs;
+std::mutex Bezier::binomial_lock;
 
-const std::vector<int>& Bezier::getBinomialCoefficients(int degree) {
+const std::vector<double>& Bezier::getBinomialCoefficients(int degree) {
+
+    // Several routes may be calculated at once. Map references stay valid after an insert so only the lookup is locked
+    std::lock_guard<std::mutex> lock(binomial_lock);
 
     // These will be reused several times so there is no point in recalculating them
     if (!binomial_coeffs.count(degree)) {
         
         // We use degree + 1 because a bezier curve has degree + 1 terms
-        binomial_coeffs[degree] = std::vector<int>(degree + 1);
+        binomial_coeffs[degree] = std::vector<double>(degree + 1);
         
         // Fill it
         for (int i = 0; i < degree + 1; i++)
@@ -24,14 +28,43 @@ const std::vector<int>& Bezier::getBinomialCoefficients(int degree) {
 
 }
 
+void Bezier::calcBernsteinWeights(int degree, double s, std::vector<double>& weights) {
+
+    weights.resize((size_t)degree + 1);
+
+    double one_minus_s = 1.0 - s;
+
+    if (s <= 0.5) {
+
+        // Start with the first weight, (1 - s)^degree, and work forwards. The weights next to each other differ by
+        // (degree - i) / (i + 1) * s / (1 - s)
+        double ratio = s / one_minus_s;
+        weights[0] = std::pow(one_minus_s, degree);
+
+        for (int i = 0; i < degree; i++)
+            weights[i + 1] = weights[i] * ratio * (degree - i) / (i + 1);
+
+    } else {
+
+        // Same thing from the other end so that the ratio never divides by something close to zero
+        double ratio = one_minus_s / s;
+        weights[degree] = std::pow(s, degree);
+
+        for (int i = degree; i > 0; i--)
+            weights[i - 1] = weights[i] * ratio * i / (degree - i + 1);
+
+    }
+
+}
+
 glm::vec3 Bezier::evaluateBezierCurve(const std::vector<glm::vec3>& points, float s) {
 
-    // Get the degree of the curve and the binomials that correspond to it 
+    // Get the degree of the curve
     int degree = points.size() - 1;
-    const std::vector<int>& binoms = getBinomialCoefficients(degree);
+    std::vector<double> weights;
 
     glm::vec3 point = glm::vec3(0.0, 0.0, 0.0);
-    doEvaluate(point, s, degree, points, binoms);
+    doEvaluate(point, s, degree, points, weights);
     
     return point;
 
@@ -39,9 +72,9 @@ glm::vec3 Bezier::evaluateBezierCurve(const std::vector<glm::vec3>& points, floa
 
 std::vector<glm::vec3> Bezier::evaluateEntireBezierCurve(const std::vector<glm::vec3>& points, int num_desired) {
 
-    // Get the degree of the curve and the binomials that correspond to it 
+    // Get the degree of the curve, the weights are reused for every point
     int degree = points.size() - 1;
-    const std::vector<int>& binoms = getBinomialCoefficients(degree);
+    std::vector<double> weights;
 
     // Figure out how far along the curve each point is. We use num_desired - 1 as the divisor so that we make sure we evaluate at 1
     std::vector<glm::vec3> points_calc = std::vector<glm::vec3>(num_desired, {0,0,0});
@@ -49,7 +82,7 @@ std::vector<glm::vec3> Bezier::evaluateEntireBezierCurve(const std::vector<glm::
     for (int p = 0; p < num_desired; p++) {
 
         float s = (float)p / (float)(num_desired - 1);
-        doEvaluate(points_calc[p], s, degree, points, binoms);
+        doEvaluate(points_calc[p], s, degree, points, weights);
 
     }
 
@@ -57,6 +90,25 @@ std::vector<glm::vec3> Bezier::evaluateEntireBezierCurve(const std::vector<glm::
 
 }
 
+std::vector<float> Bezier::calcBernsteinBasis(int degree, int num_rows, float num_points_1) {
+
+    std::vector<float> basis = std::vector<float>((size_t)num_rows * (degree + 1));
+    std::vector<double> weights;
+
+    for (int p = 0; p < num_rows; p++) {
+
+        // This is only done once so it can be done in double precision
+        calcBernsteinWeights(degree, (double)p / num_points_1, weights);
+
+        for (int i = 0; i <= degree; i++)
+            basis[p * (degree + 1) + i] = (float)weights[i];
+
+    }
+
+    return basis;
+
+}
+
 float Bezier::bezierLength(const std::vector<glm::vec3>& points) {
     
     float length = 0.0;
@@ -114,42 +166,28 @@ float Bezier::avgDistanceBetweenPoints(const std::vector<glm::vec3>& points) {
 
 }
 
-void Bezier::doEvaluate(glm::vec3& out_point, float s, int degree, const std::vector<glm::vec3>& controls, const std::vector<int>& binoms) {
-    
-    float one_minus_s = 1.0 - s;
+void Bezier::doEvaluate(glm::vec3& out_point, float s, int degree, const std::vector<glm::vec3>& controls, std::vector<double>& weights) {
     
     // Evaluate using the explicit definition of a bezier curve https://en.wikipedia.org/wiki/Bézier_curve#Explicit_definition
-    for (int i = 0; i < controls.size(); i++) {
-        
-        float t_and_one_minus = glm::pow(one_minus_s, degree - i) * glm::pow(s, i);
-        out_point += controls[i] * t_and_one_minus * (float)binoms[i];
-        
-    }
+    calcBernsteinWeights(degree, s, weights);
+
+    for (int i = 0; i < controls.size(); i++)
+        out_point += controls[i] * (float)weights[i];
     
 }
 
-int Bezier::calcBinomialCoefficient(int n, int i) {
+double Bezier::calcBinomialCoefficient(int n, int i) {
 
-    // Special case to prevent divide by zero
-    if (!i || n == i)
-        return 1;
+    // The coefficients are symmetric so use the side with fewer steps
+    i = std::min(i, n - i);
+
+    // Multiplicative formula https://en.wikipedia.org/wiki/Binomial_coefficient#Multiplicative_formula
+    // Every partial product is itself a binomial coefficient so nothing is rounded until they get very large
+    double coefficient = 1.0;
+
+    for (int j = 0; j < i; j++)
+        coefficient = coefficient * (n - j) / (j + 1);
+
+    return coefficient;
 
-    // We run into integer overflow issues with large numbers for n and i so we use pascal's triangle for anything > 20
-    if (n > 20)
-        return calcBinomialCoefficient(n - 1, i - 1) + calcBinomialCoefficient(n - 1, i);
-    
-    // Formula taken from https://en.wikipedia.org/wiki/Binomial_coefficient#Multiplicative_formula
-    unsigned long long ni_falling = n;
-    unsigned long long i_fac = i;
-    
-    // Calculate i!
-    for (int j = 1; j < i - 1; j++)
-        i_fac *= (i - j);
-    
-    // Calculate n falling factorial i
-    for (int j = 1; j < i; j++)
-        ni_falling *= (n - j);
-    
-    return ni_falling / i_fac;
-    
 }
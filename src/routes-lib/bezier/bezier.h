@@ -6,8 +6,11 @@
 #define ROUTES_BEZIER_H
 
 #include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <map>
+#include <mutex>
 #include <vector>
 #include <unordered_map>
 
@@ -24,9 +27,26 @@ class Bezier {
          * The degree of the bezier curve, this is 1 - num_points
          *
          * @return
-         * The complete array of binomial coefficients, should be of degree length + 1.
+         * The complete array of binomial coefficients, should be of degree length + 1. These are doubles so that
+         * they don't overflow for high degrees.
          */
-        static const std::vector<int>& getBinomialCoefficients(int degree);
+        static const std::vector<double>& getBinomialCoefficients(int degree);
+
+        /**
+         * Calculates the Bernstein basis polynomials of every control point at a single parametric value. Rather
+         * than multiplying huge binomial coefficients by tiny powers, this starts from the end of the curve that is
+         * closest to s and multiplies by the ratio between neighbouring weights, which stays small for any degree.
+         *
+         * @param degree
+         * The degree of the bezier curve, this is 1 - num_points
+         *
+         * @param s
+         * The parametric parameter; in other words how far along the curve to evaluate.
+         *
+         * @param weights
+         * Resized to degree + 1 and set to the weight of every control point
+         */
+        static void calcBernsteinWeights(int degree, double s, std::vector<double>& weights);
 
         /**
          * This evaluates a bezier curve at a given point on the curve.
@@ -58,6 +78,25 @@ class Bezier {
          */
         static std::vector<glm::vec3> evaluateEntireBezierCurve(const std::vector<glm::vec3>& points, int num_desired);
     
+        /**
+         * Calculates the Bernstein basis polynomials of every control point at evenly spaced parametric values.
+         * Since these only depend on the degree and the spacing, they can be calculated once and then every curve
+         * with that degree can be evaluated with a weighted sum of its control points.
+         *
+         * @param degree
+         * The degree of the bezier curve, this is 1 - num_points
+         *
+         * @param num_rows
+         * The number of parametric values to calculate the basis at
+         *
+         * @param num_points_1
+         * The divisor of the parametric values, row p is at s = p / num_points_1
+         *
+         * @return
+         * num_rows rows of degree + 1 weights, one for each control point
+         */
+        static std::vector<float> calcBernsteinBasis(int degree, int num_rows, float num_points_1);
+
         /**
          * Used to calculated a binomial coefficient for the given n and i.
          *
@@ -70,7 +109,7 @@ class Bezier {
          * @return
          * The binomial coefficient.
          */
-        static int calcBinomialCoefficient(int n, int i);
+        static double calcBinomialCoefficient(int n, int i);
 
         /**
          * Calculates the approximate length of a bezier curve. Calculates using the sum of the straight line distances of the given points.
@@ -164,18 +203,21 @@ class Bezier {
          * @param controls
          * The control points of the curve that should be evaluated.
          *
-         * @param binoms
-         * The binomial coefficients for the curve of the given degree.
+         * @param weights
+         * Space for the weights of the control points so that it doesn't need to be allocated for every point.
          *
          */
-         static void doEvaluate(glm::vec3& out_point, float s, int degree, const std::vector<glm::vec3>& controls, const std::vector<int>& binoms);
+         static void doEvaluate(glm::vec3& out_point, float s, int degree, const std::vector<glm::vec3>& controls, std::vector<double>& weights);
 
         /**
          * Binomial coefficients don't change between two bezier curves of the same degree. Therefore
          * We save all the sets of the binomial coefficients that are calculated so we don't had to
          * do it again.
          */
-        static std::map<int, std::vector<int>> binomial_coeffs;
+        static std::map<int, std::vector<double>> binomial_coeffs;
+
+        /** Guards binomial_coeffs so that multiple threads can evaluate curves at once */
+        static std::mutex binomial_lock;
 
 };
 
@@ -4,20 +4,20 @@
 
 #include "configure.h"
 
-Configuration Configure::_config;
+Configure::Configure() : Configure(FILE_PATH) {}
 
-Configure::Configure() {
+Configure::Configure(const std::string& path) {
 
-    loadConfig();
+    loadConfig(path);
 
 }
 
-void Configure::loadConfig() {
+void Configure::loadConfig(const std::string& path) {
 
 
     boost::property_tree::ptree root;
 
-    boost::property_tree::read_json(FILE_PATH, root);
+    boost::property_tree::read_json(path, root);
 
     // if 0, then reload, if 1 then don't
     int reload = root.get<int>("reload", 0);
@@ -35,12 +35,30 @@ void Configure::loadConfig() {
     float curve_weight = root.get<float>("cost.curve-weight", 0);
     float grade_weight = root.get<float>("cost.grade-weight", 0);
     float length_weight = root.get<float>("cost.length-weight", 0);
+    int num_server_workers = root.get<int>("server.num-workers", 1);
+    int cache_shards = root.get<int>("server.cache-shards", 16);
+    int cache_memory_mb = root.get<int>("server.cache-memory-mb", 256);
+    int cache_ttl = root.get<int>("server.cache-ttl", 3600);
+    int node_id = root.get<int>("server.node-id", 0);
+    float request_precision = root.get<float>("server.request-precision", 0.0001f);
+    std::string persist_directory = root.get<std::string>("server.persist-directory", "");
+    int pipeline_chunks = root.get<int>("population.pipeline-chunks", 1);
+    std::string curve_type = root.get<std::string>("routes.curve-type", "bezier");
+    std::string terrain_filter = root.get<std::string>("cost.terrain-filter", "nearest");
+    int pyramid_levels = root.get<int>("routes.pyramid-levels", 1);
+    float coarse_fraction = root.get<float>("routes.coarse-fraction", 0.25f);
+    std::string cost_backend = root.get<std::string>("cost.backend", "opencl");
+    int decomposition_interval = root.get<int>("population.decomposition-interval", 0);
 
     _config = {reload, population_size, num_generations,
                use_db, initial_sigma_divisor, initial_sigma_xy,
                step_dampening, alpha, num_sample_threads,
                num_route_workers, track_weight, curve_weight,
-               grade_weight, length_weight};
+               grade_weight, length_weight, num_server_workers,
+               cache_shards, cache_memory_mb, cache_ttl, node_id,
+               request_precision, persist_directory, pipeline_chunks,
+               curve_type, terrain_filter, pyramid_levels,
+               coarse_fraction, cost_backend, decomposition_interval};
 
 
 
@@ -100,4 +118,112 @@ float Configure::getGradeWeight() {
 
 float Configure::getLengthWeight() {
     return _config.length_weight;
-}
\ No newline at end of file
+}
+
+int Configure::getNumServerWorkers() {
+    return _config.num_server_workers;
+}
+
+int Configure::getCacheShards() {
+    return _config.cache_shards;
+}
+
+int Configure::getCacheMemoryMB() {
+    return _config.cache_memory_mb;
+}
+
+int Configure::getCacheTTL() {
+    return _config.cache_ttl;
+}
+
+int Configure::getNodeId() {
+    return _config.node_id;
+}
+
+float Configure::getRequestPrecision() {
+    return _config.request_precision;
+}
+
+std::string Configure::getPersistDirectory() {
+    return _config.persist_directory;
+}
+
+int Configure::getPipelineChunks() {
+    return _config.pipeline_chunks;
+}
+
+std::string Configure::getCurveType() {
+    return _config.curve_type;
+}
+
+std::string Configure::getTerrainFilter() {
+    return _config.terrain_filter;
+}
+
+int Configure::getPyramidLevels() {
+    return _config.pyramid_levels;
+}
+
+float Configure::getCoarseFraction() {
+    return _config.coarse_fraction;
+}
+
+std::string Configure::getCostBackend() {
+    return _config.cost_backend;
+}
+
+int Configure::getDecompositionInterval() {
+    return _config.decomposition_interval;
+}
+
+uint64_t Configure::hash() {
+
+    // 64 bit FNV-1a over a fixed byte layout. Routes are saved in files named after this, so it has to come out
+    // the same with every compiler and standard library, which std::hash doesn't
+    uint64_t hash = 0xCBF29CE484222325ull;
+
+    auto byte = [&hash](uint8_t value) {
+        hash = (hash ^ value) * 0x100000001B3ull;
+    };
+
+    // Integers and floats go in little endian whatever the machine is
+    auto integer = [&byte](uint32_t value) {
+        for (int i = 0; i < 4; i++)
+            byte((uint8_t)(value >> (i * 8)));
+    };
+
+    auto real = [&integer](float value) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        integer(bits);
+    };
+
+    // The length goes first so that neighbouring strings can't run into each other
+    auto text = [&integer, &byte](const std::string& value) {
+        integer((uint32_t)value.size());
+        for (char c : value)
+            byte((uint8_t)c);
+    };
+
+    // Routes from runs without the database have no history, so they can't be served to runs that have one
+    integer(_config.use_db);
+    integer(_config.population_size);
+    integer(_config.num_generations);
+    real(_config.initial_sigma_divisor);
+    real(_config.initial_sigma_xy);
+    real(_config.step_dampening);
+    real(_config.alpha);
+    integer(_config.num_route_workers);
+    real(_config.track_weight);
+    real(_config.curve_weight);
+    real(_config.grade_weight);
+    real(_config.length_weight);
+    text(_config.curve_type);
+    text(_config.terrain_filter);
+    integer(_config.pyramid_levels);
+    real(_config.coarse_fraction);
+    integer(_config.decomposition_interval);
+
+    return hash;
+
+}
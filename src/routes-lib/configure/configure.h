@@ -12,6 +12,8 @@
 #include <boost/property_tree/json_parser.hpp>
 #include <boost/foreach.hpp>
 #include <cassert>
+#include <cstdint>
+#include <cstring>
 #include <exception>
 #include <iostream>
 #include <sstream>
@@ -99,6 +101,79 @@ struct Configuration {
      */
     float length_weight;
 
+    /**
+     * The number of worker threads the server uses to calculate routes concurrently
+     */
+    int num_server_workers;
+
+    /**
+     * The number of independently locked shards that the completed route cache is split into
+     */
+    int cache_shards;
+
+    /**
+     * The approximate amount of memory in megabytes that completed routes may use before the least recently used are evicted
+     */
+    int cache_memory_mb;
+
+    /**
+     * The number of seconds that a completed route is kept before it expires
+     */
+    int cache_ttl;
+
+    /**
+     * The id of this server, it is put in the high bits of every route id so that several servers never hand out the same id
+     */
+    int node_id;
+
+    /**
+     * The precision in degrees that the start and destination are rounded to when checking if a route was already requested
+     */
+    float request_precision;
+
+    /**
+     * The directory that completed routes are saved to so that they survive a restart. Routes are not saved if this is empty
+     */
+    std::string persist_directory;
+
+    /**
+     * The number of chunks the population is split into so that uploading, evaluating and sampling overlap.
+     * 1 runs every stage one after the other
+     */
+    int pipeline_chunks;
+
+    /**
+     * The kind of curve routes are made of, either "bezier" or "bspline"
+     */
+    std::string curve_type;
+
+    /**
+     * How the terrain is sampled between elevation pixels, either "nearest", "bilinear" or "bicubic"
+     */
+    std::string terrain_filter;
+
+    /**
+     * The number of levels of the elevation pyramid, each one half the resolution of the one before.
+     * 1 only uses the full resolution
+     */
+    int pyramid_levels;
+
+    /**
+     * The fraction of the generations that are run on the coarse levels of the elevation pyramid before the full resolution
+     */
+    float coarse_fraction;
+
+    /**
+     * Where the cost of the paths is evaluated, either "opencl" or "native" for threads on the CPU
+     */
+    std::string cost_backend;
+
+    /**
+     * The number of generations between eigendecompositions of the covariance matrix. 0 uses the CMA-ES rule of
+     * 1 / (10 N (c1 + c_mu)), which is 1 for the population sizes routes use
+     */
+    int decomposition_interval;
+
 };
 
 class Configure {
@@ -110,6 +185,14 @@ public:
      */
     Configure();
 
+    /**
+     * Construct a configuration from a different params file, so that tests can try other parameters.
+     *
+     * @param path
+     * The path of the params json file
+     */
+    explicit Configure(const std::string& path);
+
     /**
      * Gets the reload flag
      *
@@ -165,7 +248,7 @@ public:
      * @return
      * returns the step dampening parameter
      */
-    static float getStepDampening();
+    float getStepDampening();
 
     /**
      * Gets the interval multiplier for the indicator function
@@ -223,17 +306,145 @@ public:
      */
     float getLengthWeight();
 
+    /**
+     * Gets the number of route calculation workers for the server
+     *
+     * @return
+     * The number of server workers
+     */
+    int getNumServerWorkers();
+
+    /**
+     * Gets the number of shards of the completed route cache
+     *
+     * @return
+     * The number of cache shards
+     */
+    int getCacheShards();
+
+    /**
+     * Gets the memory budget of the completed route cache
+     *
+     * @return
+     * The memory budget in megabytes
+     */
+    int getCacheMemoryMB();
+
+    /**
+     * Gets how long completed routes are kept for
+     *
+     * @return
+     * The time to live of a completed route in seconds
+     */
+    int getCacheTTL();
+
+    /**
+     * Gets the id of this server
+     *
+     * @return
+     * The node id
+     */
+    int getNodeId();
+
+    /**
+     * Gets the precision that requested positions are rounded to when looking for duplicate requests
+     *
+     * @return
+     * The precision in degrees
+     */
+    float getRequestPrecision();
+
+    /**
+     * Gets the directory that completed routes are saved to
+     *
+     * @return
+     * The directory or an empty string if routes should not be saved
+     */
+    std::string getPersistDirectory();
+
+    /**
+     * Gets the number of chunks the population is evaluated in
+     *
+     * @return
+     * The number of chunks, 1 if the stages are not pipelined
+     */
+    int getPipelineChunks();
+
+    /**
+     * Gets the kind of curve routes are made of
+     *
+     * @return
+     * Either "bezier" or "bspline"
+     */
+    std::string getCurveType();
+
+    /**
+     * Gets how the terrain is sampled between elevation pixels
+     *
+     * @return
+     * returns the name of the terrain filter
+     */
+    std::string getTerrainFilter();
+
+    /**
+     * Gets the number of levels of the elevation pyramid
+     *
+     * @return
+     * returns the number of pyramid levels
+     */
+    int getPyramidLevels();
+
+    /**
+     * Gets the fraction of the generations that are run on the coarse levels of the elevation pyramid
+     *
+     * @return
+     * returns the coarse fraction
+     */
+    float getCoarseFraction();
+
+    /**
+     * Gets where the cost of the paths is evaluated
+     *
+     * @return
+     * returns the name of the cost backend
+     */
+    std::string getCostBackend();
+
+    /**
+     * Gets the number of generations between eigendecompositions of the covariance matrix
+     *
+     * @return
+     * The number of generations, 0 if it should come from the CMA-ES rule
+     */
+    int getDecompositionInterval();
+
+    /**
+     * Hashes every parameter that changes how a route is calculated. Two configurations with the same hash will
+     * calculate the same route for the same start and destination, so this can be used to find routes that
+     * were already calculated. Parameters that only affect the server are not included, but use_db is since it decides
+     * whether a route has a history. The hash is FNV-1a over
+     * the parameters in a fixed layout, so it is the same on every platform and is safe to save.
+     *
+     * @return
+     * The hash of the parameters
+     */
+    uint64_t hash();
+
 private:
 
     /**
      * Loads the params json file
+     *
+     * @param path
+     * The path of the params json file
      */
-    void loadConfig();
+    void loadConfig(const std::string& path);
 
     /**
-     * The loaded configuration
+     * The loaded configuration.
+     * Every Configure has its own copy so that routes being calculated at the same time never share parameters.
      */
-    static Configuration _config;
+    Configuration _config;
 
 };
 
@@ -0,0 +1,29 @@
+//
+//  cost_evaluator.cpp
+//  Routes
+//
+
+#include "cost_evaluator.h"
+#include "native_evaluator.h"
+#include "opencl_evaluator.h"
+
+std::unique_ptr<CostEvaluator> CostEvaluator::create(CostBackend backend) {
+
+    if (backend == CostBackend::Native)
+        return std::make_unique<NativeCostEvaluator>();
+
+    return std::make_unique<OpenCLCostEvaluator>();
+
+}
+
+CostBackend CostEvaluator::parseBackend(const std::string& name) {
+
+    if (name == "opencl")
+        return CostBackend::OpenCL;
+
+    if (name == "native")
+        return CostBackend::Native;
+
+    throw std::runtime_error("Unknown cost backend: " + name);
+
+}
@@ -0,0 +1,163 @@
+//
+//  cost_evaluator.h
+//  Routes
+//
+
+#ifndef ROUTES_COST_EVALUATOR_H
+#define ROUTES_COST_EVALUATOR_H
+
+#include <glm/glm.hpp>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../elevation/elevation.h"
+
+/** Where the cost of the paths is evaluated */
+enum class CostBackend {
+
+    /** The cost kernel, on whatever OpenCL device there is */
+    OpenCL,
+
+    /** The same math in C++, on a thread pool on the CPU */
+    Native
+
+};
+
+/** Everything about a route, other than the paths themselves, that the cost of a path depends on */
+struct CostParams {
+
+    /** The number of control points of a path, including the start and destination */
+    int path_length;
+
+    /** The number of points a path is evaluated on. The basis has one more row than this */
+    int num_points;
+
+    /** The number of pieces that a path is split into, num_points has to be a multiple of this */
+    int num_workers;
+
+    /** The steepest grade that is not penalized */
+    float max_grade;
+
+    /** The smallest radius of curvature that is not penalized in meters */
+    float min_curve;
+
+    /** How far below the terrain the track can go before it has to be tunneled in meters */
+    float excavation_depth;
+
+    /** The size of the terrain in meters */
+    glm::vec2 data_size;
+
+    /** Where the terrain starts in meters */
+    glm::vec2 data_origin;
+
+    /** The straight line distance from the start to the destination in meters */
+    float straight_distance;
+
+    /** How the terrain is sampled between pixels */
+    TerrainFilter filter;
+
+    /** The terrain on the GPU, used by the OpenCL backend */
+    const boost::compute::image2d* image;
+
+    /** The same terrain on the CPU in rows of pixels_size.x, used by the native backend */
+    const float* pixels;
+
+    /** The width and height of the terrain in pixels */
+    glm::ivec2 pixels_size;
+
+};
+
+/**
+ * Evaluates the cost of paths and writes it into the header of each individual.
+ *
+ * Individuals are laid out the same way for every backend, a row of vectors per individual with the header first and
+ * then the control points of the path. Evaluation is split into enqueue and finish so that the population can keep
+ * sampling the next chunk of individuals while the previous one is being evaluated.
+ */
+class CostEvaluator {
+
+    public:
+
+        virtual ~CostEvaluator() {}
+
+        /**
+         * Takes every individual of the population, including the start and destination which never change. This is
+         * called once before anything is evaluated.
+         *
+         * @param individuals
+         * The individuals.
+         *
+         * @param pop_size
+         * The number of individuals.
+         *
+         * @param individual_size
+         * The number of vectors in each individual.
+         */
+        virtual void setIndividuals(const glm::vec4* individuals, int pop_size, int individual_size) = 0;
+
+        /**
+         * Takes the basis that the paths are evaluated with, see Population::calcBasis.
+         *
+         * @param basis
+         * A row of width weights for every point.
+         *
+         * @param offsets
+         * The index of the control point that the first weight of each row belongs to.
+         *
+         * @param width
+         * The number of weights in each row.
+         */
+        virtual void setBasis(const std::vector<float>& basis, const std::vector<int>& offsets, int width) = 0;
+
+        /**
+         * Takes everything else that the cost depends on. This must not be called between enqueue and finish.
+         *
+         * @param params
+         * The parameters of the route. The terrain they point to has to stay alive until finish returns.
+         */
+        virtual void setParams(const CostParams& params) = 0;
+
+        /**
+         * Starts evaluating some of the individuals. Their control points must not change until finish returns.
+         *
+         * @param individuals
+         * Every individual. Only the genomes of the ones that are evaluated are read.
+         *
+         * @param start
+         * The first individual to evaluate.
+         *
+         * @param end
+         * One past the last individual to evaluate.
+         */
+        virtual void enqueue(glm::vec4* individuals, int start, int end) = 0;
+
+        /** Waits until every individual that was enqueued has its cost in its header */
+        virtual void finish() = 0;
+
+        /**
+         * Makes an evaluator.
+         *
+         * @param backend
+         * Where the cost is evaluated.
+         *
+         * @return
+         * The evaluator
+         */
+        static std::unique_ptr<CostEvaluator> create(CostBackend backend);
+
+        /**
+         * Gets the cost backend with the given name.
+         *
+         * @param name
+         * Either "opencl" or "native".
+         *
+         * @return
+         * The cost backend. Throws a std::runtime_error if the name is not known.
+         */
+        static CostBackend parseBackend(const std::string& name);
+
+};
+
+#endif //ROUTES_COST_EVALUATOR_H
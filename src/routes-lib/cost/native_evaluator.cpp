@@ -0,0 +1,310 @@
+//
+//  native_evaluator.cpp
+//  Routes
+//
+
+#include "native_evaluator.h"
+
+NativeCostEvaluator::NativeCostEvaluator() : _basis_width(0), _individual_size(0), _params(), _individuals(nullptr),
+    _pending(0), _stop(false) {
+
+    // One thread per core, hardware_concurrency is 0 when it isn't known
+    int num_threads = glm::max((int)std::thread::hardware_concurrency(), 1);
+
+    for (int i = 0; i < num_threads; i++)
+        _threads.emplace_back(&NativeCostEvaluator::work, this);
+
+}
+
+NativeCostEvaluator::~NativeCostEvaluator() {
+
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        _stop = true;
+    }
+
+    _blocks_ready.notify_all();
+
+    for (std::thread& thread : _threads)
+        thread.join();
+
+}
+
+void NativeCostEvaluator::setIndividuals(const glm::vec4*, int, int individual_size) {
+
+    // The individuals are read straight from the population's memory so there is nothing to copy
+    _individual_size = individual_size;
+
+}
+
+void NativeCostEvaluator::setBasis(const std::vector<float>& basis, const std::vector<int>& offsets, int width) {
+
+    _basis = basis;
+    _basis_offsets = offsets;
+    _basis_width = width;
+
+}
+
+void NativeCostEvaluator::setParams(const CostParams& params) {
+
+    _params = params;
+
+}
+
+void NativeCostEvaluator::enqueue(glm::vec4* individuals, int start, int end) {
+
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+
+        _individuals = individuals;
+
+        for (int block = start; block < end; block += NATIVE_COST_BLOCK) {
+
+            _blocks.push_back(glm::ivec2(block, glm::min(block + NATIVE_COST_BLOCK, end)));
+            _pending++;
+
+        }
+    }
+
+    _blocks_ready.notify_all();
+
+}
+
+void NativeCostEvaluator::finish() {
+
+    std::unique_lock<std::mutex> lock(_lock);
+    _blocks_done.wait(lock, [this] { return _pending == 0; });
+
+}
+
+float NativeCostEvaluator::sampleElevation(const float* pixels, const glm::ivec2& size, const glm::vec2& coord,
+                                           TerrainFilter filter) {
+
+    // Pixels past the edge are the pixel on the edge, like CLK_ADDRESS_CLAMP_TO_EDGE
+    auto pixel = [pixels, &size](int x, int y) {
+        return pixels[glm::clamp(y, 0, size.y - 1) * size.x + glm::clamp(x, 0, size.x - 1)];
+    };
+
+    glm::vec2 pos = coord * glm::vec2(size);
+
+    if (filter == TerrainFilter::Nearest)
+        return pixel((int)glm::floor(pos.x), (int)glm::floor(pos.y));
+
+    // Pixels are sampled at their centers
+    pos -= 0.5f;
+
+    glm::vec2 base = glm::floor(pos);
+    glm::vec2 frac = pos - base;
+
+    // Bicubic needs one more pixel on each side than bilinear
+    int window_size = filter == TerrainFilter::Bicubic ? 4 : 2;
+    glm::ivec2 first = glm::ivec2(base) - (window_size / 2 - 1);
+
+    float window[16];
+
+    for (int y = 0; y < window_size; y++)
+        for (int x = 0; x < window_size; x++)
+            window[y * window_size + x] = pixel(first.x + x, first.y + y);
+
+    return ElevationData::interpolate(window, frac, filter);
+
+}
+
+void NativeCostEvaluator::work() {
+
+    Scratch scratch;
+
+    while (true) {
+
+        std::unique_lock<std::mutex> lock(_lock);
+        _blocks_ready.wait(lock, [this] { return _stop || !_blocks.empty(); });
+
+        if (_blocks.empty())
+            return;
+
+        glm::ivec2 block = _blocks.front();
+        _blocks.pop_front();
+
+        glm::vec4* individuals = _individuals;
+
+        lock.unlock();
+
+        for (int i = block.x; i < block.y; i++)
+            evaluate(individuals + i * _individual_size, scratch);
+
+        lock.lock();
+
+        if (--_pending == 0)
+            _blocks_done.notify_all();
+
+    }
+
+}
+
+void NativeCostEvaluator::evaluate(glm::vec4* individual, Scratch& scratch) const {
+
+    const float pylon_cost = 1.16f;
+    const float tunnel_cost = 31000.0f;
+
+    // The last worker evaluates one point past the end of the curve, like the basis
+    int num_rows = _params.num_points + 1;
+
+    scratch.x.resize(num_rows);
+    scratch.y.resize(num_rows);
+    scratch.z.resize(num_rows);
+    scratch.w.resize(num_rows);
+    scratch.elevation.resize(num_rows);
+    scratch.spacing.resize(num_rows);
+    scratch.distance.resize(num_rows);
+    scratch.track.resize(num_rows);
+    scratch.curve.resize(num_rows);
+    scratch.grade.resize(num_rows);
+
+    float* x = scratch.x.data();
+    float* y = scratch.y.data();
+    float* z = scratch.z.data();
+    float* w = scratch.w.data();
+    float* elevation = scratch.elevation.data();
+    float* spacing = scratch.spacing.data();
+    float* distance = scratch.distance.data();
+    float* track = scratch.track.data();
+    int* curve = scratch.curve.data();
+    int* grade = scratch.grade.data();
+
+    // The path starts after the header
+    const glm::vec4* controls = individual + 1;
+
+    // Evaluate the curve at every point. The curve is just the weighted sum of the control points
+    for (int p = 0; p < num_rows; p++) {
+
+        const float* weights = &_basis[p * _basis_width];
+        const glm::vec4* points = controls + _basis_offsets[p];
+
+        glm::vec4 point = glm::vec4(0.0f);
+
+        for (int i = 0; i < _basis_width; i++)
+            point += weights[i] * points[i];
+
+        x[p] = point.x;
+        y[p] = point.y;
+        z[p] = point.z;
+        w[p] = point.w;
+
+    }
+
+    // Sample the terrain under every point. This is the only pass that reads memory out of order
+    for (int p = 0; p < num_rows; p++) {
+
+        glm::vec2 coord = glm::vec2((x[p] - _params.data_origin.x) / _params.data_size.x,
+                                    (y[p] - _params.data_origin.y) / _params.data_size.y);
+
+        elevation[p] = sampleElevation(_params.pixels, _params.pixels_size, coord, _params.filter);
+
+    }
+
+    // The first point is measured from the start of the path, every other point from the point before it
+    for (int p = 0; p < num_rows; p++) {
+
+        float last_x = p ? x[p - 1] : controls[0].x;
+        float last_y = p ? y[p - 1] : controls[0].y;
+        float last_z = p ? z[p - 1] : controls[0].z;
+        float last_w = p ? w[p - 1] : controls[0].w;
+
+        float dx = x[p] - last_x;
+        float dy = y[p] - last_y;
+        float dz = z[p] - last_z;
+        float dw = w[p] - last_w;
+
+        // Only x and y distance, the z delta is handled by the grade
+        float point_spacing = std::sqrt(dx * dx + dy * dy);
+        bool spaced = point_spacing != 0.0f;
+
+        grade[p] = spaced && std::fabs(dz) / point_spacing > _params.max_grade;
+        distance[p] = spaced ? std::sqrt(dx * dx + dy * dy + dz * dz + dw * dw) : 0.0f;
+        spacing[p] = point_spacing;
+
+    }
+
+    // Track cost, the same as the kernel
+    for (int p = 0; p < num_rows; p++) {
+
+        float pylon_height = z[p] - elevation[p];
+
+        float above_cost = 0.5f * (std::fabs(pylon_height) + pylon_height) * 1.1f;
+        above_cost = above_cost * above_cost * pylon_cost;
+
+        float below_cost = -std::fabs(pylon_height + _params.excavation_depth) + pylon_height + _params.excavation_depth;
+        float below_cost_den = 2.0f * pylon_height + 2.0f * _params.excavation_depth;
+
+        below_cost = below_cost_den == 0.0f ? below_cost * tunnel_cost : below_cost / below_cost_den * tunnel_cost;
+
+        track[p] = spacing[p] != 0.0f ? (above_cost + below_cost) * spacing[p] : 0.0f;
+
+    }
+
+    // Curvature needs the two points before, so the first two points are never penalized
+    curve[0] = 0;
+
+    if (num_rows > 1)
+        curve[1] = 0;
+
+    for (int p = 2; p < num_rows; p++) {
+
+        float d0x = x[p - 1] - x[p - 2], d0y = y[p - 1] - y[p - 2], d0z = z[p - 1] - z[p - 2], d0w = w[p - 1] - w[p - 2];
+        float d1x = x[p] - x[p - 1], d1y = y[p] - y[p - 1], d1z = z[p] - z[p - 1];
+
+        // The second derivative
+        float d2x = d1x - d0x, d2y = d1y - d0y, d2z = d1z - d0z;
+
+        float cross_x = d0y * d2z - d0z * d2y;
+        float cross_y = d0z * d2x - d0x * d2z;
+        float cross_z = d0x * d2y - d0y * d2x;
+
+        float denom = std::sqrt(cross_x * cross_x + cross_y * cross_y + cross_z * cross_z);
+        float first = std::sqrt(d0x * d0x + d0y * d0y + d0z * d0z + d0w * d0w);
+
+        curve[p] = std::fabs(first * first * first / denom) < _params.min_curve;
+
+    }
+
+    // Sum the way the kernel does, every worker takes its piece and the point after it, then the workers are added up
+    int points_per_worker = _params.num_points / _params.num_workers;
+
+    int curve_penalty = 0;
+    int grade_penalty = 0;
+    float route_length = 0.0f;
+    float track_cost = 0.0f;
+
+    for (int worker = 0; worker < _params.num_workers; worker++) {
+
+        int start = worker * points_per_worker;
+        int end = start + points_per_worker;
+
+        int worker_curve = 0;
+        int worker_grade = 0;
+        float worker_length = 0.0f;
+        float worker_track = 0.0f;
+
+        for (int p = start; p <= end; p++) {
+
+            worker_curve += curve[p];
+            worker_grade += grade[p];
+            worker_length += distance[p];
+            worker_track += track[p];
+
+        }
+
+        curve_penalty += worker_curve;
+        grade_penalty += worker_grade;
+        route_length += worker_length;
+        track_cost += worker_track;
+
+    }
+
+    // Normalize the same way the kernel does
+    individual[0].x = track_cost / (route_length * tunnel_cost);
+    individual[0].y = (float)curve_penalty / (float)_params.num_points;
+    individual[0].z = (float)grade_penalty / (float)_params.num_points;
+    individual[0].w = glm::clamp(route_length / _params.straight_distance - 1.0f, 0.0f, 1.0f);
+
+}
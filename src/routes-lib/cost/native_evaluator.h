@@ -0,0 +1,146 @@
+//
+//  native_evaluator.h
+//  Routes
+//
+
+#ifndef ROUTES_NATIVE_EVALUATOR_H
+#define ROUTES_NATIVE_EVALUATOR_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "cost_evaluator.h"
+
+/** The number of individuals that a thread of the native evaluator takes at once */
+#define NATIVE_COST_BLOCK 4
+
+/**
+ * Evaluates the cost on the CPU with the same math as the cost kernel.
+ *
+ * A pool of threads, one per core, takes blocks of individuals. Each individual is done in passes over all of its
+ * points, first the curve, then the terrain, then the penalties and the track cost. Every pass is a loop over
+ * contiguous arrays of floats with no branches in it, so the compiler vectorizes it. The kernel splits the points of
+ * an individual between workers that each evaluate one point past the end of their piece, and the points that are
+ * shared are counted by both, so the sums here are split the same way to get the same costs.
+ */
+class NativeCostEvaluator : public CostEvaluator {
+
+    public:
+
+        /** Starts the threads */
+        NativeCostEvaluator();
+
+        /** Stops the threads once they are done with what was enqueued */
+        ~NativeCostEvaluator() override;
+
+        void setIndividuals(const glm::vec4* individuals, int pop_size, int individual_size) override;
+
+        void setBasis(const std::vector<float>& basis, const std::vector<int>& offsets, int width) override;
+
+        void setParams(const CostParams& params) override;
+
+        void enqueue(glm::vec4* individuals, int start, int end) override;
+
+        void finish() override;
+
+        /**
+         * Samples the terrain the same way that the cost kernel samples its image.
+         *
+         * @param pixels
+         * The terrain in rows of size.x pixels.
+         *
+         * @param size
+         * The width and height of the terrain in pixels.
+         *
+         * @param coord
+         * The position to sample, normalized to the size of the terrain.
+         *
+         * @param filter
+         * How to sample between pixels.
+         *
+         * @return
+         * The elevation at the position
+         */
+        static float sampleElevation(const float* pixels, const glm::ivec2& size, const glm::vec2& coord,
+                                     TerrainFilter filter);
+
+    private:
+
+        /** The points of one individual and everything computed from them. Each thread keeps its own */
+        struct Scratch {
+
+            /** The components of the curve at every point */
+            std::vector<float> x, y, z, w;
+
+            /** The elevation of the terrain under every point */
+            std::vector<float> elevation;
+
+            /** How far every point is from the one before it, in x and y and in all four components */
+            std::vector<float> spacing, distance;
+
+            /** The track cost of every point */
+            std::vector<float> track;
+
+            /** 1 where a point is penalized, 0 where it isn't */
+            std::vector<int> curve, grade;
+
+        };
+
+        /** Takes blocks of individuals until the evaluator is destroyed */
+        void work();
+
+        /**
+         * Evaluates one individual and writes its header.
+         *
+         * @param individual
+         * The first vector of the individual, its header.
+         *
+         * @param scratch
+         * The thread's scratch memory.
+         */
+        void evaluate(glm::vec4* individual, Scratch& scratch) const;
+
+        /** The basis, a row of _basis_width weights for every point */
+        std::vector<float> _basis;
+
+        /** The index of the control point that the first weight of each row belongs to */
+        std::vector<int> _basis_offsets;
+
+        /** The number of weights in each row of the basis */
+        int _basis_width;
+
+        /** The number of vectors in each individual */
+        int _individual_size;
+
+        /** The parameters of the route */
+        CostParams _params;
+
+        /** The individuals that the blocks in _blocks belong to */
+        glm::vec4* _individuals;
+
+        /** The first individual and one past the last of every block that no thread has taken yet */
+        std::deque<glm::ivec2> _blocks;
+
+        /** The number of blocks that have been enqueued and not finished */
+        int _pending;
+
+        /** Set when the threads should stop */
+        bool _stop;
+
+        /** Guards _blocks, _pending, _stop and _individuals */
+        std::mutex _lock;
+
+        /** Wakes the threads when there are blocks */
+        std::condition_variable _blocks_ready;
+
+        /** Wakes finish when the last block is done */
+        std::condition_variable _blocks_done;
+
+        /** The threads */
+        std::vector<std::thread> _threads;
+
+};
+
+#endif //ROUTES_NATIVE_EVALUATOR_H
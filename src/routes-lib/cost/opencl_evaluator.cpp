@@ -0,0 +1,119 @@
+//
+//  opencl_evaluator.cpp
+//  Routes
+//
+
+#include "opencl_evaluator.h"
+
+OpenCLCostEvaluator::OpenCLCostEvaluator() : _kernel(getProgram().getProgram(), "cost"), _basis_width(0),
+    _individual_size(0), _num_workers(1), _individuals(nullptr) {}
+
+void OpenCLCostEvaluator::setIndividuals(const glm::vec4* individuals, int pop_size, int individual_size) {
+
+    size_t num_bytes = (size_t)pop_size * individual_size * sizeof(glm::vec4);
+
+    _individual_size = individual_size;
+    _opencl_individuals = boost::compute::buffer(Kernel::getContext(), num_bytes, CL_MEM_READ_WRITE);
+
+    // Upload everything once so that the start and destination are on the GPU
+    Kernel::getQueue().enqueue_write_buffer(_opencl_individuals, 0, num_bytes, individuals);
+
+}
+
+void OpenCLCostEvaluator::setBasis(const std::vector<float>& basis, const std::vector<int>& offsets, int width) {
+
+    _basis_width = width;
+
+    _opencl_basis = boost::compute::vector<float>(basis.size(), Kernel::getContext());
+    _opencl_basis_offsets = boost::compute::vector<int>(offsets.size(), Kernel::getContext());
+
+    // Upload to the GPU
+    boost::compute::copy(basis.begin(), basis.end(), _opencl_basis.begin(), Kernel::getQueue());
+    boost::compute::copy(offsets.begin(), offsets.end(), _opencl_basis_offsets.begin(), Kernel::getQueue());
+
+}
+
+void OpenCLCostEvaluator::setParams(const CostParams& params) {
+
+    _num_workers = params.num_workers;
+
+    _kernel.setArgs(*params.image, _opencl_individuals, params.path_length,
+                    params.max_grade, params.min_curve, params.excavation_depth, params.data_size.x,
+                    params.data_size.y, _opencl_basis.get_buffer(), _opencl_basis_offsets.get_buffer(), _basis_width,
+                    (float)params.num_points - 1.0f, params.num_points / params.num_workers, params.data_origin.x,
+                    params.data_origin.y, params.straight_distance, (int)params.filter);
+
+}
+
+void OpenCLCostEvaluator::enqueue(glm::vec4* individuals, int start, int end) {
+
+    // Without a kernel there would be nothing to wait on
+    if (!_kernel.isValid())
+        throw std::runtime_error("The cost kernel could not be compiled");
+
+    boost::compute::command_queue& queue = Kernel::getQueue();
+    boost::compute::command_queue& transfer_queue = Kernel::getTransferQueue();
+
+    _individuals = individuals;
+
+    // Every individual is a row of _individual_size vectors. Only the genome in the middle of each row has changed
+    size_t row_pitch = _individual_size * sizeof(glm::vec4);
+    size_t genome_origin[3] = {2 * sizeof(glm::vec4), (size_t)start, 0};
+    size_t genome_region[3] = {(_individual_size - 3) * sizeof(glm::vec4), (size_t)(end - start), 1};
+
+    boost::compute::event upload = transfer_queue.enqueue_write_buffer_rect_async(_opencl_individuals, genome_origin,
+                                                                                  genome_origin, genome_region,
+                                                                                  row_pitch, 0, row_pitch, 0,
+                                                                                  individuals);
+
+    // Evaluate the chunk as soon as it is uploaded. _num_workers threads will work on a single individual
+    _kernels.push_back(_kernel.execute2D(glm::vec<2, size_t>(start, 0),
+                                         glm::vec<2, size_t>(end - start, _num_workers),
+                                         glm::vec<2, size_t>(1, _num_workers),
+                                         boost::compute::wait_list(upload)));
+    _chunks.push_back(glm::ivec2(start, end));
+
+    // Make sure the GPU starts right away instead of when the queues fill up
+    transfer_queue.flush();
+    queue.flush();
+
+}
+
+void OpenCLCostEvaluator::finish() {
+
+    if (_chunks.empty())
+        return;
+
+    boost::compute::command_queue& transfer_queue = Kernel::getTransferQueue();
+
+    size_t row_pitch = _individual_size * sizeof(glm::vec4);
+
+    // The downloads go after every upload so that none of the uploads wait behind a kernel
+    boost::compute::event download;
+
+    for (size_t chunk = 0; chunk < _chunks.size(); chunk++) {
+
+        size_t header_origin[3] = {0, (size_t)_chunks[chunk].x, 0};
+        size_t header_region[3] = {sizeof(glm::vec4), (size_t)(_chunks[chunk].y - _chunks[chunk].x), 1};
+
+        download = transfer_queue.enqueue_read_buffer_rect_async(_opencl_individuals, header_origin, header_origin,
+                                                                 header_region, row_pitch, 0, row_pitch, 0,
+                                                                 _individuals, boost::compute::wait_list(_kernels[chunk]));
+
+    }
+
+    _chunks.clear();
+    _kernels.clear();
+
+    // The transfer queue runs in order so the last download finishing means every download has
+    download.wait();
+
+}
+
+const Kernel& OpenCLCostEvaluator::getProgram() {
+
+    static Kernel program = Kernel(std::ifstream("../opencl/kernel_cost.opencl"), "cost");
+
+    return program;
+
+}
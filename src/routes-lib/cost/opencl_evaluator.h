@@ -0,0 +1,80 @@
+//
+//  opencl_evaluator.h
+//  Routes
+//
+
+#ifndef ROUTES_OPENCL_EVALUATOR_H
+#define ROUTES_OPENCL_EVALUATOR_H
+
+#include <boost/compute/container/vector.hpp>
+
+#include "cost_evaluator.h"
+#include "../opencl/kernel.h"
+
+/**
+ * Evaluates the cost with the cost kernel.
+ *
+ * The individuals live in a buffer on the device. The start and destination are uploaded once, after that only the
+ * genomes go up and only the headers come back down. Uploads and downloads go on the transfer queue so that they
+ * overlap with the kernels of other chunks.
+ */
+class OpenCLCostEvaluator : public CostEvaluator {
+
+    public:
+
+        /** Makes a kernel for this evaluator from the compiled cost program */
+        OpenCLCostEvaluator();
+
+        void setIndividuals(const glm::vec4* individuals, int pop_size, int individual_size) override;
+
+        void setBasis(const std::vector<float>& basis, const std::vector<int>& offsets, int width) override;
+
+        void setParams(const CostParams& params) override;
+
+        void enqueue(glm::vec4* individuals, int start, int end) override;
+
+        void finish() override;
+
+    private:
+
+        /**
+         * Compiles the cost program the first time it is needed.
+         *
+         * @return
+         * The program, shared by every evaluator
+         */
+        static const Kernel& getProgram();
+
+        /** This evaluator's own kernel so that concurrent routes don't overwrite each other's arguments */
+        Kernel _kernel;
+
+        /** The individuals on the device */
+        boost::compute::buffer _opencl_individuals;
+
+        /** The basis on the device */
+        boost::compute::vector<float> _opencl_basis;
+
+        /** The basis offsets on the device */
+        boost::compute::vector<int> _opencl_basis_offsets;
+
+        /** The number of weights in each row of the basis */
+        int _basis_width;
+
+        /** The number of vectors in each individual */
+        int _individual_size;
+
+        /** The number of workers each individual is split between */
+        int _num_workers;
+
+        /** The host memory of the individuals that are being evaluated */
+        glm::vec4* _individuals;
+
+        /** The first individual and one past the last of every chunk that was enqueued */
+        std::vector<glm::ivec2> _chunks;
+
+        /** The kernel of every chunk that was enqueued */
+        std::vector<boost::compute::event> _kernels;
+
+};
+
+#endif //ROUTES_OPENCL_EVALUATOR_H
@@ -4,371 +4,284 @@
 
 #include "database.h"
 
-std::string _dbname;
-std::string _user;
-std::string _password;
-
-
 Database::Database(std::string dbname, std::string user, std::string password) {
 
-    _dbname = dbname;
-    _user = user;
-    _password = password;
+    std::string connection_string = "dbname=" + dbname + " user=" + user + " password=" + password;
 
-}
+    // Share the pool with every other Database for the same credentials
+    _Pools& pools = getPools();
+    std::lock_guard<std::mutex> lock(pools.lock);
 
-void Database::initRoute(std::string query) {
+    std::shared_ptr<_Pool>& pool = pools.pools[connection_string];
 
-    try {
-        pqxx::connection c("dbname=" + _dbname + " user=" + _user + " password=" + _password);
+    if (!pool) {
+        pool = std::make_shared<_Pool>();
+        pool->connection_string = connection_string;
+    }
 
-        pqxx::work w(c);
+    _pool = pool;
 
-        w.exec(query);
+}
 
-        w.commit();
+Database::_Pools& Database::getPools() {
 
-        std::cout << "Initial database write succeeded" << std::endl;
-
-    } catch (const std::exception &e) {
-        std::cerr << e.what() << std::endl;
-    }
+    static _Pools pools;
+    return pools;
 
 }
 
-glm::vec3 Database::getNextIds(std::vector<std::string> queries) {
+int Database::initRoute(double lat_start, double lat_end, double long_start, double long_end) {
 
     try {
-        pqxx::connection c("dbname=" + _dbname + " user=" + _user + " password=" + _password);
-
-        pqxx::work w(c);
-
-        pqxx::result r1 = w.exec(queries[0]);
-
-        int route_id;
 
-        //find the last route_id (since it is auto_increment)
-        for (auto row: r1) {
-            route_id = std::stoi(row[0].c_str());
-        }
+        _Lease lease(_pool);
+        pqxx::work w(lease.get());
 
-        pqxx::result r2 = w.exec(queries[1]);
-
-        int controls_id;
-        for (auto row: r2) {
-            controls_id = std::stoi(row[0].c_str());
-        }
-
-        pqxx::result r3 = w.exec(queries[2]);
-
-        int generation_id;
-        for (auto row: r3) {
-            generation_id = std::stoi(row[0].c_str());
-        }
+        pqxx::result r = w.exec_prepared("insert_route", lat_start, lat_end, long_start, long_end);
 
         w.commit();
 
-        return {route_id, controls_id, generation_id};
-
-    } catch (const std::exception &e) {
-        std::cerr << e.what() << std::endl;
-    }
-
-}
-
-void Database::batchInsert(std::vector<std::string> queries) {
-
-    try {
-        pqxx::connection c("dbname=" + _dbname + " user=" + _user + " password=" + _password);
-
-        pqxx::work w(c);
+        std::cout << "Initial database write succeeded" << std::endl;
 
-        w.exec(queries[0]);
-        w.exec(queries[1]);
-        w.exec(queries[2]);
+        return r[0][0].as<int>();
 
-        w.commit();
-
-        std::cout << "Writing to database succeeded" << std::endl;
     } catch (const std::exception &e) {
         std::cerr << e.what() << std::endl;
     }
 
+    return 0;
+
 }
 
-std::string Database::selectSolutions(std::string query) {
+bool Database::insertGenerations(const std::vector<GenerationRow>& rows) {
 
-    pqxx::result r;
+    if (rows.empty())
+        return true;
 
     try {
-        pqxx::connection c("dbname=" + _dbname + " user=" + _user + " password=" + _password);
 
-        pqxx::work w(c);
+        _Lease lease(_pool);
+        pqxx::work w(lease.get());
 
-        r = w.exec(query);
+        // Take an id for every row of the batch at once
+        pqxx::result controls_ids = w.exec_prepared("reserve_controls_ids", (int)rows.size());
+        pqxx::result generation_ids = w.exec_prepared("reserve_generation_ids", (int)rows.size());
 
-        w.commit();
+        if (controls_ids.size() != rows.size() || generation_ids.size() != rows.size())
+            return false;
 
-        std::cout << "Writing to database succeeded" << std::endl;
-    } catch (const std::exception &e) {
-        std::cerr << e.what() << std::endl;
-    }
+        // The tables reference each other so they are filled in this order
+        pqxx::stream_to controls(w, "\"Controls\"", std::vector<std::string>{"controls_id", "controls", "evaluated"});
 
-    std::vector<std::string> evaluatedStrings;
+        for (size_t i = 0; i < rows.size(); i++)
+            controls << std::make_tuple(controls_ids[i][0].as<int>(), pointsToArray(rows[i].controls),
+                                        pointsToArray(rows[i].evaluated));
 
-    //add all the rows into a vector and turn them into strings
-    for (auto row : r) {
-        evaluatedStrings.push_back(row[0].c_str());
-    }
-
-    //wrap the vector in brackets and make it one string
-    std::string evaluatedResult = "[";
+        controls.complete();
 
-    for (std::string s : evaluatedStrings) {
+        pqxx::stream_to generations(w, "\"Generation\"",
+                                    std::vector<std::string>{"generation", "controls_id", "route_id", "generation_id"});
 
-        evaluatedResult.append(s);
+        for (size_t i = 0; i < rows.size(); i++)
+            generations << std::make_tuple(rows[i].generation, controls_ids[i][0].as<int>(), rows[i].route_id,
+                                           generation_ids[i][0].as<int>());
 
-        //newline for readability when debugging
-        evaluatedResult.append(",\n");
-    }
+        generations.complete();
 
-    evaluatedResult.append("]");
+        pqxx::stream_to fitness(w, "\"Fitness\"",
+                                std::vector<std::string>{"total_fitness", "track_fitness", "curve_fitness",
+                                                         "grade_fitness", "length_fitness", "generation_id"});
 
-    //get rid of the trailing comma
-    evaluatedResult.erase(evaluatedResult.size() - 3, 2);
-
-    //Since this is being passed to the front end through JSON, and curly braces
-    //indicate an object in JSON, change curly braces to brackets.
-    std::replace(evaluatedResult.begin(), evaluatedResult.end(), '{', '[');
-    std::replace(evaluatedResult.begin(), evaluatedResult.end(), '}', ']');
+        for (size_t i = 0; i < rows.size(); i++)
+            fitness << std::make_tuple(rows[i].total_fitness, rows[i].fitness.x, rows[i].fitness.y,
+                                       rows[i].fitness.z, rows[i].fitness.w, generation_ids[i][0].as<int>());
 
-    return evaluatedResult;
-
-}
-
-std::string Database::selectTotalFitness(std::string query) {
-
-    pqxx::result r;
-
-    try {
-        pqxx::connection c("dbname=" + _dbname + " user=" + _user + " password=" + _password);
-
-        pqxx::work w(c);
-
-        r = w.exec(query);
+        fitness.complete();
 
         w.commit();
 
-        std::cout << "Writing to database succeeded" << std::endl;
+        return true;
+
     } catch (const std::exception &e) {
         std::cerr << e.what() << std::endl;
     }
 
-    std::vector<std::string> evaluatedStrings;
-
-
-    //add all the rows into a vector and turn them into strings
-    for (auto row : r) {
-        evaluatedStrings.push_back(row[0].c_str());
-    }
-
-    //wrap the vector in brackets and make it one string
-    std::string evaluatedResult = "[";
-
-    for (std::string s : evaluatedStrings) {
-
-        evaluatedResult.append(s);
-
-        //newline for readability when debugging
-        evaluatedResult.append(",\n");
-    }
-
-    evaluatedResult.append("]");
-
-    //get rid of the trailing comma
-    evaluatedResult.erase(evaluatedResult.size() - 3, 2);
-
-    return evaluatedResult;
+    return false;
 
 }
 
-std::string Database::selectTrackFitness(std::string query) {
+RouteHistory Database::selectHistory(int route_id) {
 
     pqxx::result r;
 
     try {
-        pqxx::connection c("dbname=" + _dbname + " user=" + _user + " password=" + _password);
 
-        pqxx::work w(c);
+        _Lease lease(_pool);
+        pqxx::work w(lease.get());
 
-        r = w.exec(query);
+        r = w.exec_prepared("select_history", route_id);
 
         w.commit();
 
-        std::cout << "Writing to database succeeded" << std::endl;
     } catch (const std::exception &e) {
         std::cerr << e.what() << std::endl;
     }
 
-    std::vector<std::string> evaluatedStrings;
-
-
-    //add all the rows into a vector and turn them into strings
-    for (auto row : r) {
-        evaluatedStrings.push_back(row[0].c_str());
-    }
-
-    //wrap the vector in brackets and make it one string
-    std::string evaluatedResult = "[";
-
-    for (std::string s : evaluatedStrings) {
+    RouteHistory history;
 
-        evaluatedResult.append(s);
+    history.solutions = columnToJSON(r, 0, true);
+    history.total_fitness = columnToJSON(r, 1, false);
+    history.track_fitness = columnToJSON(r, 2, false);
+    history.curve_fitness = columnToJSON(r, 3, false);
+    history.grade_fitness = columnToJSON(r, 4, false);
+    history.length_fitness = columnToJSON(r, 5, false);
 
-        //newline for readability when debugging
-        evaluatedResult.append(",\n");
-    }
+    return history;
 
-    evaluatedResult.append("]");
+}
 
-    //get rid of the trailing comma
-    evaluatedResult.erase(evaluatedResult.size() - 3, 2);
+std::unique_ptr<pqxx::connection> Database::connect(const std::string& connection_string) {
 
-    return evaluatedResult;
+    std::unique_ptr<pqxx::connection> c = std::make_unique<pqxx::connection>(connection_string);
 
-}
+    c->prepare("insert_route",
+               "INSERT INTO \"Route\" (lat_start, lat_end, long_start, long_end) "
+               "VALUES ($1, $2, $3, $4) RETURNING route_id");
 
-std::string Database::selectCurveFitness(std::string query) {
+    c->prepare("reserve_controls_ids",
+               "SELECT nextval('\"Controls_controls_id_seq\"') FROM generate_series(1, $1)");
 
-    pqxx::result r;
+    c->prepare("reserve_generation_ids",
+               "SELECT nextval('\"Generation_generation_id_seq\"') FROM generate_series(1, $1)");
 
-    try {
-        pqxx::connection c("dbname=" + _dbname + " user=" + _user + " password=" + _password);
+    // Every series of a route in one pass
+    c->prepare("select_history",
+               "SELECT \"Controls\".evaluated, \"Fitness\".total_fitness, \"Fitness\".track_fitness, "
+               "\"Fitness\".curve_fitness, \"Fitness\".grade_fitness, \"Fitness\".length_fitness "
+               "FROM \"Generation\" "
+               "JOIN \"Controls\" ON (\"Controls\".controls_id = \"Generation\".controls_id) "
+               "JOIN \"Fitness\" ON (\"Fitness\".generation_id = \"Generation\".generation_id) "
+               "WHERE \"Generation\".route_id = $1 "
+               "ORDER BY \"Generation\".generation");
 
-        pqxx::work w(c);
+    return c;
 
-        r = w.exec(query);
+}
 
-        w.commit();
+std::string Database::columnToJSON(const pqxx::result& r, int column, bool arrays) {
 
-        std::cout << "Writing to database succeeded" << std::endl;
-    } catch (const std::exception &e) {
-        std::cerr << e.what() << std::endl;
-    }
+    //wrap the rows in brackets and make it one string
+    std::string result = "[";
 
-    std::vector<std::string> evaluatedStrings;
+    bool first = true;
 
-    //add all the rows into a vector and turn them into strings
     for (auto row : r) {
-        evaluatedStrings.push_back(row[0].c_str());
-    }
 
-    //wrap the vector in brackets and make it one string
-    std::string evaluatedResult = "[";
-
-    for (std::string s : evaluatedStrings) {
+        //newline for readability when debugging
+        if (!first)
+            result.append(",\n");
 
-        evaluatedResult.append(s);
+        result.append(row[column].c_str());
+        first = false;
 
-        //newline for readability when debugging
-        evaluatedResult.append(",\n");
     }
 
-    evaluatedResult.append("]");
+    result.append("]");
 
-    //get rid of the trailing comma
-    evaluatedResult.erase(evaluatedResult.size() - 3, 2);
+    //Since this is being passed to the front end through JSON, and curly braces
+    //indicate an object in JSON, change curly braces to brackets.
+    if (arrays) {
+        std::replace(result.begin(), result.end(), '{', '[');
+        std::replace(result.begin(), result.end(), '}', ']');
+    }
 
-    return evaluatedResult;
+    return result;
 
 }
 
-std::string Database::selectGradeFitness(std::string query) {
+std::string Database::pointsToArray(const std::vector<glm::vec3>& points) {
 
-    pqxx::result r;
+    std::string array = "{";
+    array.reserve(points.size() * 24 + 2);
 
-    try {
-        pqxx::connection c("dbname=" + _dbname + " user=" + _user + " password=" + _password);
+    char buffer[32];
 
-        pqxx::work w(c);
+    for (size_t i = 0; i < points.size(); i++) {
 
-        r = w.exec(query);
+        if (i)
+            array.push_back(',');
 
-        w.commit();
+        // The shortest form that reads back as the same float
+        array.push_back('{');
+        array.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), points[i].x).ptr);
+        array.push_back(',');
+        array.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), points[i].y).ptr);
+        array.push_back('}');
 
-        std::cout << "Writing to database succeeded" << std::endl;
-    } catch (const std::exception &e) {
-        std::cerr << e.what() << std::endl;
     }
 
-    std::vector<std::string> evaluatedStrings;
+    array.push_back('}');
 
-    //add all the rows into a vector and turn them into strings
-    for (auto row : r) {
-        evaluatedStrings.push_back(row[0].c_str());
-    }
+    return array;
 
-    //wrap the vector in brackets and make it one string
-    std::string evaluatedResult = "[";
+}
 
-    for (std::string s : evaluatedStrings) {
+Database::_Lease::_Lease(const std::shared_ptr<_Pool>& pool) : _pool(pool) {
 
-        evaluatedResult.append(s);
+    std::unique_lock<std::mutex> lock(_pool->lock);
 
-        //newline for readability when debugging
-        evaluatedResult.append(",\n");
-    }
-
-    evaluatedResult.append("]");
+    // Wait for a connection to be put back if we can't open another one
+    _pool->available.wait(lock, [this] { return !_pool->idle.empty() || _pool->open < DB_MAX_CONNECTIONS; });
 
-    //get rid of the trailing comma
-    evaluatedResult.erase(evaluatedResult.size() - 3, 2);
+    if (!_pool->idle.empty()) {
 
-    return evaluatedResult;
+        _connection = std::move(_pool->idle.back());
+        _pool->idle.pop_back();
+        return;
 
-}
-
-std::string Database::selectLengthFitness(std::string query) {
+    }
 
-    pqxx::result r;
+    // Count the connection before opening it so other threads don't go over the limit while we wait
+    _pool->open++;
+    lock.unlock();
 
     try {
-        pqxx::connection c("dbname=" + _dbname + " user=" + _user + " password=" + _password);
 
-        pqxx::work w(c);
+        _connection = connect(_pool->connection_string);
 
-        r = w.exec(query);
+    } catch (...) {
 
-        w.commit();
+        lock.lock();
+        _pool->open--;
+        lock.unlock();
+
+        _pool->available.notify_one();
+        throw;
 
-        std::cout << "Writing to database succeeded" << std::endl;
-    } catch (const std::exception &e) {
-        std::cerr << e.what() << std::endl;
     }
 
-    std::vector<std::string> evaluatedStrings;
+}
 
-    //add all the rows into a vector and turn them into strings
-    for (auto row : r) {
-        evaluatedStrings.push_back(row[0].c_str());
-    }
+Database::_Lease::~_Lease() {
 
-    //wrap the vector in brackets and make it one string
-    std::string evaluatedResult = "[";
+    {
 
-    for (std::string s : evaluatedStrings) {
+        std::lock_guard<std::mutex> lock(_pool->lock);
 
-        evaluatedResult.append(s);
+        // Broken connections are dropped and a new one is opened the next time one is needed
+        if (_connection && _connection->is_open())
+            _pool->idle.push_back(std::move(_connection));
+        else
+            _pool->open--;
 
-        //newline for readability when debugging
-        evaluatedResult.append(",\n");
     }
 
-    evaluatedResult.append("]");
+    _pool->available.notify_one();
 
-    //get rid of the trailing comma
-    evaluatedResult.erase(evaluatedResult.size() - 3, 2);
+}
+
+pqxx::connection& Database::_Lease::get() {
 
-    return evaluatedResult;
+    return *_connection;
 
-}
\ No newline at end of file
+}
@@ -7,11 +7,75 @@
 
 #include <pqxx/pqxx>
 #include <glm/glm.hpp>
+#include "../spline/spline.h"
 #include <iostream>
 #include <algorithm>
+#include <charconv>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
+/** The most connections that are opened to the same database at once */
+#define DB_MAX_CONNECTIONS 8
 
+/** The history of a route, every member is a JSON array with one entry per generation */
+struct RouteHistory {
 
+    /** The evaluated points of the best solution at each generation */
+    std::string solutions;
+
+    /** The total fitness at each generation */
+    std::string total_fitness;
+
+    /** The track fitness at each generation */
+    std::string track_fitness;
+
+    /** The curve fitness at each generation */
+    std::string curve_fitness;
+
+    /** The grade fitness at each generation */
+    std::string grade_fitness;
+
+    /** The length fitness at each generation */
+    std::string length_fitness;
+
+};
+
+/** One generation of a route as it is stored */
+struct GenerationRow {
+
+    /** The id of the route */
+    int route_id;
+
+    /** The index of the generation */
+    int generation;
+
+    /** The control points of the best solution. X and Y are longitude and latitude. */
+    std::vector<glm::vec3> controls;
+
+    /** The kind of curve the control points make */
+    CurveType curve_type;
+
+    /** Points along the curve of the best solution. X and Y are longitude and latitude. */
+    std::vector<glm::vec3> evaluated;
+
+    /** The track, curve, grade and length fitness of the best solution */
+    glm::vec4 fitness;
+
+    /** The weighted total of the fitness of the best solution */
+    double total_fitness;
+
+};
+
+/**
+ * Handles everything that is stored in the database.
+ *
+ * Opening a connection is much slower than any of the queries that are run, so connections are kept open in a pool
+ * and reused. Every Database with the same credentials shares the same pool, so it is cheap to create one. Every
+ * query is prepared once per connection when the connection is opened.
+ */
 class Database {
 public:
 
@@ -33,106 +97,162 @@ public:
     /**
      * Inserts the initial route parameters
      *
-     * @param query
-     * The query to be executed
-     */
-    void initRoute(std::string query);
-
-    /**
-     * Performs the next val queries in order to maintain foreign key integrity
+     * @param lat_start
+     * The latitude of the start of the route
      *
-     * @param queries
-     * A vector of queries to get the next vals
+     * @param lat_end
+     * The latitude of the end of the route
      *
-     * @return
-     * A vector of the ids that were returned by the queries
-     */
-    glm::vec3 getNextIds(std::vector<std::string> queries);
-
-    /**
-     * Inserts all the resulting information into the database
+     * @param long_start
+     * The longitude of the start of the route
      *
-     * @param queries
-     * A vector of the queries to be executed
-     */
-    void batchInsert(std::vector<std::string> queries);
-
-    /**
-     * Selects the solutions from the db
-     *
-     * @param query
-     * The query to select the solutions
+     * @param long_end
+     * The longitude of the end of the route
      *
      * @return
-     * The JSON string to do the select
+     * The route_id of the new route, 0 if it could not be inserted
      */
-    std::string selectSolutions(std::string query);
+    int initRoute(double lat_start, double lat_end, double long_start, double long_end);
 
     /**
-     * Selects the total fitness from the db
+     * Writes generations into the controls, generation and fitness tables. The ids of the new rows are taken first and
+     * then every table is filled with a single COPY, all in one transaction.
      *
-     * @param query
-     * The query to select the totalFitness
+     * @param rows
+     * The generations to write, they can belong to different routes
      *
      * @return
-     * The JSON string to do the select
+     * True if everything was written
      */
-    std::string selectTotalFitness(std::string query);
+    bool insertGenerations(const std::vector<GenerationRow>& rows);
 
     /**
-     * Selects the track fitness from the db
+     * Selects the solutions and every fitness of a route with a single query
      *
-     * @param query
-     * The query to select the trackFitness
+     * @param route_id
+     * The id of the route
      *
      * @return
-     * The JSON string to do the select
+     * The history of the route, the arrays are empty if nothing could be selected
      */
-    std::string selectTrackFitness(std::string query);
+    RouteHistory selectHistory(int route_id);
+
+private:
+
+    /** The open connections to one database */
+    struct _Pool {
+
+        /** The string used to open new connections */
+        std::string connection_string;
+
+        /** Guards the rest of the pool */
+        std::mutex lock;
+
+        /** Signaled every time a connection is put back */
+        std::condition_variable available;
+
+        /** The connections that are not being used */
+        std::vector<std::unique_ptr<pqxx::connection>> idle;
+
+        /** The number of connections that are open, including the ones being used */
+        int open = 0;
+
+    };
+
+    /** A connection that is borrowed from the pool and put back when this goes out of scope */
+    class _Lease {
+    public:
+
+        /**
+         * Borrows a connection, opening one if none are idle. This waits if DB_MAX_CONNECTIONS are in use.
+         *
+         * @param pool
+         * The pool to borrow from
+         */
+        explicit _Lease(const std::shared_ptr<_Pool>& pool);
+
+        /** Puts the connection back unless it broke */
+        ~_Lease();
+
+        /**
+         * Gets the connection
+         *
+         * @return
+         * The connection
+         */
+        pqxx::connection& get();
+
+    private:
+
+        /** The pool the connection came from */
+        std::shared_ptr<_Pool> _pool;
+
+        /** The borrowed connection */
+        std::unique_ptr<pqxx::connection> _connection;
+
+    };
 
     /**
-     * Selects the curve fitness from the db
+     * Opens a new connection and prepares every statement on it
      *
-     * @param query
-     * The query to select the curve fitness
+     * @param connection_string
+     * The string used to open the connection
      *
      * @return
-     * The JSON string to do the select
+     * The connection
      */
-    std::string selectCurveFitness(std::string query);
+    static std::unique_ptr<pqxx::connection> connect(const std::string& connection_string);
 
     /**
-     * Selects the grade fitness from the db
+     * Converts a column of a result to a JSON array
      *
-     * @param query
-     * The query to select the grade fitness
+     * @param r
+     * The result
+     *
+     * @param column
+     * The column to convert
+     *
+     * @param arrays
+     * True if the column holds postgres arrays, which need their curly braces changed to brackets
      *
      * @return
-     * The JSON string to do the select
+     * The JSON array
      */
-    std::string selectGradeFitness(std::string query);
+    static std::string columnToJSON(const pqxx::result& r, int column, bool arrays);
 
     /**
-     * Selects the length fitness from the db
+     * Formats the longitude and latitude of points as a postgres array
      *
-     * @param query
-     * The query to select the length fitness
+     * @param points
+     * The points, X and Y are longitude and latitude
      *
      * @return
-     * The JSON string to do the select
+     * The array in the text format that COPY reads
      */
-    std::string selectLengthFitness(std::string query);
+    static std::string pointsToArray(const std::vector<glm::vec3>& points);
 
-private:
+    /** The pool that this database borrows connections from */
+    std::shared_ptr<_Pool> _pool;
 
-    /** The name of the database */
-    std::string _dbname;
+    /** Every pool that has been made, keyed by connection string */
+    struct _Pools {
 
-    /** The name of the user that owns the database */
-    std::string _user;
+        /** Guards pools */
+        std::mutex lock;
 
-    /** The password for the database */
-    std::string _password;
+        /** The pools */
+        std::unordered_map<std::string, std::shared_ptr<_Pool>> pools;
+
+    };
+
+    /**
+     * Gets the pools. They are a local static so that they exist before any Database that is itself a static, like
+     * the one in Routes, is constructed.
+     *
+     * @return
+     * The pools
+     */
+    static _Pools& getPools();
 
 };
 
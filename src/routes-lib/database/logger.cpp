@@ -0,0 +1,207 @@
+//
+//  logger.cpp
+//  Routes
+//
+
+#include "logger.h"
+
+std::vector<GenerationRow> GenerationLogger::_queue;
+size_t GenerationLogger::_head = 0;
+size_t GenerationLogger::_size = 0;
+std::unordered_map<int, int> GenerationLogger::_pending;
+size_t GenerationLogger::_dropped = 0;
+int GenerationLogger::_waiting = 0;
+bool GenerationLogger::_stopping = false;
+std::mutex GenerationLogger::_lock;
+std::condition_variable GenerationLogger::_queued;
+std::condition_variable GenerationLogger::_written;
+std::thread GenerationLogger::_writer;
+
+bool GenerationLogger::log(int route_id, int generation, const std::vector<glm::vec3>& controls, CurveType curve_type,
+                           const glm::vec4& fitness, double total_fitness) {
+
+    {
+
+        std::lock_guard<std::mutex> lock(_lock);
+
+        // The writer may already have emptied the queue for the last time, so nothing would ever write this
+        if (_stopping) {
+            _dropped++;
+            return false;
+        }
+
+        start();
+
+        // Rather lose some history than slow down the genetic algorithm
+        if (_size == LOGGER_QUEUE_SIZE) {
+            _dropped++;
+            return false;
+        }
+
+        // Reuse the slot so the vectors keep their memory
+        GenerationRow& row = _queue[(_head + _size) % LOGGER_QUEUE_SIZE];
+        row.route_id = route_id;
+        row.generation = generation;
+        row.controls.assign(controls.begin(), controls.end());
+        row.curve_type = curve_type;
+        row.fitness = fitness;
+        row.total_fitness = total_fitness;
+
+        _size++;
+        _pending[route_id]++;
+
+    }
+
+    _queued.notify_one();
+
+    return true;
+
+}
+
+void GenerationLogger::waitForRoute(int route_id) {
+
+    std::unique_lock<std::mutex> lock(_lock);
+
+    if (_pending.find(route_id) == _pending.end())
+        return;
+
+    // Tell the writer not to hold on to a partial batch
+    _waiting++;
+    _queued.notify_one();
+
+    _written.wait(lock, [route_id] { return _pending.find(route_id) == _pending.end(); });
+
+    _waiting--;
+
+}
+
+size_t GenerationLogger::getDropped() {
+
+    std::lock_guard<std::mutex> lock(_lock);
+
+    return _dropped;
+
+}
+
+void GenerationLogger::stop() {
+
+    {
+
+        std::lock_guard<std::mutex> lock(_lock);
+
+        if (!_writer.joinable())
+            return;
+
+        _stopping = true;
+
+    }
+
+    _queued.notify_one();
+
+    // The writer empties the queue before it returns
+    _writer.join();
+
+    std::lock_guard<std::mutex> lock(_lock);
+    _stopping = false;
+
+}
+
+void GenerationLogger::start() {
+
+    if (_writer.joinable())
+        return;
+
+    _queue.resize(LOGGER_QUEUE_SIZE);
+
+    // The writer runs until stop is called
+    _writer = std::thread(writerLoop);
+
+}
+
+void GenerationLogger::writerLoop() {
+
+    std::vector<GenerationRow> batch;
+
+    for (;;) {
+
+        {
+
+            std::unique_lock<std::mutex> lock(_lock);
+
+            _queued.wait(lock, [] { return _size > 0 || _stopping; });
+
+            if (!_size)
+                return;
+
+            // Give the genetic algorithm a moment to fill a batch, unless someone is waiting for it
+            _queued.wait_for(lock, std::chrono::milliseconds(LOGGER_FLUSH_INTERVAL),
+                             [] { return _size >= LOGGER_BATCH_SIZE || _waiting > 0 || _stopping; });
+
+            size_t count = std::min(_size, (size_t)LOGGER_BATCH_SIZE);
+            batch.resize(count);
+
+            // Swap the rows out so that no points are copied while the lock is held
+            for (size_t i = 0; i < count; i++)
+                std::swap(batch[i], _queue[(_head + i) % LOGGER_QUEUE_SIZE]);
+
+            _head = (_head + count) % LOGGER_QUEUE_SIZE;
+            _size -= count;
+
+        }
+
+        write(batch);
+        finish(batch);
+
+    }
+
+}
+
+void GenerationLogger::write(std::vector<GenerationRow>& batch) {
+
+    // Meters are snapped to pixels on the way to longitude and latitude, so the conversion is not linear and the curve
+    // has to be evaluated in meters before each of its points is converted
+    auto toLongitudeLatitude = [](std::vector<glm::vec3>& points) {
+
+        for (glm::vec3& point : points) {
+            glm::dvec2 conv = ElevationData::metersToLongitudeLatitude({point.x, point.y});
+            point = glm::vec3(conv.x, conv.y, point.z);
+        }
+
+    };
+
+    for (GenerationRow& row : batch) {
+
+        row.evaluated = Spline::evaluateEntireCurve(row.controls, LOGGER_EVALUATED_POINTS, row.curve_type);
+
+        toLongitudeLatitude(row.controls);
+        toLongitudeLatitude(row.evaluated);
+
+    }
+
+    Database db = Database("evie", "evie", "evolution");
+
+    if (!db.insertGenerations(batch))
+        std::cerr << "Could not write " << batch.size() << " generations to the database" << std::endl;
+
+}
+
+void GenerationLogger::finish(const std::vector<GenerationRow>& batch) {
+
+    {
+
+        std::lock_guard<std::mutex> lock(_lock);
+
+        for (const GenerationRow& row : batch) {
+
+            auto it = _pending.find(row.route_id);
+
+            if (it != _pending.end() && --it->second == 0)
+                _pending.erase(it);
+
+        }
+
+    }
+
+    _written.notify_all();
+
+}
@@ -0,0 +1,152 @@
+//
+//  logger.h
+//  Routes
+//
+
+#ifndef ROUTES_LOGGER_H
+#define ROUTES_LOGGER_H
+
+#include "database.h"
+#include "../elevation/elevation.h"
+#include "../spline/spline.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/** The most generations that can be waiting to be written, more than this are dropped */
+#define LOGGER_QUEUE_SIZE 4096
+
+/** The most generations that are written with one COPY */
+#define LOGGER_BATCH_SIZE 256
+
+/** How long the writer waits for a full batch before writing what it has (milliseconds) */
+#define LOGGER_FLUSH_INTERVAL 500
+
+/** The number of points of the best solution that are stored for every generation */
+#define LOGGER_EVALUATED_POINTS 100
+
+/**
+ * Writes the history of routes to the database on a background thread.
+ *
+ * The genetic algorithm hands over the raw numbers of every generation and goes straight back to work. Evaluating the
+ * curve, formatting the rows and talking to the database all happen on the writer thread, which streams whole batches
+ * of generations at once with COPY. The queue is a fixed size ring buffer, if the database falls behind new
+ * generations are dropped instead of making the genetic algorithm wait.
+ */
+class GenerationLogger {
+
+    public:
+
+        /**
+         * Queues a generation to be written. This never waits on the database.
+         *
+         * @param route_id
+         * The id of the route the generation belongs to
+         *
+         * @param generation
+         * The index of the generation
+         *
+         * @param controls
+         * The control points of the best solution in meters
+         *
+         * @param curve_type
+         * The kind of curve the control points make
+         *
+         * @param fitness
+         * The track, curve, grade and length fitness of the best solution
+         *
+         * @param total_fitness
+         * The weighted total of the fitness of the best solution
+         *
+         * @return
+         * False if the queue was full or the logger is stopping, and the generation was dropped
+         */
+        static bool log(int route_id, int generation, const std::vector<glm::vec3>& controls, CurveType curve_type,
+                        const glm::vec4& fitness, double total_fitness);
+
+        /**
+         * Waits until every generation of a route that has been queued is written or dropped.
+         *
+         * @param route_id
+         * The id of the route
+         */
+        static void waitForRoute(int route_id);
+
+        /**
+         * Gets the number of generations that have been dropped because the queue was full.
+         *
+         * @return
+         * The number of dropped generations
+         */
+        static size_t getDropped();
+
+        /**
+         * Writes everything that is queued and stops the writer thread. This has to be called before the process
+         * exits. Logging again afterwards starts a new writer.
+         */
+        static void stop();
+
+    private:
+
+        /** Starts the writer thread if it is not running. _lock must be held. */
+        static void start();
+
+        /** Writes batches from the queue until stop is called and the queue is empty */
+        static void writerLoop();
+
+        /**
+         * Evaluates the curve of every row, converts the points to longitude and latitude and writes them.
+         *
+         * @param batch
+         * The rows to write, with the points in meters
+         */
+        static void write(std::vector<GenerationRow>& batch);
+
+        /**
+         * Marks generations as no longer pending so that anyone waiting on their routes can go on.
+         *
+         * @param batch
+         * The records that were written or dropped
+         */
+        static void finish(const std::vector<GenerationRow>& batch);
+
+        /** The queued records, _size of them starting at _head and wrapping around */
+        static std::vector<GenerationRow> _queue;
+
+        /** The index of the oldest queued record */
+        static size_t _head;
+
+        /** The number of queued records */
+        static size_t _size;
+
+        /** The number of records of every route that are queued or being written */
+        static std::unordered_map<int, int> _pending;
+
+        /** The number of records that have been dropped */
+        static size_t _dropped;
+
+        /** The number of threads in waitForRoute */
+        static int _waiting;
+
+        /** Set by stop to tell the writer to finish up. Nothing is queued while this is set */
+        static bool _stopping;
+
+        /** Guards everything above */
+        static std::mutex _lock;
+
+        /** Signaled when records are queued */
+        static std::condition_variable _queued;
+
+        /** Signaled when records are written */
+        static std::condition_variable _written;
+
+        /** The thread that writes to the database */
+        static std::thread _writer;
+
+};
+
+#endif //ROUTES_LOGGER_H
@@ -18,6 +18,12 @@ int ElevationData::_StaticGDAL::_height;
 double ElevationData::_StaticGDAL::_width_meters;
 double ElevationData::_StaticGDAL::_height_meters;
 double ElevationData::_StaticGDAL::_pixelToMeterConversions[2];
+std::mutex ElevationData::_StaticGDAL::_gdal_lock;
+std::unique_ptr<TileStore> ElevationData::_StaticGDAL::_tile_store;
+
+// This is made after _init has opened the dataset, so the size of the raster is known
+TileCache ElevationData::_tiles = TileCache(glm::ivec2(_StaticGDAL::_width, _StaticGDAL::_height),
+                                            (size_t)TILE_CACHE_MEMORY_MB << 20, ElevationData::readRaster);
 
 ElevationData::_StaticGDAL::_StaticGDAL() {
     
@@ -26,6 +32,34 @@ ElevationData::_StaticGDAL::_StaticGDAL() {
     
     // We don't throw an error here because this function is still called when we rebuild and we don't want to crash
     // Would love to use boost::filesystem::exists() here but it throws an exception and hasn't been fixed.
+    if (std::ifstream(TILE_STORE_PATH)) {
+
+        // The tile store has everything that is needed, so GDAL never has to open the virtual dataset
+        try {
+
+            _tile_store = std::make_unique<TileStore>(TILE_STORE_PATH);
+
+            std::cout << "Statically initializing the tile store\n";
+
+            std::copy(_tile_store->getTransform(), _tile_store->getTransform() + 6, _gdal_transform);
+            _width  = _tile_store->getSize().x;
+            _height = _tile_store->getSize().y;
+
+            calcConversions();
+            calcStats();
+
+            return;
+
+        } catch (const std::exception& e) {
+
+            // Fall back to GDAL
+            std::cerr << e.what() << std::endl;
+            _tile_store.reset();
+
+        }
+
+    }
+
     if (std::ifstream(GDAL_DB_PATH)) {
         
         // Open up the GDAL dataset
@@ -35,6 +69,11 @@ ElevationData::_StaticGDAL::_StaticGDAL() {
         
         // Get the raster band
         _gdal_raster_band = _gdal_dataset->GetRasterBand(1);
+
+        // Read the transform and the size from GDAL (we assume that we get something)
+        _gdal_dataset->GetGeoTransform(_gdal_transform);
+        _width =  _gdal_dataset->GetRasterXSize();
+        _height = _gdal_dataset->GetRasterYSize();
         
         calcConversions();
         calcStats();
@@ -53,9 +92,6 @@ ElevationData::_StaticGDAL::~_StaticGDAL() {
 
 void ElevationData::_StaticGDAL::calcConversions() {
     
-    // First read the transform from GDAL (we assume that we get something)
-    _gdal_dataset->GetGeoTransform(_gdal_transform);
-    
     // Calculate conversion factors based on the size of pixels in degrees.
     // This uses a simplified formula of degrees -> arcseconds -> meters
     double degrees_to_meters = EARTH_RADIUS * M_PI / 180.0;
@@ -70,10 +106,6 @@ void ElevationData::_StaticGDAL::calcConversions() {
 
 void ElevationData::_StaticGDAL::calcStats() {
     
-    // Get the width and height in pixels
-    _width =  _gdal_dataset->GetRasterXSize();
-    _height = _gdal_dataset->GetRasterYSize();
-    
     // Get the width and height in meters using the conversions
     _width_meters  = _width * _pixelToMeterConversions[0];
     _height_meters = _height * _pixelToMeterConversions[1];
@@ -82,9 +114,9 @@ void ElevationData::_StaticGDAL::calcStats() {
 
 /***********************************************************************************************************************************************/
 
-ElevationData::ElevationData(const glm::dvec2& start, const glm::dvec2& dest) {
+ElevationData::ElevationData(const glm::dvec2& start, const glm::dvec2& dest, int levels, bool opencl) {
 
-    if (!_StaticGDAL::_gdal_dataset)
+    if (!_StaticGDAL::_gdal_dataset && !_StaticGDAL::_tile_store)
         throw std::runtime_error("The database could not be loaded from the disk. Make sure to build it first.");
     
     // Before we do anything we do a sanity check
@@ -97,7 +129,7 @@ ElevationData::ElevationData(const glm::dvec2& start, const glm::dvec2& dest) {
 
     // Get the size and then make the image
     calcCroppedSize(start, dest);
-    createOpenCLImage();
+    createOpenCLImage(levels, opencl);
 
 }
 
@@ -110,7 +142,13 @@ double ElevationData::getHeightInMeters() const { return _StaticGDAL::_height_me
 double ElevationData::getMinElevation() const { return _elevation_min; }
 double ElevationData::getMaxElevation() const { return _elevation_max; }
 
-const boost::compute::image2d& ElevationData::getOpenCLImage() const { return _opencl_image; }
+const boost::compute::image2d& ElevationData::getOpenCLImage(int level) const { return _opencl_pyramid[level]; }
+
+int ElevationData::getNumLevels() const { return (int)_pyramid_pixels.size(); }
+
+const std::vector<float>& ElevationData::getPixels(int level) const { return _pyramid_pixels[level]; }
+
+glm::ivec2 ElevationData::getPixelSize(int level) const { return _pyramid_sizes[level]; }
 
 glm::dvec2 ElevationData::convertPixelsToMeters(const glm::ivec2& pos_pixels) const {
 
@@ -120,7 +158,7 @@ glm::dvec2 ElevationData::convertPixelsToMeters(const glm::ivec2& pos_pixels) co
 
 }
 
-glm::ivec2 ElevationData::metersToPixels(const glm::dvec2 &pos_meters) const {
+glm::ivec2 ElevationData::metersToPixels(const glm::dvec2 &pos_meters) {
 
     // Divide by the conversion factors
     return glm::ivec2(pos_meters.x / _StaticGDAL::_pixelToMeterConversions[0],
@@ -128,7 +166,7 @@ glm::ivec2 ElevationData::metersToPixels(const glm::dvec2 &pos_meters) const {
 
 }
 
-glm::dvec2 ElevationData::metersToLongitudeLatitude(const glm::dvec2& pos_meters) const {
+glm::dvec2 ElevationData::metersToLongitudeLatitude(const glm::dvec2& pos_meters) {
 
     // Convert back to pixels
     glm::ivec2 pos_pixels = metersToPixels(pos_meters);
@@ -138,7 +176,7 @@ glm::dvec2 ElevationData::metersToLongitudeLatitude(const glm::dvec2& pos_meters
 
 }
 
-glm::dvec2 ElevationData::pixelsToLongitudeLatitude(const glm::ivec2& pos_pixels) const {
+glm::dvec2 ElevationData::pixelsToLongitudeLatitude(const glm::ivec2& pos_pixels) {
 
     // Convert using the GDAL transform
     // Formula can be found in the GDAL tutorial
@@ -174,9 +212,7 @@ glm::dvec3 ElevationData::metersToMetersAndElevation(const glm::dvec2& pos_meter
     glm::ivec2 pos_pixels = metersToPixels(pos_meters);
 
     // Do the sample
-    CPLErr err = _StaticGDAL::_gdal_raster_band->RasterIO(GF_Read, pos_pixels.x, pos_pixels.y, 1, 1, &z, 1, 1, GDT_Float32, 0, 0);
-    if (err)
-        throw std::runtime_error("There was an error reading from the dataset");
+    readPixels(pos_pixels, glm::ivec2(1, 1), &z);
 
     pos_meters_sample.z = (double)z;
 
@@ -184,19 +220,57 @@ glm::dvec3 ElevationData::metersToMetersAndElevation(const glm::dvec2& pos_meter
 
 }
 
-float ElevationData::metersToElevation(const glm::dvec2& pos_meters) const {
-    glm::dvec3 pos_meters_sample = glm::dvec3(pos_meters.x, pos_meters.y, 0.0);
+float ElevationData::metersToElevation(const glm::dvec2& pos_meters, TerrainFilter filter) const {
+
     float z = 0.0;
 
-    // Get the pixel position
-    glm::ivec2 pos_pixels = metersToPixels(pos_meters);
+    if (filter == TerrainFilter::Nearest) {
 
-    // Do the sample
-    CPLErr err = _StaticGDAL::_gdal_raster_band->RasterIO(GF_Read, pos_pixels.x, pos_pixels.y, 1, 1, &z, 1, 1, GDT_Float32, 0, 0);
-    if (err)
-        throw std::runtime_error("There was an error reading from the dataset");
+        // Get the pixel position
+        glm::ivec2 pos_pixels = metersToPixels(pos_meters);
+
+        // Do the sample
+        readPixels(pos_pixels, glm::ivec2(1, 1), &z);
+
+        return z;
+
+    }
+
+    // Pixels are sampled at their centers, the same as OpenCL images are
+    glm::dvec2 pos_pixels = glm::dvec2(pos_meters.x / _StaticGDAL::_pixelToMeterConversions[0],
+                                       pos_meters.y / _StaticGDAL::_pixelToMeterConversions[1]) - 0.5;
+    glm::dvec2 base = glm::floor(pos_pixels);
+    glm::vec2 frac = glm::vec2(pos_pixels - base);
+
+    // Bicubic needs one more pixel on each side than bilinear
+    int size = filter == TerrainFilter::Bicubic ? 4 : 2;
+    glm::ivec2 first = glm::ivec2(base) - (size / 2 - 1);
+
+    // Read the part of the window that is inside the raster, the rest is clamped to its edge like OpenCL does
+    glm::ivec2 max_pixel = glm::ivec2(_StaticGDAL::_width - 1, _StaticGDAL::_height - 1);
+    glm::ivec2 read_origin = glm::clamp(first, glm::ivec2(0), max_pixel);
+    glm::ivec2 read_size = glm::clamp(first + size - 1, glm::ivec2(0), max_pixel) - read_origin + 1;
+
+    float read[16];
+    readPixels(read_origin, read_size, read);
+
+    float window[16];
+
+    for (int y = 0; y < size; y++) {
+
+        int read_y = glm::clamp(first.y + y, read_origin.y, read_origin.y + read_size.y - 1) - read_origin.y;
+
+        for (int x = 0; x < size; x++) {
+
+            int read_x = glm::clamp(first.x + x, read_origin.x, read_origin.x + read_size.x - 1) - read_origin.x;
+            window[y * size + x] = read[read_y * read_size.x + read_x];
+
+        }
+
+    }
+
+    return interpolate(window, frac, filter);
 
-    return z;
 }
 
 glm::dvec3 ElevationData::pixelsToMetersAndElevation(const glm::ivec2& pos_pixels) const {
@@ -206,9 +280,10 @@ glm::dvec3 ElevationData::pixelsToMetersAndElevation(const glm::ivec2& pos_pixel
     glm::dvec3 pos_meters_sample = glm::dvec3(pos_meters.x, pos_meters.y, 0.0);
 
     // Now get the sample instead of calling metersToMetersAndElevation because GDAL _samples in pixels
-    CPLErr err = _StaticGDAL::_gdal_raster_band->RasterIO(GF_Read, pos_pixels.x, pos_pixels.y, 1, 1, &pos_meters_sample.z, 1, 1, GDT_Float32, 0, 0);
-    if (err)
-        throw std::runtime_error("There was an error reading from the dataset");
+    float z = 0.0;
+    readPixels(pos_pixels, glm::ivec2(1, 1), &z);
+
+    pos_meters_sample.z = (double)z;
 
     return pos_meters_sample;
 
@@ -218,8 +293,7 @@ bool ElevationData::routeInsideData(const glm::dvec2& start, const glm::dvec2& d
 
     // Get the origin and extent as points
     glm::dvec2 origin = pixelsToLongitudeLatitude(glm::ivec2(0));
-    glm::dvec2 extent = pixelsToLongitudeLatitude(glm::ivec2(_StaticGDAL::_gdal_dataset->GetRasterXSize(),
-                                                             _StaticGDAL::_gdal_dataset->GetRasterYSize()));
+    glm::dvec2 extent = pixelsToLongitudeLatitude(glm::ivec2(_StaticGDAL::_width, _StaticGDAL::_height));
 
     // Check if start is outside
     if (start.x < origin.x || start.x > extent.x ||
@@ -258,78 +332,87 @@ void ElevationData::calcCroppedSize(const glm::dvec2& start, const glm::dvec2& d
 
 }
 
-void ElevationData::createOpenCLImage() {
+void ElevationData::createOpenCLImage(int levels, bool opencl) {
 
     // Convert the cropped rect to pixels
     glm::ivec2 crop_origin_p = longitudeLatitudeToPixels(_crop_origin);
     glm::ivec2 crop_extent_p = longitudeLatitudeToPixels(_crop_extent);
 
     // Make sure that the coordinates are inside the raster image
-    glm::ivec2 crop_origin_c = glm::ivec2(glm::clamp(crop_origin_p.x, 0, _StaticGDAL::_gdal_dataset->GetRasterXSize()),
-                                          glm::clamp(crop_origin_p.y, 0, _StaticGDAL::_gdal_dataset->GetRasterYSize()));
-    glm::ivec2 crop_extent_c = glm::ivec2(glm::clamp(crop_extent_p.x, 0, _StaticGDAL::_gdal_dataset->GetRasterXSize()),
-                                          glm::clamp(crop_extent_p.y, 0, _StaticGDAL::_gdal_dataset->GetRasterYSize()));
+    glm::ivec2 crop_origin_c = glm::ivec2(glm::clamp(crop_origin_p.x, 0, _StaticGDAL::_width),
+                                          glm::clamp(crop_origin_p.y, 0, _StaticGDAL::_height));
+    glm::ivec2 crop_extent_c = glm::ivec2(glm::clamp(crop_extent_p.x, 0, _StaticGDAL::_width),
+                                          glm::clamp(crop_extent_p.y, 0, _StaticGDAL::_height));
 
     // Calculate the adjusted width and height
     glm::ivec2 size = crop_extent_c - crop_origin_c;
 
-    static size_t max_size = Kernel::getDevice().get_info<CL_DEVICE_IMAGE2D_MAX_WIDTH>();
-
     // Ensure that we can actually fit all of the data required for this route
     // Otherwise throw and exception
-    if (size.x >= max_size || size.y >= max_size)
-        throw std::runtime_error("Route was too large to calculate");
+    if (opencl) {
+
+        static size_t max_size = Kernel::getDevice().get_info<CL_DEVICE_IMAGE2D_MAX_WIDTH>();
 
+        if (size.x >= max_size || size.y >= max_size)
+            throw std::runtime_error("Route was too large to calculate");
+
+    }
 
     // OpenCL needs image data to be in a 1D double array.
     // Go line by line and read GDAL data to get the data in the format we need
     std::vector<float> image_data = std::vector<float>(size.x * size.y);
 
     long long int start = std::chrono::high_resolution_clock::now().time_since_epoch().count();
-    
-    for (int i = 0; i < size.y; i++) {
 
-        CPLErr err = _StaticGDAL::_gdal_raster_band->RasterIO(GF_Read, crop_origin_c.x, i + crop_origin_c.y, size.x,
-                                                                       1, &image_data[size.x * i], size.x, 1, GDT_Float32, 0, 0);
-        if (err)
-            throw std::runtime_error("There was an error reading from the dataset");
-
-    }
+    // Assemble the crop from the tiles, only the ones that no route has read yet come from the disk
+    readPixels(crop_origin_c, size, &image_data[0]);
     
     long long int end = std::chrono::high_resolution_clock::now().time_since_epoch().count();
     std::cout << "Copying took " << end - start << std::endl;
     start = end;
 
-    // Create the OpenCL image
-    boost::compute::image_format format = boost::compute::image_format(CL_INTENSITY, CL_FLOAT);
-    _opencl_image = boost::compute::image2d(Kernel::getContext(), size.x, size.y, format, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, &image_data[0]);
-
-    // Figure out the min and max elevations
-    // Get stuff we need to execute a kernel on
-    const boost::compute::context& ctx =   Kernel::getContext();
-    boost::compute::command_queue& queue = Kernel::getQueue();
+    // Figure out the min and max elevations. The pixels are already on the CPU, so this is one pass over them
+    glm::vec2 extrema = findExtrema(image_data);
 
-    std::vector<float>            min_max_host = {1000000.0, -1000000.0};
-    boost::compute::vector<float> min_max_device(2, ctx);
-    
-    // Create a temporary kernel and execute it
-    static Kernel extrema_kernel = Kernel(std::ifstream("../opencl/kernel_minmax.opencl"), "computeMinMax");
-    
-    start = std::chrono::high_resolution_clock::now().time_since_epoch().count();
-    extrema_kernel.setArgs(_opencl_image, min_max_device.get_buffer(), size.x, size.y);
-    extrema_kernel.execute1D(0, size.x);
+    _elevation_min = extrema.x;
+    _elevation_max = extrema.y;
 
-    boost::compute::copy(min_max_device.begin(), min_max_device.end(), min_max_host.begin(), queue);
-    
     end = std::chrono::high_resolution_clock::now().time_since_epoch().count();
     std::cout << "Min max took  " << end - start << std::endl;
     start = end;
-    
-    _elevation_min = min_max_host[0];
-    _elevation_max = min_max_host[1];
 
     std::cout << _elevation_min << " " << _elevation_max << std::endl;
 
+    // Build the rest of the pyramid from the data that is still on the CPU. Stop once the image is a single line
+    glm::ivec2 level_size = size;
+
+    _pyramid_sizes.assign(1, size);
+    _pyramid_pixels.clear();
+    _pyramid_pixels.push_back(std::move(image_data));
+
+    for (int level = 1; level < levels && level_size.x > 1 && level_size.y > 1; level++) {
+
+        std::vector<float> level_data = downsample(_pyramid_pixels.back(), level_size);
+
+        _pyramid_sizes.push_back(level_size);
+        _pyramid_pixels.push_back(std::move(level_data));
+
+    }
+
+    // Upload every level for the cost kernel
+    _opencl_pyramid.clear();
+
+    if (!opencl)
+        return;
+
+    boost::compute::image_format format = boost::compute::image_format(CL_INTENSITY, CL_FLOAT);
+
+    for (size_t level = 0; level < _pyramid_pixels.size(); level++)
+        _opencl_pyramid.push_back(boost::compute::image2d(Kernel::getContext(), _pyramid_sizes[level].x,
+                                                          _pyramid_sizes[level].y, format,
+                                                          CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                                          &_pyramid_pixels[level][0]));
+
 }
 
 glm::dvec2 ElevationData::getCroppedSizeMeters() const {
@@ -351,3 +434,131 @@ double ElevationData::getLongestAllowedRoute() {
                     (float)max_size * _StaticGDAL::_pixelToMeterConversions[1]);
 
 }
+
+TerrainFilter ElevationData::parseTerrainFilter(const std::string& name) {
+
+    if (name == "nearest")
+        return TerrainFilter::Nearest;
+
+    if (name == "bilinear")
+        return TerrainFilter::Bilinear;
+
+    if (name == "bicubic")
+        return TerrainFilter::Bicubic;
+
+    throw std::runtime_error("Unknown terrain filter: " + name);
+
+}
+
+float ElevationData::interpolate(const float* window, const glm::vec2& frac, TerrainFilter filter) {
+
+    if (filter == TerrainFilter::Bilinear) {
+
+        float top    = glm::mix(window[0], window[1], frac.x);
+        float bottom = glm::mix(window[2], window[3], frac.x);
+
+        return glm::mix(top, bottom, frac.y);
+
+    }
+
+    // Catmull-Rom weights, the same ones the cost kernel uses
+    float weights[2][4];
+
+    for (int a = 0; a < 2; a++) {
+
+        float t = frac[a];
+
+        weights[a][0] = ((-0.5f * t + 1.0f) * t - 0.5f) * t;
+        weights[a][1] = (1.5f * t - 2.5f) * t * t + 1.0f;
+        weights[a][2] = ((-1.5f * t + 2.0f) * t + 0.5f) * t;
+        weights[a][3] = (0.5f * t - 0.5f) * t * t;
+
+    }
+
+    float z = 0.0f;
+
+    for (int y = 0; y < 4; y++) {
+
+        float row = 0.0f;
+
+        for (int x = 0; x < 4; x++)
+            row += weights[0][x] * window[y * 4 + x];
+
+        z += weights[1][y] * row;
+
+    }
+
+    return z;
+
+}
+
+void ElevationData::readPixels(const glm::ivec2& origin, const glm::ivec2& size, float* out) {
+
+    // The tile store is already in memory as far as we're concerned, so there's nothing to cache
+    if (_StaticGDAL::_tile_store)
+        _StaticGDAL::_tile_store->read(origin, size, out);
+    else
+        _tiles.read(origin, size, out);
+
+}
+
+void ElevationData::readRaster(const glm::ivec2& origin, const glm::ivec2& size, float* out) {
+
+    // GDAL datasets can't be read from several threads at once
+    std::lock_guard<std::mutex> lock(_StaticGDAL::_gdal_lock);
+
+    CPLErr err = _StaticGDAL::_gdal_raster_band->RasterIO(GF_Read, origin.x, origin.y, size.x, size.y,
+                                                          out, size.x, size.y, GDT_Float32, 0, 0);
+    if (err)
+        throw std::runtime_error("There was an error reading from the dataset");
+
+}
+
+glm::vec2 ElevationData::findExtrema(const std::vector<float>& image) {
+
+    glm::vec2 extrema = glm::vec2(ELEVATION_NODATA_LIMIT, -ELEVATION_NODATA_LIMIT);
+
+    // NODATA is a huge negative number that would otherwise be the minimum
+    for (float z : image) {
+
+        if (std::fabs(z) < ELEVATION_NODATA_LIMIT) {
+
+            extrema.x = glm::min(extrema.x, z);
+            extrema.y = glm::max(extrema.y, z);
+
+        }
+
+    }
+
+    return extrema;
+
+}
+
+std::vector<float> ElevationData::downsample(const std::vector<float>& image, glm::ivec2& size) {
+
+    glm::ivec2 half = (size + 1) / 2;
+    std::vector<float> out = std::vector<float>(half.x * half.y);
+
+    for (int y = 0; y < half.y; y++) {
+
+        // An odd last row or column is averaged with itself
+        int y0 = 2 * y;
+        int y1 = glm::min(y0 + 1, size.y - 1);
+
+        for (int x = 0; x < half.x; x++) {
+
+            int x0 = 2 * x;
+            int x1 = glm::min(x0 + 1, size.x - 1);
+
+            out[y * half.x + x] = 0.25f * (image[y0 * size.x + x0] + image[y0 * size.x + x1] +
+                                           image[y1 * size.x + x0] + image[y1 * size.x + x1]);
+
+        }
+
+    }
+
+    size = half;
+
+    return out;
+
+}
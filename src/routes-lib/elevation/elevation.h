@@ -11,8 +11,11 @@
 #include <gdal_priv.h>
 #include <glm/glm.hpp>
 #include <glm/gtx/string_cast.hpp>
+#include <mutex>
 
 #include "../opencl/kernel.h"
+#include "tile_cache.h"
+#include "tile_store.h"
 
 /** */
 
@@ -28,9 +31,29 @@
 */
 #define ROUTE_PADDING 0.1
 
+/** Elevations at least this far from 0 in meters are NODATA and are not real terrain */
+#define ELEVATION_NODATA_LIMIT 1000000.0f
+
 /** The location of the virtual dataset that references all of the data */
 #define GDAL_DB_PATH "../data/db.vtf"
 
+/**
+ * How the terrain is sampled between the centers of elevation pixels. The values are passed to the cost kernel as
+ * they are, so they must match the ones it checks for.
+ */
+enum class TerrainFilter {
+
+    /** Takes the pixel the position is in, the terrain is a step function */
+    Nearest = 0,
+
+    /** Blends the 4 closest pixels linearly, the terrain is continuous */
+    Bilinear = 1,
+
+    /** Blends the 16 closest pixels with a Catmull-Rom spline, the terrain has a continuous slope too */
+    Bicubic = 2
+
+};
+
 /**
  * ElevationData is a class that converts elevation data from GDAL into
  * a format that can be read in OpenCL.
@@ -47,8 +70,15 @@ class ElevationData {
          *
          * @param dest
          * The ending position in longitude latitude of the route.
+         *
+         * @param levels
+         * The number of levels of the image pyramid, including the full resolution image.
+         *
+         * @param opencl
+         * Whether to upload the pyramid to OpenCL. Only the OpenCL cost backend reads the images, without them
+         * nothing here touches OpenCL.
          */
-        ElevationData(const glm::dvec2& start, const glm::dvec2& dest);
+        ElevationData(const glm::dvec2& start, const glm::dvec2& dest, int levels = 1, bool opencl = true);
 
         /** Gets the width of the entire raster image in pixels */
         inline int getWidth() const;
@@ -71,8 +101,39 @@ class ElevationData {
         /** Gets the size of the cropped dataset in meters */
         glm::dvec2 getCroppedSizeMeters() const;
 
-        /** Gets the uploaded OpenCL data */
-        const boost::compute::image2d& getOpenCLImage() const;
+        /**
+         * Gets the uploaded OpenCL data. There is none unless the data was made for OpenCL.
+         *
+         * @param level
+         * The level of the pyramid, 0 is the full resolution and every level after has half the pixels on each side.
+         * Every level covers the same area, so it is sampled with the same normalized coordinates.
+         */
+        const boost::compute::image2d& getOpenCLImage(int level = 0) const;
+
+        /** Gets the number of levels in the image pyramid. This can be less than asked for if the crop is small. */
+        int getNumLevels() const;
+
+        /**
+         * Gets the CPU copy of a level of the pyramid, the same pixels that were uploaded to OpenCL.
+         *
+         * @param level
+         * The level of the pyramid, 0 is the full resolution.
+         *
+         * @return
+         * The pixels in rows of getPixelSize(level).x
+         */
+        const std::vector<float>& getPixels(int level = 0) const;
+
+        /**
+         * Gets the width and height of a level of the pyramid in pixels.
+         *
+         * @param level
+         * The level of the pyramid, 0 is the full resolution.
+         *
+         * @return
+         * The size of the level
+         */
+        glm::ivec2 getPixelSize(int level = 0) const;
 
         /**
          * Takes in a location inside the raster image (measured in pixels) and converts that
@@ -96,12 +157,13 @@ class ElevationData {
          * @return
          * The output position in pixels
          */
-        glm::ivec2 metersToPixels(const glm::dvec2 &pos_meters) const;
+        static glm::ivec2 metersToPixels(const glm::dvec2 &pos_meters);
 
         /**
          * Takes in a location inside the raster image (measured in meters) and converts that
          * to longitude and latitude. This gives an absolute position representative of
-         * its corresponding location in the real world.
+         * its corresponding location in the real world. Only the transform of the whole
+         * dataset is used, so no ElevationData has to be alive.
          *
          * @param pos_meters
          * The position in the raster image (in meters) to be converted
@@ -110,7 +172,7 @@ class ElevationData {
          * The output longitude and latitude.
          * return[0] is longitude and return[1] is latitude.
          */
-        glm::dvec2 metersToLongitudeLatitude(const glm::dvec2& pos_meters) const;
+        static glm::dvec2 metersToLongitudeLatitude(const glm::dvec2& pos_meters);
 
         /**
          * Takes in a location inside the raster image (measured in pixels) and converts that
@@ -124,7 +186,7 @@ class ElevationData {
          * The output longitude and latitude.
          * return[0] is longitude and return[1] is latitude.
          */
-        glm::dvec2 pixelsToLongitudeLatitude(const glm::ivec2& pos_pixels) const;
+        static glm::dvec2 pixelsToLongitudeLatitude(const glm::ivec2& pos_pixels);
 
         /**
          * Takes in a position in longitude latitude and converts it to meters.
@@ -166,11 +228,14 @@ class ElevationData {
          *
         * @param pos_meters
         * The position on the raster image in meters where the elevation should be sampled from.
+         *
+         * @param filter
+         * How to sample between pixels. This gives the same elevation as the cost kernel does with the same filter.
         *
         * @return
         * The z coordinate on the terrain in meters
         */
-        float metersToElevation(const glm::dvec2& pos_meters) const;
+        float metersToElevation(const glm::dvec2& pos_meters, TerrainFilter filter = TerrainFilter::Nearest) const;
 
         /**
          * Takes in a location on the image in pixels and samples from the raster data, essentially
@@ -200,6 +265,61 @@ class ElevationData {
         */
         static double getLongestAllowedRoute();
 
+        /**
+         * Gets the terrain filter with the given name.
+         *
+         * @param name
+         * Either "nearest", "bilinear" or "bicubic".
+         *
+         * @return
+         * The terrain filter. Throws a std::runtime_error if the name is not known.
+         */
+        static TerrainFilter parseTerrainFilter(const std::string& name);
+
+        /**
+         * Interpolates a square window of elevations around a position.
+         *
+         * @param window
+         * The elevations in rows, 2x2 for bilinear and 4x4 for bicubic. The position lies between the middle pixels.
+         *
+         * @param frac
+         * How far the position is past the pixel before it on X and Y, in the range [0, 1).
+         *
+         * @param filter
+         * Either TerrainFilter::Bilinear or TerrainFilter::Bicubic.
+         *
+         * @return
+         * The interpolated elevation.
+         */
+        static float interpolate(const float* window, const glm::vec2& frac, TerrainFilter filter);
+
+        /**
+         * Finds the lowest and highest elevation in an image, skipping NODATA pixels.
+         *
+         * @param image
+         * The pixels of the image.
+         *
+         * @return
+         * The lowest elevation in x and the highest in y. If every pixel is NODATA this is
+         * (ELEVATION_NODATA_LIMIT, -ELEVATION_NODATA_LIMIT).
+         */
+        static glm::vec2 findExtrema(const std::vector<float>& image);
+
+        /**
+         * Halves the resolution of an image by averaging every 2x2 block of pixels. When a side has an odd number of
+         * pixels the last pixel is used on its own.
+         *
+         * @param image
+         * The pixels of the image in rows.
+         *
+         * @param size
+         * The width and height of the image, this is changed to the size of the new image.
+         *
+         * @return
+         * The pixels of the new image.
+         */
+        static std::vector<float> downsample(const std::vector<float>& image, glm::ivec2& size);
+
     private:
 
        /*
@@ -230,11 +350,46 @@ class ElevationData {
         void calcCroppedSize(const glm::dvec2& start, const glm::dvec2& dest);
 
         /**
-         * Translate the GDAL data into an OpenCL texture.
-         * This function also uses an OpenCL kernel to calculate the local min and max elevation instead of
-         * the global min and max to decrease the sample space.
+         * Translate the GDAL data into an image pyramid, and into OpenCL textures if they are asked for.
+         * This function also calculates the local min and max elevation instead of the global min and max to
+         * decrease the sample space.
+         *
+         * @param levels
+         * The number of levels of the image pyramid to make.
+         *
+         * @param opencl
+         * Whether to upload every level to OpenCL.
          */
-        void createOpenCLImage();
+        void createOpenCLImage(int levels, bool opencl);
+
+        /**
+         * Reads pixels from the tile store if there is one, otherwise from the tile cache.
+         *
+         * @param origin
+         * The upper left pixel to read.
+         *
+         * @param size
+         * The width and height of the rect to read in pixels.
+         *
+         * @param out
+         * Where the pixels are written, in rows of size.x pixels.
+         */
+        static void readPixels(const glm::ivec2& origin, const glm::ivec2& size, float* out);
+
+        /**
+         * Reads pixels straight from the GDAL dataset. This is how the tile cache loads tiles, everything else should
+         * read through the cache.
+         *
+         * @param origin
+         * The upper left pixel to read.
+         *
+         * @param size
+         * The width and height of the rect to read in pixels.
+         *
+         * @param out
+         * Where the pixels are written, in rows of size.x pixels.
+         */
+        static void readRaster(const glm::ivec2& origin, const glm::ivec2& size, float* out);
 
         /** The minimum elevation in meters of the terrain in the raster image in meters */
         double _elevation_min;
@@ -248,8 +403,20 @@ class ElevationData {
         /** The extent (origin + size) of the subset of data that was taken to encapsulate the route in longitude latitude */
         glm::dvec2 _crop_extent;
 
-        /** The OpenCL image that is created once the data is loaded up from GDAL */
-        boost::compute::image2d _opencl_image;
+        /**
+         * The OpenCL images that are created once the data is loaded up from GDAL, one for every level of
+         * _pyramid_pixels. This is empty when the data was not made for OpenCL.
+         */
+        std::vector<boost::compute::image2d> _opencl_pyramid;
+
+        /**
+         * The pixels of every level of the pyramid. The first is the full resolution, every one after is downsampled
+         * from the one before it.
+         */
+        std::vector<std::vector<float>> _pyramid_pixels;
+
+        /** The width and height of every level of _pyramid_pixels in pixels */
+        std::vector<glm::ivec2> _pyramid_sizes;
     
 /***********************************************************************************************************************************************/
 
@@ -306,12 +473,27 @@ class ElevationData {
                  * pixelToMeterConversions[0] corresponds to X, _pixelToMeterConversions[1] corresponds to y.
                  */
                 static double _pixelToMeterConversions[2];
+
+                /** GDAL raster bands are not thread safe, so every read from the dataset has to hold this lock */
+                static std::mutex _gdal_lock;
+
+                /**
+                 * The preprocessed tiles, if the database has been rebuilt with them. When this is open the GDAL
+                 * dataset isn't opened at all.
+                 */
+                static std::unique_ptr<TileStore> _tile_store;
             
         };
     
         /** The static instance of _StaticGDAL responsible for managing all of the data from GDAL */
         static _StaticGDAL _init;
 
+        /**
+         * The tiles of the dataset that have been read, shared by every route. Routes in the same area read the same
+         * tiles, so they only have to be decoded from the disk once.
+         */
+        static TileCache _tiles;
+
 };
 
 #endif //ROUTES_ELEVATION_H
@@ -0,0 +1,142 @@
+//
+//  tile_cache.cpp
+//  Routes
+//
+
+#include "tile_cache.h"
+
+TileCache::TileCache(const glm::ivec2& raster_size, size_t memory_budget, TileLoader loader) :
+    _raster_size(raster_size), _memory_budget(memory_budget), _loader(std::move(loader)), _memory_used(0) {}
+
+void TileCache::read(const glm::ivec2& origin, const glm::ivec2& size, float* out) {
+
+    if (origin.x < 0 || origin.y < 0 || size.x <= 0 || size.y <= 0 ||
+            origin.x + size.x > _raster_size.x || origin.y + size.y > _raster_size.y)
+        throw std::runtime_error("Attempted to read outside of the dataset");
+
+    glm::ivec2 first = origin / TILE_SIZE;
+    glm::ivec2 last  = (origin + size - 1) / TILE_SIZE;
+
+    for (int ty = first.y; ty <= last.y; ty++) {
+
+        for (int tx = first.x; tx <= last.x; tx++) {
+
+            std::shared_ptr<const _Tile> tile = getTile(glm::ivec2(tx, ty));
+
+            // Find the part of the rect that this tile covers
+            glm::ivec2 tile_origin = glm::ivec2(tx, ty) * TILE_SIZE;
+            glm::ivec2 copy_origin = glm::max(origin, tile_origin);
+            glm::ivec2 copy_extent = glm::min(origin + size, tile_origin + tile->size);
+
+            // Copy it a row at a time
+            for (int y = copy_origin.y; y < copy_extent.y; y++) {
+
+                const float* src = &tile->pixels[(y - tile_origin.y) * tile->size.x + (copy_origin.x - tile_origin.x)];
+                float* dst = out + (size_t)(y - origin.y) * size.x + (copy_origin.x - origin.x);
+
+                memcpy(dst, src, (copy_extent.x - copy_origin.x) * sizeof(float));
+
+            }
+
+        }
+
+    }
+
+}
+
+size_t TileCache::getMemoryUsed() {
+
+    std::lock_guard<std::mutex> lock(_lock);
+
+    return _memory_used;
+
+}
+
+std::shared_ptr<const TileCache::_Tile> TileCache::getTile(const glm::ivec2& index) {
+
+    uint64_t key = ((uint64_t)(uint32_t)index.y << 32) | (uint32_t)index.x;
+
+    std::unique_lock<std::mutex> lock(_lock);
+
+    auto it = _tiles.find(key);
+
+    if (it != _tiles.end()) {
+
+        // Move it to the front so that it is dropped last
+        _recent.splice(_recent.begin(), _recent, it->second.position);
+
+        std::shared_future<std::shared_ptr<const _Tile>> tile = it->second.tile;
+        lock.unlock();
+
+        // This waits if another thread is still loading the tile
+        return tile.get();
+
+    }
+
+    glm::ivec2 tile_origin = index * TILE_SIZE;
+    glm::ivec2 tile_size = glm::min(glm::ivec2(TILE_SIZE), _raster_size - tile_origin);
+
+    // Put the tile in the cache before loading it so that other threads wait for this one instead of loading it too
+    std::promise<std::shared_ptr<const _Tile>> promise;
+
+    _Entry& entry = _tiles[key];
+    entry.tile = promise.get_future().share();
+    entry.bytes = (size_t)tile_size.x * tile_size.y * sizeof(float);
+
+    _recent.push_front(key);
+    entry.position = _recent.begin();
+
+    _memory_used += entry.bytes;
+    evict();
+
+    lock.unlock();
+
+    std::shared_ptr<_Tile> tile = std::make_shared<_Tile>();
+
+    try {
+
+        tile->size = tile_size;
+        tile->pixels.resize((size_t)tile_size.x * tile_size.y);
+
+        _loader(tile_origin, tile_size, &tile->pixels[0]);
+
+    } catch (...) {
+
+        // Let the next read try again
+        lock.lock();
+
+        auto failed = _tiles.find(key);
+
+        if (failed != _tiles.end()) {
+            _memory_used -= failed->second.bytes;
+            _recent.erase(failed->second.position);
+            _tiles.erase(failed);
+        }
+
+        lock.unlock();
+
+        promise.set_exception(std::current_exception());
+        throw;
+
+    }
+
+    promise.set_value(tile);
+
+    return tile;
+
+}
+
+void TileCache::evict() {
+
+    // The tile that was just added is at the front and is always kept
+    while (_memory_used > _memory_budget && _recent.size() > 1) {
+
+        auto it = _tiles.find(_recent.back());
+
+        _memory_used -= it->second.bytes;
+        _tiles.erase(it);
+        _recent.pop_back();
+
+    }
+
+}
@@ -0,0 +1,148 @@
+//
+//  tile_cache.h
+//  Routes
+//
+
+#ifndef ROUTES_TILE_CACHE_H
+#define ROUTES_TILE_CACHE_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+/** The width and height of every tile in pixels */
+#define TILE_SIZE 256
+
+/** The default amount of memory in megabytes that the tiles of the elevation data may use */
+#define TILE_CACHE_MEMORY_MB 512
+
+/**
+ * Reads a rect of pixels from the source of the tiles.
+ *
+ * The first argument is the origin of the rect in pixels, the second is its size and the third is where the pixels go,
+ * in rows of size.x pixels.
+ */
+typedef std::function<void(const glm::ivec2&, const glm::ivec2&, float*)> TileLoader;
+
+/**
+ * Keeps square tiles of a raster in memory so that overlapping reads only go to the source once.
+ *
+ * Reads are assembled from whole tiles, which are loaded the first time they are needed and kept until the memory
+ * budget is used up, at which point the least recently used tiles are dropped. The cache can be read from several
+ * threads at once. When two threads need the same tile at the same time it is only loaded once and the second thread
+ * waits for it.
+ */
+class TileCache {
+
+    public:
+
+        /**
+         * Creates an empty cache.
+         *
+         * @param raster_size
+         * The width and height of the raster in pixels. The tiles on the right and bottom edges are cut to fit.
+         *
+         * @param memory_budget
+         * The number of bytes that the tiles may use. At least one tile is always kept.
+         *
+         * @param loader
+         * Reads pixels from the raster. It is only called for rects that are inside the raster.
+         */
+        TileCache(const glm::ivec2& raster_size, size_t memory_budget, TileLoader loader);
+
+        /**
+         * Reads a rect of pixels, loading any tiles that aren't in the cache.
+         *
+         * @param origin
+         * The upper left pixel of the rect.
+         *
+         * @param size
+         * The width and height of the rect in pixels.
+         *
+         * @param out
+         * Where the pixels are written, in rows of size.x pixels.
+         */
+        void read(const glm::ivec2& origin, const glm::ivec2& size, float* out);
+
+        /**
+         * Gets the number of bytes that the tiles in the cache use.
+         *
+         * @return
+         * The number of bytes
+         */
+        size_t getMemoryUsed();
+
+    private:
+
+        /** A square of pixels from the raster */
+        struct _Tile {
+
+            /** The width and height of the tile. This is only less than TILE_SIZE at the edges of the raster */
+            glm::ivec2 size;
+
+            /** The pixels in rows of size.x */
+            std::vector<float> pixels;
+
+        };
+
+        /** A tile in the cache, which may still be loading */
+        struct _Entry {
+
+            /** The tile, once it is loaded */
+            std::shared_future<std::shared_ptr<const _Tile>> tile;
+
+            /** The place of the tile in _recent */
+            std::list<uint64_t>::iterator position;
+
+            /** The number of bytes the tile uses */
+            size_t bytes;
+
+        };
+
+        /**
+         * Gets a tile from the cache, loading it if it isn't there.
+         *
+         * @param index
+         * The column and row of the tile.
+         *
+         * @return
+         * The tile. This stays valid even if the cache drops it.
+         */
+        std::shared_ptr<const _Tile> getTile(const glm::ivec2& index);
+
+        /** Drops the least recently used tiles until the tiles fit in the budget. _lock must be held. */
+        void evict();
+
+        /** The width and height of the raster in pixels */
+        const glm::ivec2 _raster_size;
+
+        /** The number of bytes that the tiles may use */
+        const size_t _memory_budget;
+
+        /** Reads pixels from the raster */
+        const TileLoader _loader;
+
+        /** The tiles in the cache keyed by their column and row */
+        std::unordered_map<uint64_t, _Entry> _tiles;
+
+        /** The keys of the tiles from the most to the least recently used */
+        std::list<uint64_t> _recent;
+
+        /** The number of bytes used by the tiles in _tiles */
+        size_t _memory_used;
+
+        /** Guards everything above */
+        std::mutex _lock;
+
+};
+
+#endif //ROUTES_TILE_CACHE_H
@@ -0,0 +1,138 @@
+//
+//  tile_store.cpp
+//  Routes
+//
+
+#include "tile_store.h"
+
+TileStore::TileStore(const std::string& path) : _file(path.c_str(), boost::interprocess::read_only),
+    _region(_file, boost::interprocess::read_only) {
+
+    const char* data = (const char*)_region.get_address();
+
+    if (_region.get_size() < TILE_STORE_DATA_OFFSET)
+        throw std::runtime_error("The tile store is too small, rebuild the database");
+
+    memcpy(&_header, data, sizeof(_header));
+
+    if (_header.magic != TILE_STORE_MAGIC || _header.version != TILE_STORE_VERSION || _header.tile_size != TILE_SIZE)
+        throw std::runtime_error("The tile store was written by a different version, rebuild the database");
+
+    size_t tile_bytes = (size_t)TILE_SIZE * TILE_SIZE * sizeof(float);
+
+    if (_region.get_size() < TILE_STORE_DATA_OFFSET + (size_t)_header.tiles_x * _header.tiles_y * tile_bytes)
+        throw std::runtime_error("The tile store is missing tiles, rebuild the database");
+
+    _tiles = (const float*)(data + TILE_STORE_DATA_OFFSET);
+
+}
+
+void TileStore::read(const glm::ivec2& origin, const glm::ivec2& size, float* out) const {
+
+    if (origin.x < 0 || origin.y < 0 || size.x <= 0 || size.y <= 0 ||
+            origin.x + size.x > _header.width || origin.y + size.y > _header.height)
+        throw std::runtime_error("Attempted to read outside of the dataset");
+
+    glm::ivec2 first = origin / TILE_SIZE;
+    glm::ivec2 last  = (origin + size - 1) / TILE_SIZE;
+
+    for (int ty = first.y; ty <= last.y; ty++) {
+
+        for (int tx = first.x; tx <= last.x; tx++) {
+
+            const float* tile = _tiles + ((size_t)ty * _header.tiles_x + tx) * TILE_SIZE * TILE_SIZE;
+
+            // Find the part of the rect that this tile covers
+            glm::ivec2 tile_origin = glm::ivec2(tx, ty) * TILE_SIZE;
+            glm::ivec2 copy_origin = glm::max(origin, tile_origin);
+            glm::ivec2 copy_extent = glm::min(origin + size, tile_origin + TILE_SIZE);
+
+            // Copy it a row at a time
+            for (int y = copy_origin.y; y < copy_extent.y; y++) {
+
+                const float* src = tile + (y - tile_origin.y) * TILE_SIZE + (copy_origin.x - tile_origin.x);
+                float* dst = out + (size_t)(y - origin.y) * size.x + (copy_origin.x - origin.x);
+
+                memcpy(dst, src, (copy_extent.x - copy_origin.x) * sizeof(float));
+
+            }
+
+        }
+
+    }
+
+}
+
+glm::ivec2 TileStore::getSize() const { return glm::ivec2(_header.width, _header.height); }
+
+const double* TileStore::getTransform() const { return _header.transform; }
+
+void TileStore::build(const std::string& source_path, const std::string& store_path) {
+
+    GDALAllRegister();
+
+    GDALDataset* dataset = (GDALDataset*)GDALOpen(source_path.c_str(), GA_ReadOnly);
+
+    if (!dataset)
+        throw std::runtime_error("Could not open " + source_path + " to build the tile store");
+
+    GDALRasterBand* band = dataset->GetRasterBand(1);
+
+    TileStoreHeader header;
+    memset(&header, 0, sizeof(header));
+
+    header.magic = TILE_STORE_MAGIC;
+    header.version = TILE_STORE_VERSION;
+    header.width = dataset->GetRasterXSize();
+    header.height = dataset->GetRasterYSize();
+    header.tile_size = TILE_SIZE;
+    header.tiles_x = (header.width + TILE_SIZE - 1) / TILE_SIZE;
+    header.tiles_y = (header.height + TILE_SIZE - 1) / TILE_SIZE;
+
+    dataset->GetGeoTransform(header.transform);
+
+    std::string temp_path = store_path + ".tmp";
+    std::ofstream out = std::ofstream(temp_path, std::ios::binary | std::ios::trunc);
+
+    // The index is padded out to a full page
+    std::vector<char> index = std::vector<char>(TILE_STORE_DATA_OFFSET, 0);
+    memcpy(&index[0], &header, sizeof(header));
+    out.write(&index[0], index.size());
+
+    std::vector<float> tile = std::vector<float>(TILE_SIZE * TILE_SIZE);
+
+    for (int ty = 0; ty < header.tiles_y; ty++) {
+
+        std::cout << "Writing tile row " << ty + 1 << " of " << header.tiles_y << std::endl;
+
+        for (int tx = 0; tx < header.tiles_x; tx++) {
+
+            glm::ivec2 origin = glm::ivec2(tx, ty) * TILE_SIZE;
+            glm::ivec2 size = glm::min(glm::ivec2(TILE_SIZE), glm::ivec2(header.width, header.height) - origin);
+
+            // Edge tiles are padded with zeros, nothing ever reads them
+            std::fill(tile.begin(), tile.end(), 0.0f);
+
+            CPLErr err = band->RasterIO(GF_Read, origin.x, origin.y, size.x, size.y, &tile[0], size.x, size.y,
+                                        GDT_Float32, sizeof(float), TILE_SIZE * sizeof(float));
+
+            if (err) {
+                GDALClose(dataset);
+                throw std::runtime_error("There was an error reading from the dataset");
+            }
+
+            out.write((const char*)&tile[0], tile.size() * sizeof(float));
+
+        }
+
+    }
+
+    GDALClose(dataset);
+    out.close();
+
+    if (!out)
+        throw std::runtime_error("Could not write the tile store to " + temp_path);
+
+    boost::filesystem::rename(temp_path, store_path);
+
+}
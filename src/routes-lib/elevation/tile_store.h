@@ -0,0 +1,140 @@
+//
+//  tile_store.h
+//  Routes
+//
+
+#ifndef ROUTES_TILE_STORE_H
+#define ROUTES_TILE_STORE_H
+
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <gdal_priv.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "tile_cache.h"
+
+/** The location of the preprocessed tiles that are built from the virtual dataset */
+#define TILE_STORE_PATH "../data/db.tiles"
+
+/** The first four bytes of every tile store, "RTLS" */
+#define TILE_STORE_MAGIC 0x534C5452
+
+/** Changes whenever the layout of the tile store changes so that old stores are rebuilt instead of misread */
+#define TILE_STORE_VERSION 1
+
+/** Where the tiles start in the file. This is a page so that every tile is page aligned in the mapping */
+#define TILE_STORE_DATA_OFFSET 4096
+
+/** The index at the start of a tile store */
+struct TileStoreHeader {
+
+    /** Always TILE_STORE_MAGIC */
+    uint32_t magic;
+
+    /** The TILE_STORE_VERSION that wrote the store */
+    uint32_t version;
+
+    /** The width of the raster in pixels */
+    int32_t width;
+
+    /** The height of the raster in pixels */
+    int32_t height;
+
+    /** The TILE_SIZE that the store was written with */
+    int32_t tile_size;
+
+    /** The number of columns of tiles */
+    int32_t tiles_x;
+
+    /** The number of rows of tiles */
+    int32_t tiles_y;
+
+    /** Unused, keeps the transform aligned */
+    int32_t reserved;
+
+    /** The GDAL geo transform of the raster */
+    double transform[6];
+
+};
+
+/**
+ * A preprocessed copy of the elevation data that is read straight from a memory mapped file.
+ *
+ * The raster is split into TILE_SIZE x TILE_SIZE tiles of float32 pixels in rows, and the tiles are stored one after
+ * another in rows too. The tiles on the right and bottom edges are padded to the full size so that every tile can be
+ * found with a multiplication. Reading from the store is just copying from memory, so after the first read the data
+ * comes out of the page cache rather than being decoded by GDAL again. The store is written in the byte order of the
+ * machine that builds it.
+ */
+class TileStore {
+
+    public:
+
+        /**
+         * Opens a tile store. Throws a std::runtime_error if the file is not a tile store of this version.
+         *
+         * @param path
+         * The location of the store.
+         */
+        explicit TileStore(const std::string& path);
+
+        /**
+         * Reads a rect of pixels from the store.
+         *
+         * @param origin
+         * The upper left pixel of the rect.
+         *
+         * @param size
+         * The width and height of the rect in pixels.
+         *
+         * @param out
+         * Where the pixels are written, in rows of size.x pixels.
+         */
+        void read(const glm::ivec2& origin, const glm::ivec2& size, float* out) const;
+
+        /** Gets the width and height of the raster in pixels */
+        glm::ivec2 getSize() const;
+
+        /** Gets the GDAL geo transform of the raster, 6 doubles */
+        const double* getTransform() const;
+
+        /**
+         * Converts a GDAL dataset into a tile store. The store is written next to the path first and then moved into
+         * place, so a store that was only partly written is never opened.
+         *
+         * @param source_path
+         * The location of the dataset, usually the virtual dataset.
+         *
+         * @param store_path
+         * Where to write the store.
+         */
+        static void build(const std::string& source_path, const std::string& store_path);
+
+    private:
+
+        /** The file that is mapped */
+        boost::interprocess::file_mapping _file;
+
+        /** The mapping of the whole file */
+        boost::interprocess::mapped_region _region;
+
+        /** A copy of the index at the start of the file */
+        TileStoreHeader _header;
+
+        /** The first pixel of the first tile in the mapping */
+        const float* _tiles;
+
+};
+
+#endif //ROUTES_TILE_STORE_H
@@ -7,8 +7,44 @@
 
 #include "population.h"
 
+#include <functional>
 #include <pqxx/pqxx>
 #include "../database/database.h"
+#include "../database/logger.h"
+
+/** The outcome of running the genetic algorithm for a single route */
+struct GeneticsResult {
+
+    /** The control points of the best solution in meters */
+    std::vector<glm::vec3> controls;
+
+    /** The primary key of the route in the route table, 0 if the database was not used */
+    int route_id;
+
+};
+
+/** How far the genetic algorithm has gotten and how good its best solution is, this is reported after every generation */
+struct GenerationProgress {
+
+    /** The number of generations that have been completed */
+    int generation;
+
+    /** The total number of generations that will be run */
+    int num_generations;
+
+    /** The track, curve, grade and length fitness of the best solution */
+    glm::vec4 fitness;
+
+    /** The weighted total of the fitness of the best solution */
+    double total_fitness;
+
+    /** The control points of the best solution. X and Y are longitude and latitude and Z is the elevation */
+    std::vector<glm::vec3> controls;
+
+};
+
+/** Called by the genetic algorithm after every generation */
+typedef std::function<void(const GenerationProgress&)> ProgressCallback;
 
 /** A simple class to manage the genetic cycle of a population */
 class Genetics {
@@ -25,62 +61,46 @@ class Genetics {
          * @param pod
          * The information about the hyperloop pod. Determines how curved the track can be.
          *
+         * @param data
+         * The elevation data of the route, the same data the population was made with.
+         *
          * @param useDb
          * true if the database is being used
          *
-         * @return
-         * The points of the calculated path in meters. This will need to be converted to latitude and longitude
-         * to be properly displayed.
-         */
-        static std::vector<glm::vec3> solve(Population& pop, Pod& pod, int generations, const glm::dvec2& start, const glm::dvec2& dest, bool useDb);
-
-        /**
-         * This function returns the route id of this route for querying the database
+         * @param coarse_fraction
+         * The fraction of the generations that are run on the coarse levels of the elevation pyramid, split evenly
+         * between them from the coarsest to the finest. The rest are run on the full resolution.
+         *
+         * @param progress
+         * Called after every generation with how far the algorithm has gotten. This may be empty.
          *
          * @return
-         * The primary key of the route table
+         * The points of the calculated path in meters along with the id of the route in the database. The points
+         * will need to be converted to latitude and longitude to be properly displayed.
          */
-        static int getRouteId();
+        static GeneticsResult solve(Population& pop, Pod& pod, int generations, const ElevationData& data,
+                                    const glm::dvec2& start, const glm::dvec2& dest, bool useDb,
+                                    float coarse_fraction = 0.0f, const ProgressCallback& progress = ProgressCallback());
 
         /**
-         * Gets the evaluated points
+         * Figures out which level of the elevation pyramid a generation should be evaluated on.
+         *
+         * @param generation
+         * The index of the generation
+         *
+         * @param generations
+         * The total number of generations
+         *
+         * @param levels
+         * The number of levels of the pyramid
+         *
+         * @param coarse_fraction
+         * The fraction of the generations that are run on the coarse levels
          *
          * @return
-         * returns the evaluated points
-         */
-        static std::string getEval();
-
-    private:
-
-        /**
-         * The control points of the optimal solution at the current generation
-         */
-        static int _id;
-
-        /**
-         * The starting latitude
-         */
-        static double _lat_start;
-
-        /**
-         * The ending latitude
-         */
-        static double _lat_end;
-
-        /**
-         * The starting longitude
-         */
-        static double _long_start;
-
-        /**
-         * The ending longitude
-         */
-        static double _long_end;
-
-        /**
-         * The evaluated points
+         * The level, 0 is the full resolution
          */
-        static std::string _eval;
+        static int levelForGeneration(int generation, int generations, int levels, float coarse_fraction);
 
 };
 
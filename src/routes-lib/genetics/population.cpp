@@ -8,7 +8,9 @@ Population::Population(int pop_size, glm::vec4 start, glm::vec4 dest, const Elev
     _dest(dest), _direction(_dest - _start), _data(data), _reload(conf.getReload()), _initial_sigma_divisor(conf.getInitialSigmaDivisor()),
     _initial_sigma_xy(conf.getInitialSigmaXY()), _step_dampening(conf.getStepDampening()), _alpha(conf.getAlpha()), _num_sample_threads(conf.getNumSampleThreads()),
     _num_route_workers(conf.getNumRouteWorkers()), _track_weight(conf.getTrackWeight()), _curve_weight(conf.getCurveWeight()), _grade_weight(conf.getGradeWeight()),
-    _length_weight(conf.getLengthWeight()) {
+    _length_weight(conf.getLengthWeight()), _pipeline_chunks(glm::clamp(conf.getPipelineChunks(), 1, pop_size)),
+    _decomposition_setting(conf.getDecompositionInterval()), _curve_type(Spline::parseCurveType(conf.getCurveType())),
+    _terrain_filter(ElevationData::parseTerrainFilter(conf.getTerrainFilter())) {
 
 
     // Figure out how many points we need for this route
@@ -18,9 +20,6 @@ Population::Population(int pop_size, glm::vec4 start, glm::vec4 dest, const Elev
     // and the destination
     _individual_size = _genome_size + 2 + 1;
 
-    // Calculate the binomial coefficients for evaluating the bezier paths
-    calcBinomialCoefficients();
-        
     // Get the data to allow for proper texture sampling
     _data_size   = _data.getCroppedSizeMeters();
     _data_origin = _data.getCroppedOriginMeters();
@@ -33,6 +32,17 @@ Population::Population(int pop_size, glm::vec4 start, glm::vec4 dest, const Elev
 
     std::cout << "Using " << _num_evaluation_points << " points of evaluation" << std::endl;
     _num_evaluation_points_1 = (float)_num_evaluation_points - 1.0f;
+
+    // Start on the full resolution
+    _max_evaluation_points = _num_evaluation_points;
+    _level = 0;
+
+    // Pick where the cost is evaluated before anything is given to it
+    _cost_backend = CostEvaluator::parseBackend(conf.getCostBackend());
+    _evaluator = CostEvaluator::create(_cost_backend);
+
+    // Calculate the basis for evaluating the paths at every point
+    calcBasis();
         
     // Get the data to allow for proper texture sampling
     _data_size   = _data.getCroppedSizeMeters();
@@ -45,16 +55,16 @@ Population::Population(int pop_size, glm::vec4 start, glm::vec4 dest, const Elev
     samplePopulation();
         
     // Create the best sample vector
-    _best_samples = std::vector<Eigen::VectorXf>((size_t)_mu);
+    _best_samples = Eigen::MatrixXf(_genome_size * 3, _mu);
 
 
 }
 
 Population::~Population() {
 
-    // Delete the sample generators
-    for (int i = 0; i < _num_sample_threads; i++)
-        delete _sample_gens[i];
+    // Give the pinned memory back to the driver
+    if (_cost_backend == CostBackend::OpenCL)
+        Kernel::getQueue().enqueue_unmap_buffer(_pinned_individuals, _individuals).wait();
 
 }
 
@@ -64,7 +74,7 @@ Individual Population::getIndividual(int index) {
     ind.num_genes = (size_t)_genome_size;
 
     // Calculate the location of the parts of the individual
-    glm::vec4* header_loc = _individuals.data() + index * _individual_size;
+    glm::vec4* header_loc = _individuals + index * _individual_size;
     ind.header = header_loc;
     ind.moHeader = header_loc + 1;
 
@@ -147,7 +157,7 @@ void Population::sortIndividuals() {
     
     // Copy the best samples into a sorted array
     for (int i = 0; i < _mu; i++)
-        _best_samples[i] = _samples[_sorted_individuals[i].index];
+        _best_samples.col(i) = _samples.col(_sorted_individuals[i].index);
 
 }
 
@@ -191,36 +201,46 @@ void Population::sortIndividuals() {
 
 void Population::evaluateCost(const Pod& pod) {
 
-    // Get stuff we need to execute a kernel on
-    boost::compute::command_queue& queue = Kernel::getQueue();
+    CostParams params;
+    params.path_length = _genome_size + 2;
+    params.num_points = _num_evaluation_points;
+    params.num_workers = _num_route_workers;
+    params.max_grade = MAX_SLOPE_GRADE;
+    params.min_curve = pod.minCurveRadius();
+    params.excavation_depth = EXCAVATION_DEPTH;
+    params.data_size = _data_size;
+    params.data_origin = _data_origin;
+    params.straight_distance = glm::length(_direction);
+    params.filter = _terrain_filter;
+    params.image = _cost_backend == CostBackend::OpenCL ? &_data.getOpenCLImage(_level) : nullptr;
+    params.pixels = _data.getPixels(_level).data();
+    params.pixels_size = _data.getPixelSize(_level);
 
-//    std::string kernelFunction;
-//
-//    if (objectiveType == "single") {
-//        kernelFunction = "cost";
-//    } else if (objectiveType == "multi") {
-//        kernelFunction = "mo";
-//    }
+    _evaluator->setParams(params);
+
+    int chunk_size = (_pop_size + _pipeline_chunks - 1) / _pipeline_chunks;
 
-    // Create a temporary kernel and execute it
-    static Kernel kernel = Kernel(std::ifstream("../opencl/kernel_cost.opencl"), "cost");
+    for (int start = 0; start < _pop_size; start += chunk_size) {
 
-    kernel.setArgs(_data.getOpenCLImage(), _opencl_individuals.get_buffer(), _genome_size + 2,
-                   MAX_SLOPE_GRADE, pod.minCurveRadius(), EXCAVATION_DEPTH, _data_size.x,
-                   _data_size.y, _opencl_binomials.get_buffer(),
-                   _num_evaluation_points_1, _num_evaluation_points / _num_route_workers, _data_origin.x, _data_origin.y, glm::length(_direction));
+        int end = glm::min(start + chunk_size, _pop_size);
 
-    // Upload the data
-    boost::compute::copy(_individuals.begin(),_individuals.end(), _opencl_individuals.begin(), queue);
+        // Fill in this chunk while the one before it is evaluated. With one chunk samplePopulation already did
+        if (_pipeline_chunks > 1)
+            packSamples(start, end);
 
-    // Execute the 2D kernel with a work size of NUM_ROUTE_WORKERS. NUM_ROUTE_WORKERS threads  will work on a single individual
-    kernel.execute2D(glm::vec<2, size_t>(0, 0),
-                     glm::vec<2, size_t>(_pop_size, _num_route_workers),
-                     glm::vec<2, size_t>(1, _num_route_workers));
+        _evaluator->enqueue(_individuals, start, end);
+
+    }
 
-    // Download the data
-    boost::compute::copy(_opencl_individuals.begin(), _opencl_individuals.end(), _individuals.begin(), queue);
+    // Use the time the last chunks are evaluated to draw the samples of the next generation
+    if (_pipeline_chunks > 1) {
+
+        drawStandardNormals(_next_samples);
+        _next_samples_drawn = true;
+
+    }
 
+    _evaluator->finish();
 
 }
 
@@ -254,11 +274,52 @@ double Population::totalFitness(glm::vec4 costs) {
 }
 
 
+CurveType Population::getCurveType() const {
+
+    return _curve_type;
+
+}
+
+void Population::setLevel(int level) {
+
+    level = glm::clamp(level, 0, _data.getNumLevels() - 1);
+
+    if (level == _level)
+        return;
+
+    _level = level;
+
+    // Every level has half the pixels on each side, so half as many points still land on about every pixel.
+    // The kernel needs at least two points per worker and a multiple of the workers
+    int points = (_max_evaluation_points >> level) / _num_route_workers * _num_route_workers;
+    _num_evaluation_points = glm::max(points, 2 * _num_route_workers);
+    _num_evaluation_points_1 = (float)_num_evaluation_points - 1.0f;
+
+    // The basis has a row for every point
+    calcBasis();
+
+}
+
+int Population::getNumLevels() const {
+
+    return _data.getNumLevels();
+
+}
+
 void Population::calcGenomeSize() {
 
-    // The genome size has a square root relationship with the length of the route
-    float sqrt_length = sqrtf(glm::length(_direction));
-    _genome_size = (int)std::round(sqrt_length * LENGTH_TO_GENOME);
+    if (_curve_type == CurveType::BSpline) {
+
+        // Each control point of a B-spline only covers a short piece of the route, so the genome grows with the length
+        _genome_size = glm::max((int)std::round(glm::length(_direction) / SPLINE_METERS_PER_GENE), 2);
+
+    } else {
+
+        // The genome size has a square root relationship with the length of the route
+        float sqrt_length = sqrtf(glm::length(_direction));
+        _genome_size = (int)std::round(sqrt_length * LENGTH_TO_GENOME);
+
+    }
 
     std::cout << "Genome: " << _genome_size << std::endl;
 
@@ -291,6 +352,7 @@ void Population::initParams() {
     // Covariance matrix starts as the identity matrix
     // Multiply by three to make sure that we have room for X, Y and Z
     _covar_matrix = Eigen::MatrixXf::Identity(_genome_size * 3, _genome_size * 3);
+    _weighted_steps = Eigen::MatrixXf(_genome_size * 3, _mu);
 
     // Calculate the initial step size
     calcInitialSigma();
@@ -298,6 +360,9 @@ void Population::initParams() {
     // Calculate strat params
     calculateStratParameters();
 
+    // Decompose the starting covariance matrix so the first generation can be sampled
+    decomposeCovar();
+
     // Set the two evolution paths to the zero vector
     _p_covar = Eigen::VectorXf::Zero(_genome_size * 3);
     _p_sigma = Eigen::VectorXf::Zero(_genome_size * 3);
@@ -311,30 +376,61 @@ void Population::initParams() {
 
 void Population::initSamplers() {
 
-    // Create the standard normal samplers
-    _sample_gens = std::vector<SampleGenerator*>(_num_sample_threads);
-    
-    for (int i = 0; i < _num_sample_threads; i++)
-        _sample_gens[i] = new SampleGenerator(_genome_size * 3, _pop_size / _num_sample_threads);
+    // Seed with the start and destination so that the same route always draws the same samples
+    uint64_t seed = 0xCBF29CE484222325ull;
+    const glm::vec4* ends[2] = {&_start, &_dest};
+
+    for (const glm::vec4* end : ends) {
+
+        for (int c = 0; c < 3; c++) {
+
+            uint32_t bits;
+            memcpy(&bits, &(*end)[c], sizeof(bits));
+
+            seed = (seed ^ bits) * 0x100000001B3ull;
+
+        }
+
+    }
+
+    // Create the standard normal sampler
+    _sample_gen = std::make_unique<SampleGenerator>(_genome_size * 3, seed);
+    _sample_stream = 0;
 
 }
 
 void Population::initSamples() {
 
     // Create the appropriate vectors
-    _individuals = std::vector<glm::vec4>((size_t)_pop_size * _individual_size);
+    size_t num_vectors = (size_t)_pop_size * _individual_size;
+    size_t num_bytes = num_vectors * sizeof(glm::vec4);
+
+    // Let the driver allocate the CPU storage so that it is pinned, then keep it mapped. Nothing needs pinned
+    // memory when OpenCL isn't used
+    if (_cost_backend == CostBackend::OpenCL) {
+
+        _pinned_individuals = boost::compute::buffer(Kernel::getContext(), num_bytes,
+                                                     CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR);
+        _individuals = (glm::vec4*)Kernel::getQueue().enqueue_map_buffer(_pinned_individuals,
+                                                                         CL_MAP_READ | CL_MAP_WRITE, 0, num_bytes);
+
+    } else {
+
+        _host_individuals.resize(num_vectors);
+        _individuals = _host_individuals.data();
+
+    }
+
     _sorted_individuals = std::vector<Individual>((size_t)_pop_size);
 
-    for (int i = 0; i < _individuals.size(); i++)
+    for (size_t i = 0; i < num_vectors; i++)
         _individuals[i] = glm::vec4(0.0);
 
-    _opencl_individuals =  boost::compute::vector<glm::vec4>(_individuals.size(), Kernel::getContext());
-
     // Samples should be the same size as the population
-    _samples = std::vector<Eigen::VectorXf>((size_t)_pop_size);
+    _samples = Eigen::MatrixXf::Zero(_genome_size * 3, _pop_size);
 
-    for (int i = 0; i < _pop_size; i++)
-        _samples[i] = Eigen::VectorXf::Zero(_genome_size * 3);
+    if (_pipeline_chunks > 1)
+        _next_samples = _samples;
 
     // Make sure that individuals have the start and destination all set up. This will never change so we can do it
     // once.
@@ -345,6 +441,9 @@ void Population::initSamples() {
 
     }
 
+    // Give the evaluator everything once so that it has the start and destination
+    _evaluator->setIndividuals(_individuals, _pop_size, _individual_size);
+
 }
 
 void Population::bestGuess() {
@@ -433,14 +532,62 @@ void Population::calculateStratParameters() {
     _c1 = 2.0f / (N * N);
     _c_mu = _mu_weight / (N * N);
 
+    _decomposition_interval = decompositionInterval(_decomposition_setting, (int)N, _c1, _c_mu);
+
+}
+
+int Population::decompositionInterval(int setting, int N, float c1, float c_mu) {
+
+    if (setting > 0)
+        return setting;
+
+    // The covariance matrix moves slowly enough that it only needs to be decomposed every 1 / (10 N (c1 + c_mu))
+    // generations. With c1 = 2 / N^2 and c_mu = mu_eff / N^2 that is N / (10 (2 + mu_eff)), which stays at 1 until N
+    // is many times mu_eff, so routes only get a real interval from the configuration
+    return glm::max((int)(1.0f / (10.0f * N * (c1 + c_mu))), 1);
+
+}
+
+void Population::decomposeCovar() {
+
+    // Only the lower triangle is read, so the covariance matrix doesn't need to be exactly symmetric
+    Eigen::SelfAdjointEigenSolver<Eigen::MatrixXf> solver(_covar_matrix);
+
+    // Rounding can push the smallest eigenvalues just below zero
+    Eigen::VectorXf scales = solver.eigenvalues().cwiseMax(1e-20f).cwiseSqrt();
+    const Eigen::MatrixXf& basis = solver.eigenvectors();
+
+    _sqrt_covar = basis * scales.asDiagonal();
+    _inv_sqrt_covar = basis * scales.cwiseInverse().asDiagonal() * basis.transpose();
+
+    _generations_since_decomposition = 0;
+
 }
 
 void Population::samplePopulation() {
 
-    // Create a MND
-    MultiNormal dist = MultiNormal(_covar_matrix, _sigma);
-    dist.generateRandomSamples(_samples, _sample_gens);
-    
+    // Create a MND from the decomposition that updatePSigma also uses
+    MultiNormal dist = MultiNormal::fromFactor(_sqrt_covar, _sigma);
+
+    if (_pipeline_chunks > 1) {
+
+        // The standard normal samples were drawn while the last generation was evaluated, so only the
+        // transform is left. The samples are put into _individuals chunk by chunk when they are evaluated.
+        if (!_next_samples_drawn)
+            drawStandardNormals(_next_samples);
+
+        std::swap(_samples, _next_samples);
+        _next_samples_drawn = false;
+
+        dist.transformSamples(_samples, _num_sample_threads);
+
+        return;
+
+    }
+
+    drawStandardNormals(_samples);
+    dist.transformSamples(_samples, _num_sample_threads);
+
     // Convert the _samples over to a set of glm vectors and update the population
     // Do so with multiple threads
     std::vector<std::thread> threads = std::vector<std::thread>(_num_sample_threads);
@@ -450,21 +597,11 @@ void Population::samplePopulation() {
         
         threads[thread] = std::thread([this, thread, worker_size] {
 
+            // The last thread picks up whatever doesn't divide evenly
             int start = worker_size * thread;
-            int end = glm::min(start + worker_size, _pop_size);
-
-            for (int individual = start; individual < end; individual++) {
+            int end = thread == _num_sample_threads - 1 ? _pop_size : start + worker_size;
 
-                // Add the mean because the samples don't have it
-                Eigen::VectorXf actual = _samples[individual] + _mean;
-
-                // Use memory copies to put the right data in the the _individuals vector because its slightly faster
-                // We need to do it in a for loop because the _individuals is vec4 and there are only 3 components for each control point
-                // In the Eigen vectors that we build
-                for (int point = 0; point < _genome_size; point++)
-                    memcpy(&_individuals[individual * _individual_size + 2 + point][0], actual.data() + point * 3, sizeof(float) * 3);
-
-            }
+            packSamples(start, end);
 
         });
         
@@ -476,6 +613,33 @@ void Population::samplePopulation() {
 
 }
 
+void Population::packSamples(int start, int end) {
+
+    const float* mean = _mean.data();
+
+    for (int individual = start; individual < end; individual++) {
+
+        // The samples are column major so each individual's sample is contiguous
+        const float* sample = _samples.col(individual).data();
+        glm::vec4* genome = &_individuals[individual * _individual_size + 2];
+
+        // Add the mean because the samples don't have it. The _individuals are vec4 and there are only 3 components
+        // for each control point in the samples
+        for (int point = 0; point < _genome_size; point++)
+            for (int c = 0; c < 3; c++)
+                genome[point][c] = sample[point * 3 + c] + mean[point * 3 + c];
+
+    }
+
+}
+
+void Population::drawStandardNormals(Eigen::MatrixXf& out) {
+
+    // Every draw gets its own stream so no two generations share samples
+    _sample_gen->fill(out, _sample_stream++, _num_sample_threads);
+
+}
+
 void Population::updateParams() {
     
     // Update the mean
@@ -489,6 +653,10 @@ void Population::updateParams() {
 
     // Update the covariance matrix
     updateCovar();
+
+    // Decompose it again once it has moved enough
+    if (++_generations_since_decomposition >= _decomposition_interval)
+        decomposeCovar();
     
     // Update the step size
     updateSigma();
@@ -500,12 +668,8 @@ void Population::updateMean() {
     // Save the mean from the last gen so we can use it to update the paths
     Eigen::VectorXf _mean_prime = _mean;
 
-    _mean = Eigen::VectorXf::Zero(_mean.size());
-
-    for (int i = 0; i < _mu; i++)
-        _mean += _best_samples[i] * _weights[i];
-    
-    _mean += _mean_prime;
+    // The weighted sum of the best samples is a single product
+    _mean = _mean_prime + _best_samples * Eigen::Map<const Eigen::VectorXf>(_weights.data(), _mu);
 
     // Calculate mean displacement
     _mean_displacement = (_mean - _mean_prime);
@@ -522,11 +686,8 @@ void Population::updatePSigma() {
     float discount = 1.0f - _c_sigma;
     float discount_comp = sqrtf(1.0f - (discount * discount));
 
-    // Get the inverse square root of the covariance matrix
-    Eigen::SelfAdjointEigenSolver<Eigen::MatrixXf> solver(_covar_matrix);
-    Eigen::MatrixXf inv_sqrt_C(solver.operatorInverseSqrt());
-
-    _p_sigma = discount * _p_sigma + discount_comp * _mu_weight_sqrt * inv_sqrt_C * _mean_displacement;
+    // The inverse square root of the covariance matrix comes from the last decomposition
+    _p_sigma = discount * _p_sigma + discount_comp * _mu_weight_sqrt * _inv_sqrt_covar * _mean_displacement;
 
 }
 
@@ -547,23 +708,10 @@ void Population::updatePCovar() {
 
 void Population::updateCovar() {
 
-    // Calculate the actual new covariance matrix
-    Eigen::MatrixXf covariance_prime = Eigen::MatrixXf::Zero(_mean.size(), _mean.size());
-
-    for (int i = 0; i < _mu; i++) {
-
-        Eigen::VectorXf adjusted = _best_samples[i];
-        
-        // Divide by sigma
-        for (int k = 0; k < adjusted.size(); k++)
-            adjusted(k) = adjusted(k) / _sigma(k);
-        
-        covariance_prime += adjusted * adjusted.transpose() * _weights[i];
-
-    }
-
-    // Calculate the rank one matrix
-    Eigen::MatrixXf rank_one = _c1 * _p_covar * _p_covar.transpose();
+    // Put the weighted steps of the best samples side by side so that the rank mu matrix is Y * Y^T.
+    // The weights are all positive so their square roots can go into the columns
+    for (int i = 0; i < _mu; i++)
+        _weighted_steps.col(i) = _best_samples.col(i).cwiseQuotient(_sigma) * sqrtf(_weights[i]);
 
     // Calculate cs
     float indicator = 0.0f;
@@ -575,8 +723,11 @@ void Population::updateCovar() {
     // Calculate the discount factor
     float discount = 1.0f - _c1 - _c_mu + cs;
 
-    // Update the MatrixXf
-    _covar_matrix = discount * _covar_matrix + rank_one + _c_mu * covariance_prime;
+    // Update the lower triangle in place. The rank one and rank mu matrices are added straight into it
+    // instead of being built as N x N temporaries
+    _covar_matrix.triangularView<Eigen::Lower>() *= discount;
+    _covar_matrix.selfadjointView<Eigen::Lower>().rankUpdate(_p_covar, _c1);
+    _covar_matrix.selfadjointView<Eigen::Lower>().rankUpdate(_weighted_steps, _c_mu);
 
 }
 
@@ -593,13 +744,31 @@ void Population::updateSigma() {
 
 }
 
-void Population::calcBinomialCoefficients() {
+void Population::calcBasis() {
 
-    // For degree we have _genome_size + 2 points, so we use that minus 1 for the degree
-    const std::vector<int>& binomials = Bezier::getBinomialCoefficients(_genome_size + 1);
-    _opencl_binomials = boost::compute::vector<int>((size_t)_genome_size + 2, Kernel::getContext());
+    // The last worker evaluates one point past the end of the curve so there is an extra row for it
+    int num_rows = _num_evaluation_points + 1;
+
+    std::vector<float> basis;
+    std::vector<int> offsets;
+    int basis_width;
+
+    if (_curve_type == CurveType::BSpline) {
+
+        // Only the few control points around each point have a weight
+        Spline::calcSparseBasis(_genome_size + 2, num_rows, _num_evaluation_points_1, basis, offsets);
+        basis_width = Spline::degreeFor(_genome_size + 2) + 1;
+
+    } else {
+
+        // For degree we have _genome_size + 2 points, so we use that minus 1 for the degree.
+        // Every control point has a weight at every point so every row starts at the first one
+        basis = Bezier::calcBernsteinBasis(_genome_size + 1, num_rows, _num_evaluation_points_1);
+        offsets = std::vector<int>((size_t)num_rows, 0);
+        basis_width = _genome_size + 2;
+
+    }
 
-    // Upload to the GPU
-    boost::compute::copy(binomials.begin(), binomials.end(), _opencl_binomials.begin(), Kernel::getQueue());
+    _evaluator->setBasis(basis, offsets, basis_width);
 
 }
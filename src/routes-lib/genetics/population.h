@@ -11,10 +11,12 @@
 #include <time.h>
 
 #include "../bezier/bezier.h"
+#include "../spline/spline.h"
 #include "../elevation/elevation.h"
 #include "../normal/multinormal.h"
 #include "../pod/pod.h"
 #include "../configure/configure.h"
+#include "../cost/cost_evaluator.h"
 
 // Ensure that E is defined on Windows
 #ifndef M_E
@@ -35,6 +37,9 @@
  */
 #define LENGTH_TO_GENOME 0.0274360619f
 
+/** When routes are B-splines, the genome gets one control point for this many meters of route */
+#define SPLINE_METERS_PER_GENE 10000.0f
+
 /**
  * Individual is a convenience so that individuals can be treated as units rather than
  * as a single float vector, which is how they are stored.
@@ -161,7 +166,9 @@ public:
     /**
      * This function is what makes the genetic algorithm work.
      * For every individual a cost is evaluated. This represents how good their genome is as a solution.
-     * This function performs this, using OpenCL.
+     * This function performs this, using the evaluator picked by cost.backend. When the population is evaluated in
+     * chunks, each chunk is packed while the one before it is evaluated and the standard normal samples of the next
+     * generation are drawn while the last ones are.
      *
      * @param pod
      * The pod object containing the specs of the pod. Right now just uses max speed.
@@ -197,6 +204,51 @@ public:
      */
     double totalFitness(glm::vec4 costs);
 
+    /**
+     * Gets the kind of curve that the control points of the solution make.
+     *
+     * @return
+     * The curve type
+     */
+    CurveType getCurveType() const;
+
+    /**
+     * Switches the level of the elevation pyramid that the cost is evaluated on. Coarser levels are evaluated at fewer
+     * points, so a generation on them takes less time. Nothing else about the population changes.
+     *
+     * @param level
+     * The level of the pyramid, 0 is the full resolution. This is clamped to the levels that the data has.
+     */
+    void setLevel(int level);
+
+    /**
+     * Gets the number of levels of the elevation pyramid that the population can be evaluated on.
+     *
+     * @return
+     * The number of levels
+     */
+    int getNumLevels() const;
+
+    /**
+     * Figures out how many generations apart the covariance matrix is decomposed.
+     *
+     * @param setting
+     * The configured interval. If this is 0 the CMA-ES rule of 1 / (10 N (c1 + c_mu)) is used instead.
+     *
+     * @param N
+     * The number of dimensions of the search space
+     *
+     * @param c1
+     * The learning rate of the rank one update
+     *
+     * @param c_mu
+     * The learning rate of the rank mu update
+     *
+     * @return
+     * The number of generations, at least 1
+     */
+    static int decompositionInterval(int setting, int N, float c1, float c_mu);
+
 
 
     /** The starting position of the path that this population is trying to "solve" */
@@ -232,10 +284,9 @@ private:
     void initParams();
 
     /**
-     * Becasue sampling from the multivariate normal distribution is so slow, we use some multithreading tricks to speed it up.
-     * Firstly, since all MVND's require samples from the standard normal distribution we create objects that generate these samples in another thread.
-     * Secondly we split the population up into NUM_SAMPLE_THREADS so that we can sample multiple individuals concurrently.
-     * This function creates the prerequisites for this.
+     * Creates the standard normal sample generator. It is counter based, so _num_sample_threads threads can fill the
+     * samples at once without sharing any state, and it is seeded by the start and destination so that the same route
+     * always draws the same samples.
      */
     void initSamplers();
 
@@ -267,6 +318,32 @@ private:
     /** This function calculates some of the evolutionary parameters that remain constant */
     void calculateStratParameters();
 
+    /**
+     * Eigendecomposes the covariance matrix into _sqrt_covar, which samplePopulation uses, and _inv_sqrt_covar, which
+     * updatePSigma uses. This is O(N^3), so it is only done every _decomposition_interval generations. The matrix only
+     * changes by about c1 + c_mu each generation, so the decomposition that is used is never far behind it.
+     */
+    void decomposeCovar();
+
+    /**
+     * Adds the mean to samples and copies them into the genomes of _individuals.
+     *
+     * @param start
+     * The first individual to copy
+     *
+     * @param end
+     * One past the last individual to copy
+     */
+    void packSamples(int start, int end);
+
+    /**
+     * Fills a matrix with samples from the standard normal distribution on _num_sample_threads threads.
+     *
+     * @param out
+     * The matrix to fill, one sample per column. It should already have the right size.
+     */
+    void drawStandardNormals(Eigen::MatrixXf& out);
+
     /**
      * This samples an entirely new population. We use the calculate / starting covariance matrix, the best solution (m) and the step size.
      * A multivariate normal distribution is temporarily constructed from these parameters and then the population is sampled from it.
@@ -311,11 +388,12 @@ private:
     void updateSigma();
 
     /**
-     * To evaluate the bezier curve, binomial coefficients are required.
-     * These need factorials, so it would be slow to compute them. Instead we do it once, offline because
-     * all paths have the same degree. This computes those coefficients.
+     * Every path has the same degree and is evaluated at the same points, so the weight of each control point at each
+     * point of evaluation is the same for every path. This computes those weights once and hands them to the
+     * evaluator so that the cost only needs a weighted sum. For a bezier curve that is the Bernstein basis, for a B-spline it is
+     * just the few control points around each point.
      */
-    void calcBinomialCoefficients();
+    void calcBasis();
 
     /** The number of individuals that should be in this population */
     int _pop_size;
@@ -351,19 +429,34 @@ private:
     /** _num_evaluation_points - 1. This is a float because it is used for division in the cost function */
     float _num_evaluation_points_1;
 
-    /** The CPU storage of the individuals.*/
-    std::vector<glm::vec4> _individuals;
+    /** The number of points the path is evaluated on at the full resolution */
+    int _max_evaluation_points;
 
-    /** The GPU uploaded version of the individual data */
-    boost::compute::vector<glm::vec4> _opencl_individuals;
+    /** The level of the elevation pyramid that the cost is evaluated on */
+    int _level;
 
     /**
-     * To evaluate the bezier curve, binomial coefficients are required.
-     * These need factorials, so it would be slow to compute them. Instead we do it once, offline because
-     * all paths have the same degree.
-     * This stores the compute coefficients on the GPU.
+     * The CPU storage of the individuals. For the OpenCL backend this points into _pinned_individuals, which stays
+     * mapped for as long as the population exists, otherwise into _host_individuals. There are
+     * _pop_size * _individual_size vectors.
      */
-    boost::compute::vector<int> _opencl_binomials;
+    glm::vec4* _individuals;
+
+    /**
+     * Host memory allocated by the OpenCL driver. The driver can transfer to and from this memory directly, instead of
+     * first copying ordinary memory into a buffer of its own like it does for a std::vector. Only the OpenCL backend
+     * uses this.
+     */
+    boost::compute::buffer _pinned_individuals;
+
+    /** Ordinary memory for the individuals when the cost is not evaluated with OpenCL */
+    std::vector<glm::vec4> _host_individuals;
+
+    /** Where the cost is evaluated, from cost.backend */
+    CostBackend _cost_backend;
+
+    /** Evaluates the cost of the individuals, on the GPU or on the CPU depending on cost.backend */
+    std::unique_ptr<CostEvaluator> _evaluator;
 
     /**
      * The reference to the elevation data that this population operates on.
@@ -397,9 +490,31 @@ private:
     /**
      * The covariance matrix of the population. This contains the information about how the multivariate normal distribution is shaped.
      * This is a _genome_size * 3 X _genome_size * 3 matrix, 3 components for each point in the bezier curve (X, Y, Z).
+     * Only the lower triangle is kept up to date, the upper one is stale after the first update.
      */
     Eigen::MatrixXf _covar_matrix;
 
+    /**
+     * The steps of the _mu best samples divided by the step size, one per column, with each column scaled by the
+     * square root of its weight. This is allocated once so the rank mu update is a single product with its transpose.
+     */
+    Eigen::MatrixXf _weighted_steps;
+
+    /**
+     * The eigenvectors of the covariance matrix scaled by the square roots of its eigenvalues. Multiplying standard
+     * normal samples by this gives samples with the covariance of the last decomposition.
+     */
+    Eigen::MatrixXf _sqrt_covar;
+
+    /** The inverse square root of the covariance matrix as of the last decomposition */
+    Eigen::MatrixXf _inv_sqrt_covar;
+
+    /** The number of generations between decompositions of the covariance matrix */
+    int _decomposition_interval;
+
+    /** The number of generations since the covariance matrix was last decomposed */
+    int _generations_since_decomposition;
+
     /**
      * The current step size. This is how far the next generation will move.
      * The vector is length _genome_size * 3, 3 components for each point in the bezier curve (X, Y, Z).
@@ -439,14 +554,28 @@ private:
     /**
      * The samples from the distribution minus the mean. We separate this from the completed, evalulatable population to decrease
      * the chance of numerical error because we are dealing with large numbers.
+     * There is a column of _genome_size * 3 components for every individual, so the whole population is sampled with
+     * one matrix product.
      */
-    std::vector<Eigen::VectorXf> _samples;
+    Eigen::MatrixXf _samples;
 
-    /** Several multithreaded standard normal sample generator to speed up population sampling */
-    std::vector<SampleGenerator*> _sample_gens;
+    /**
+     * Only used when the evaluation is pipelined. These are the standard normal samples of the next generation,
+     * which are drawn while the GPU evaluates this generation.
+     */
+    Eigen::MatrixXf _next_samples;
 
-    /** The _mu best multinormal samples from the population */
-    std::vector<Eigen::VectorXf> _best_samples;
+    /** True if _next_samples has been filled since it was last used */
+    bool _next_samples_drawn = false;
+
+    /** The standard normal sample generator, seeded by the route */
+    std::unique_ptr<SampleGenerator> _sample_gen;
+
+    /** The stream of _sample_gen that the next draw comes from */
+    uint64_t _sample_stream;
+
+    /** The _mu best multinormal samples from the population, one per column with the best first */
+    Eigen::MatrixXf _best_samples;
 
     /** The vector that is used to sort the individuals. We keep this around to avoid allocating every time we sort */
     std::vector<Individual> _sorted_individuals;
@@ -504,6 +633,18 @@ private:
 
     /** The constant that the length cost is multiplied by in the cost function*/
     const float _length_weight;
+
+    /** The number of chunks the population is evaluated in. When this is 1 nothing is pipelined */
+    const int _pipeline_chunks;
+
+    /** The decomposition interval from the configuration, 0 to use the CMA-ES rule */
+    const int _decomposition_setting;
+
+    /** The kind of curve that the paths are */
+    const CurveType _curve_type;
+
+    /** How the terrain is sampled between elevation pixels when the cost is evaluated */
+    const TerrainFilter _terrain_filter;
 };
 
 #endif //ROUTES_POPULATION_H
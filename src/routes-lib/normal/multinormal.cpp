@@ -23,6 +23,17 @@ MultiNormal::MultiNormal(const Eigen::MatrixXf& covariance_matrix, Eigen::Vector
     
 }
 
+MultiNormal::MultiNormal(Eigen::VectorXf sigma) : _sigma(sigma) {}
+
+MultiNormal MultiNormal::fromFactor(const Eigen::MatrixXf& factor, Eigen::VectorXf sigma) {
+
+    MultiNormal dist = MultiNormal(sigma);
+    dist._L = factor;
+
+    return dist;
+
+}
+
 void MultiNormal::generateRandomSamples(std::vector<Eigen::VectorXf>& out, SampleGenerator& sampler) {
 
     // Overwrite everything in the vector
@@ -36,11 +47,17 @@ void MultiNormal::doSample(Eigen::VectorXf& out_sample, SampleGenerator& sampler
     // Grab a sample
     sampler.getSample(out_sample);
     
-    // Transform the sample by the decomposed covariance and then add the mean vector
-    out_sample = (_L * out_sample).cwiseProduct(_sigma);
+    doTransform(out_sample);
     
 }
 
+void MultiNormal::doTransform(Eigen::VectorXf& sample) {
+
+    // Transform the sample by the decomposed covariance and then scale it by the step size
+    sample = (_L * sample).cwiseProduct(_sigma);
+
+}
+
 void MultiNormal::generateRandomSamples(std::vector<Eigen::VectorXf>& out, std::vector<SampleGenerator*> samplers) {
 
     // Determine params
@@ -68,3 +85,59 @@ void MultiNormal::generateRandomSamples(std::vector<Eigen::VectorXf>& out, std::
         threads[i].join();
 
 }
+
+void MultiNormal::transformSamples(std::vector<Eigen::VectorXf>& samples, int num_workers) {
+
+    int work_size = (int)samples.size() / num_workers;
+
+    std::vector<std::thread> threads ((size_t)num_workers);
+
+    for (int i = 0; i < num_workers; i++) {
+
+        threads[i] = std::thread([this, i, &samples, work_size, num_workers] {
+
+            // The last worker picks up whatever doesn't divide evenly
+            int start = i * work_size;
+            int end = i == num_workers - 1 ? (int)samples.size() : start + work_size;
+
+            for (int p = start; p < end; p++)
+                doTransform(samples[p]);
+
+        });
+
+    }
+
+    for (int i = 0; i < num_workers; i++)
+        threads[i].join();
+
+}
+
+void MultiNormal::transformSamples(Eigen::MatrixXf& samples, int num_workers) {
+
+    int work_size = (int)samples.cols() / num_workers;
+
+    std::vector<std::thread> threads ((size_t)num_workers);
+
+    for (int i = 0; i < num_workers; i++) {
+
+        threads[i] = std::thread([this, i, &samples, work_size, num_workers] {
+
+            // The last worker picks up whatever doesn't divide evenly
+            int start = i * work_size;
+            int end = i == num_workers - 1 ? (int)samples.cols() : start + work_size;
+
+            if (end == start)
+                return;
+
+            // One product for the whole block, then scale every row by its step size
+            Eigen::MatrixXf transformed = _L * samples.middleCols(start, end - start);
+            samples.middleCols(start, end - start) = _sigma.asDiagonal() * transformed;
+
+        });
+
+    }
+
+    for (int i = 0; i < num_workers; i++)
+        threads[i].join();
+
+}
@@ -37,6 +37,21 @@ class MultiNormal {
          */
         MultiNormal(const Eigen::MatrixXf& covariance_matrix, Eigen::VectorXf sigma);
 
+        /**
+         * Creates a multivariate normal distribution from a covariance matrix that has already been decomposed, so that
+         * a decomposition can be shared with whatever else needs it instead of being done again.
+         *
+         * @param factor
+         * Any matrix that gives the covariance matrix when multiplied by its own transpose
+         *
+         * @param sigma
+         * The step size of the distribution
+         *
+         * @return
+         * The distribution
+         */
+        static MultiNormal fromFactor(const Eigen::MatrixXf& factor, Eigen::VectorXf sigma);
+
         /**
          * Fills the out vector with samples from this distribution.
          *
@@ -60,8 +75,41 @@ class MultiNormal {
          * The size of this vector determines the number of threads used.
          */
          void generateRandomSamples(std::vector<Eigen::VectorXf>& out, std::vector<SampleGenerator*> samplers);
+
+        /**
+         * Turns samples from the standard normal distribution into samples from this distribution in place.
+         * This lets the standard normal samples be drawn ahead of time, before the distribution is known.
+         *
+         * @param samples
+         * The standard normal samples, which are overwritten with samples from this distribution
+         *
+         * @param num_workers
+         * The number of threads to use
+         */
+        void transformSamples(std::vector<Eigen::VectorXf>& samples, int num_workers);
+
+        /**
+         * Turns standard normal samples stored as the columns of a matrix into samples from this distribution in place.
+         * Each worker transforms a block of columns with a single matrix product, which is much faster than a
+         * matrix-vector product per sample.
+         *
+         * @param samples
+         * The standard normal samples, one per column, which are overwritten with samples from this distribution
+         *
+         * @param num_workers
+         * The number of threads to use
+         */
+        void transformSamples(Eigen::MatrixXf& samples, int num_workers);
     
     private:
+
+        /**
+         * Creates a distribution without decomposing anything, used by fromFactor.
+         *
+         * @param sigma
+         * The step size of the distribution
+         */
+        explicit MultiNormal(Eigen::VectorXf sigma);
     
         /**
          * Generates a random sample from the distribution.
@@ -74,6 +122,14 @@ class MultiNormal {
          *
          */
         void doSample(Eigen::VectorXf& out_sample, SampleGenerator& sampler);
+
+        /**
+         * Transforms a single standard normal sample into a sample from the distribution.
+         *
+         * @param sample
+         * The standard normal sample, which is overwritten
+         */
+        void doTransform(Eigen::VectorXf& sample);
     
         /**
          * Represents the decomposition of the covariance matrix. Multiplying a vector with independent random samples from the
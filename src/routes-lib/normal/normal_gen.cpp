@@ -4,65 +4,119 @@
 
 #include "normal_gen.h"
 
-std::hash<long long int> hasher;
+SampleGenerator::SampleGenerator(int length, uint64_t seed) : _length(length), _next(0) {
 
-SampleGenerator::SampleGenerator(int length, int retainer) : _queue(new boost::lockfree::spsc_queue<Eigen::VectorXf>(retainer)),
-                                                             _length(length),
-                                                             _should_gen_samples(true),
-                                                             _twister(hasher(std::chrono::high_resolution_clock::now().time_since_epoch().count())),
-                                                             _standard_distro(0.0, 1.0) {
+    _key[0] = (uint32_t)seed;
+    _key[1] = (uint32_t)(seed >> 32);
 
-    // Start the sample thread
-    _sample_thread = std::thread([this]{ generateSamples(); });
-                                                                 
 }
 
-SampleGenerator::~SampleGenerator() {
+void SampleGenerator::getSample(Eigen::VectorXf& to_place) {
+
+    drawSample(to_place.data(), SAMPLE_GENERATOR_SEQUENTIAL_STREAM, _next++);
+
+}
 
-    // Stop the sample thread and clean up the queue
-    _should_gen_samples = false;
-    _sample_thread.join();
+void SampleGenerator::getSample(Eigen::Ref<Eigen::VectorXf> to_place) {
 
-    delete _queue;
+    drawSample(to_place.data(), SAMPLE_GENERATOR_SEQUENTIAL_STREAM, _next++);
 
 }
 
-void SampleGenerator::getSample(Eigen::VectorXf& to_place) {
+void SampleGenerator::fill(Eigen::MatrixXf& out, uint64_t stream, int num_workers) const {
+
+    int work_size = (int)out.cols() / num_workers;
+
+    std::vector<std::thread> threads ((size_t)num_workers);
+
+    for (int i = 0; i < num_workers; i++) {
+
+        threads[i] = std::thread([this, i, &out, stream, work_size, num_workers] {
+
+            // The last worker picks up whatever doesn't divide evenly
+            int start = i * work_size;
+            int end = i == num_workers - 1 ? (int)out.cols() : start + work_size;
+
+            for (int sample = start; sample < end; sample++)
+                drawSample(out.col(sample).data(), stream, (uint32_t)sample);
+
+        });
+
+    }
+
+    for (int i = 0; i < num_workers; i++)
+        threads[i].join();
+
+}
+
+void SampleGenerator::philox(const uint32_t counter[4], const uint32_t key[2], uint32_t out[4]) {
+
+    uint32_t c[4] = {counter[0], counter[1], counter[2], counter[3]};
+    uint32_t k[2] = {key[0], key[1]};
+
+    for (int round = 0; round < 10; round++) {
+
+        // The key is bumped by the Weyl sequence between rounds
+        if (round) {
+
+            k[0] += 0x9E3779B9;
+            k[1] += 0xBB67AE85;
+
+        }
 
-    // More than likely we are going to get a sample, but we need to ensure it.
-    // If we failed to get one generate one on the calling thread
-    if (!_queue->pop(to_place)) {
+        uint64_t product0 = (uint64_t)0xD2511F53 * c[0];
+        uint64_t product1 = (uint64_t)0xCD9E8D57 * c[2];
 
-        for (int i = 0; i < _length; i++)
-            to_place(i) = _standard_distro(_twister);
+        uint32_t next[4] = {(uint32_t)(product1 >> 32) ^ c[1] ^ k[0], (uint32_t)product1,
+                            (uint32_t)(product0 >> 32) ^ c[3] ^ k[1], (uint32_t)product0};
+
+        c[0] = next[0];
+        c[1] = next[1];
+        c[2] = next[2];
+        c[3] = next[3];
 
     }
 
+    out[0] = c[0];
+    out[1] = c[1];
+    out[2] = c[2];
+    out[3] = c[3];
+
 }
 
-void SampleGenerator::generateSamples() {
+void SampleGenerator::drawSample(float* out, uint64_t stream, uint32_t index) const {
+
+    const float scale = 1.0f / 4294967296.0f;
+    const float two_pi = 6.28318530717958647692f;
+
+    // Philox gives 4 words per counter, so the components are done in blocks of 4
+    for (int block = 0; block * 4 < _length; block++) {
 
-    // Loop until our services are no longer required
-    while (_should_gen_samples) {
+        uint32_t counter[4] = {(uint32_t)block, index, (uint32_t)stream, (uint32_t)(stream >> 32)};
+        uint32_t bits[4];
 
-        // Generate as many samples as we need
-        // Because there is no way to see if we are full we generate samples until we get a failure
-        while (true) {
+        philox(counter, _key, bits);
 
-            // Generate a new sample
-            Eigen::VectorXf sample = Eigen::VectorXf(_length);
-            
-            for (int i = 0; i < _length; i++)
-                sample(i) = _standard_distro(_twister);
+        // Box-Muller turns each pair of words into a pair of independent samples
+        float samples[4];
 
-            // Try to push and if we cant it means the queue is full and we can stop
-            if (!_queue->push(sample))
-                break;
+        for (int pair = 0; pair < 2; pair++) {
+
+            // The first uniform is in (0, 1] so the log is finite
+            float u1 = ((float)bits[pair * 2] + 1.0f) * scale;
+            float u2 = (float)bits[pair * 2 + 1] * scale;
+
+            float radius = std::sqrt(-2.0f * std::log(u1));
+
+            samples[pair * 2]     = radius * std::cos(two_pi * u2);
+            samples[pair * 2 + 1] = radius * std::sin(two_pi * u2);
 
         }
 
-        // Sleep for a bit
-        std::this_thread::yield();
+        int count = glm::min(4, _length - block * 4);
+
+        for (int i = 0; i < count; i++)
+            out[block * 4 + i] = samples[i];
 
     }
 
@@ -5,80 +5,113 @@
 #ifndef ROUTES_NORMAL_GEN_H
 #define ROUTES_NORMAL_GEN_H
 
-#include <ctime>
+#include <cmath>
+#include <cstdint>
 #include <eigen3/Eigen/Eigen>
-#include <iostream>
-#include <boost/random/mersenne_twister.hpp>
-#include <boost/random/normal_distribution.hpp>
-#include <boost/lockfree/spsc_queue.hpp>
+#include <glm/glm.hpp>
 #include <thread>
+#include <vector>
 
 /** */
 
+/** The stream that getSample draws from, so that it never overlaps with the streams that fill draws from */
+#define SAMPLE_GENERATOR_SEQUENTIAL_STREAM 0xFFFFFFFFFFFFFFFFull
+
 /**
- * Because sampling from a multivariate normal distribution is so slow and all require samples from the standard
- * normal distribution, we can pull the standard random samples from another thread so they are always ready.
- * This class will store N random samples of the desired length from the standard normal distribution.
- *
- * It is assumed that there will only be a single reader asking for samples.
+ * Draws samples from the standard normal distribution with Philox4x32-10, a counter based generator.
  *
+ * Every component of every sample is a pure function of the seed, a stream, the index of the sample and the index of
+ * the component, so there is no state to share between threads and no thread has to run ahead to keep samples ready.
+ * A matrix of samples can be filled by any number of threads and comes out the same. Philox turns each counter into
+ * 4 random integers, which a Box-Muller transform turns into 4 samples.
  */
 class SampleGenerator {
 
     public:
 
         /**
-         * Creates a new sample generator and launches the thread for it.
+         * Creates a new sample generator.
          *
          * @param length
          *  The number of components each sample should have.
          *
-         * @param retainer
-         * The number of samples that should be retained at any time.
+         * @param seed
+         * The seed. Generators with the same seed draw the same samples.
          *
          */
-        SampleGenerator(int length, int retainer);
-
-        /** Ensures that the samples are no longer generated when this is destroyed by stopping the thread */
-        ~SampleGenerator();
+        SampleGenerator(int length, uint64_t seed);
 
         /**
-         * Copies a sample that has already been generated to the destination vector. It is assumed that the
-         * destination is the same length as _length.
+         * Draws the next sample of the sequential stream. It is assumed that the destination is the same length as
+         * _length and that there is only one caller at a time.
          *
          * @param to_place
          * The reference to the vector that should be populated.
          */
         void getSample(Eigen::VectorXf& to_place);
 
-    private:
+        /**
+         * Draws the next sample of the sequential stream into a column of a matrix, or anything else that is laid out
+         * like a vector.
+         *
+         * @param to_place
+         * Where the sample should go. It is assumed to be _length long.
+         */
+        void getSample(Eigen::Ref<Eigen::VectorXf> to_place);
+
+        /**
+         * Fills every column of a matrix with a sample. Column i gets sample i of the stream, so the result only
+         * depends on the seed and the stream.
+         *
+         * @param out
+         * The matrix to fill. It should have _length rows.
+         *
+         * @param stream
+         * Which samples to draw. Filling with a different stream gives independent samples.
+         *
+         * @param num_workers
+         * The number of threads to use
+         */
+        void fill(Eigen::MatrixXf& out, uint64_t stream, int num_workers) const;
 
-        /* Handles the generation of new sample on another thread */
-        void generateSamples();
+        /**
+         * Runs the Philox4x32-10 bijection.
+         *
+         * @param counter
+         * The 4 words of the counter.
+         *
+         * @param key
+         * The 2 words of the key.
+         *
+         * @param out
+         * Where the 4 random words are written.
+         */
+        static void philox(const uint32_t counter[4], const uint32_t key[2], uint32_t out[4]);
+
+    private:
 
         /**
-         * The queue that the samples are placed into.
-         * We use the boost lockfree spsc_queue because it is FIFO for a single reader and writer.
+         * Draws a single sample.
+         *
+         * @param out
+         * Where the _length components are written.
+         *
+         * @param stream
+         * The stream the sample is from.
+         *
+         * @param index
+         * The index of the sample in the stream.
          */
-        boost::lockfree::spsc_queue<Eigen::VectorXf>* _queue;
+        void drawSample(float* out, uint64_t stream, uint32_t index) const;
 
         /** The number of components each sample should have. */
         int _length;
 
-        /** Whether or not samples should still be generated on the thread */
-        std::atomic<bool> _should_gen_samples;
-
-        /** The thread that sampling is performed on */
-        std::thread _sample_thread;
+        /** The Philox key, which is just the seed */
+        uint32_t _key[2];
 
-        /** A Mersenne Twister object (a pseudorandom generator) that we pull the samples from. */
-        boost::mt19937 _twister;
-
-        /**
-         * The normal distribution that we sample from, AKA the standard normal distribution.
-         * This is by definition N(0, 1)
-         */
-        boost::normal_distribution<float> _standard_distro;
+        /** The index of the next sample that getSample draws */
+        uint32_t _next;
 
 };
 
@@ -7,6 +7,7 @@
 boost::compute::device                           Kernel::_opencl_device;
 boost::compute::context                          Kernel::_opencl_context;
 boost::compute::command_queue                    Kernel::_opencl_queue;
+boost::compute::command_queue                    Kernel::_opencl_transfer_queue;
 boost::shared_ptr<boost::compute::program_cache> Kernel::_global_cache;
 
 bool Kernel::_is_initialized = Kernel::initOpenCL();
@@ -21,6 +22,7 @@ bool Kernel::initOpenCL() {
 
     // Create a command queue for the context on the device
     _opencl_queue = boost::compute::command_queue(_opencl_context, _opencl_device);
+    _opencl_transfer_queue = boost::compute::command_queue(_opencl_context, _opencl_device);
 
     // Get the cache
     _global_cache = boost::compute::program_cache::get_global_cache(_opencl_context);
@@ -78,7 +80,18 @@ Kernel::Kernel(const boost::compute::program& program, const std::string& name)
 
     // We already have the program so just tell it to create a new kernel
     _opencl_program = program;
-    _opencl_kernel = _opencl_program.create_kernel(name);
+
+    try {
+
+        _opencl_kernel = _opencl_program.create_kernel(name);
+        _opencl_program_valid = true;
+
+    } catch (boost::compute::opencl_error error) {
+
+        // The program was most likely never built successfully, remember that this kernel can't be run
+        _opencl_program_valid = false;
+
+    }
 
 }
 
@@ -90,12 +103,16 @@ void Kernel::execute1D(size_t start_index, size_t num_iterations, size_t work_si
 
 }
 
-void Kernel::execute2D(const glm::vec<2, size_t>& start_index,
-                       const glm::vec<2, size_t>& num_iterations,
-                       const glm::vec<2, size_t>& work_size) {
+boost::compute::event Kernel::execute2D(const glm::vec<2, size_t>& start_index,
+                                        const glm::vec<2, size_t>& num_iterations,
+                                        const glm::vec<2, size_t>& work_size,
+                                        const boost::compute::wait_list& events) {
 
     // Add a work order onto the kernel with the parameters that were given
     if (_opencl_program_valid)
-        _opencl_queue.enqueue_nd_range_kernel(_opencl_kernel, 2, &start_index[0], &num_iterations[0], &work_size[0]);
+        return _opencl_queue.enqueue_nd_range_kernel(_opencl_kernel, 2, &start_index[0], &num_iterations[0],
+                                                     &work_size[0], events);
+
+    return boost::compute::event();
 
 }
@@ -103,14 +103,37 @@ public:
     * @param work_size
     * The size of each work group to be iterated over. When not specified,
     * OpenCL will do it's best to figure out what it should use.
+    *
+    * @param events
+    * Events that have to finish before the kernel starts.
+    *
+    * @return
+    * The event of the kernel, which is empty if the program is not valid.
     */
-    void execute2D(const glm::vec<2, size_t>& start_index,
-                   const glm::vec<2, size_t>& num_iterations,
-                   const glm::vec<2, size_t>& work_size = glm::vec<2, size_t>(0, 0));
+    boost::compute::event execute2D(const glm::vec<2, size_t>& start_index,
+                                    const glm::vec<2, size_t>& num_iterations,
+                                    const glm::vec<2, size_t>& work_size = glm::vec<2, size_t>(0, 0),
+                                    const boost::compute::wait_list& events = boost::compute::wait_list());
 
     inline static const boost::compute::context& getContext() { return _opencl_context; }
     inline static boost::compute::command_queue& getQueue()   { return _opencl_queue; }
 
+    /**
+     * Gets a second queue on the same device for copies, so that they can run while a kernel on the main queue runs.
+     *
+     * @return
+     * The transfer queue
+     */
+    inline static boost::compute::command_queue& getTransferQueue() { return _opencl_transfer_queue; }
+
+    /**
+     * Checks if the program of this kernel was compiled.
+     *
+     * @return
+     * True if the kernel can be executed
+     */
+    inline bool isValid() const { return _opencl_program_valid; }
+
     /**
      * Gets a const reference to the program that was compiled to create this kernel.
      * This can be used to create another kernel with the same program.
@@ -166,6 +189,9 @@ private:
     /** The OpenCL compute queue on which all Kernel computations are performed on. */
     static boost::compute::command_queue _opencl_queue;
 
+    /** A second queue that copies run on while kernels run on _opencl_queue */
+    static boost::compute::command_queue _opencl_transfer_queue;
+
     /**
     *  The OpenCL global cache utilized by all Kernel objects.
     *  This is how parameters are passed from the CPU to the compute device.
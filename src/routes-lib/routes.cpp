@@ -4,31 +4,23 @@
 
 #include "routes.h"
 
-float Routes::_time;
-float Routes::_length;
-std::vector<glm::vec2> Routes::_elevations;
-std::vector<glm::vec2> Routes::_ground_elevations;
-std::vector<glm::vec2> Routes::_speeds;
-std::vector<glm::vec2> Routes::_grades;
-int Routes::_route_id;
-std::string Routes::_solutions;
-int Routes::_pop_size;
-int Routes::_num_generations;
-Configure Routes::_config;
-bool Routes::_useDb;
 Database Routes::_db = Database("evie", "evie", "evolution");
 
-std::vector<glm::vec3> Routes::calculateRoute(glm::vec2 start, glm::vec2 dest) {
+RouteResult Routes::calculateRoute(glm::vec2 start, glm::vec2 dest, const ProgressCallback& progress) {
 
-
-    configureParams();
+    // Load the parameters for this route
+    Configure config = Configure();
+    int pop_size = config.getPopulationSize();
+    int num_generations = config.getNumGenerations();
+    bool use_db = config.getUseDb();
 
     time_t now = time(0);
 
     std::cout << "Calculating a route\n";
 
-    // Stitch together the data
-    ElevationData data = ElevationData(start, dest);
+    // Stitch together the data, it only has to be uploaded to OpenCL if the cost is evaluated there
+    bool use_opencl = CostEvaluator::parseBackend(config.getCostBackend()) == CostBackend::OpenCL;
+    ElevationData data = ElevationData(start, dest, config.getPyramidLevels(), use_opencl);
 
     // Figure out where the longitude and latitude are in meters
     glm::dvec3 start_meter = data.metersToMetersAndElevation(data.longitudeLatitudeToMeters(start));
@@ -42,39 +34,37 @@ std::vector<glm::vec3> Routes::calculateRoute(glm::vec2 start, glm::vec2 dest) {
     // Create a pod and a population
     Pod pod = Pod(DEFAULT_POD_MAX_SPEED);
 
-    _config = Configure();
-    Population pop = Population(_pop_size, glm::vec4(start_meter.x, start_meter.y, start_meter.z + 10.0, 0.0),
-                                          glm::vec4(dest_meter.x, dest_meter.y, dest_meter.z + 10.0, 0.0), data, _config);
-
-    _useDb = _config.getUseDb();
+    Population pop = Population(pop_size, glm::vec4(start_meter.x, start_meter.y, start_meter.z + 10.0, 0.0),
+                                          glm::vec4(dest_meter.x, dest_meter.y, dest_meter.z + 10.0, 0.0), data, config);
 
     // Solve!
     // These points will be in meters so we need to convert them
-    std::vector<glm::vec3> computed = Genetics::solve(pop, pod, _num_generations, start, dest, _useDb);
+    GeneticsResult solved = Genetics::solve(pop, pod, num_generations, data, start, dest, use_db,
+                                            config.getCoarseFraction(), progress);
+    std::vector<glm::vec3>& computed = solved.controls;
 
-    std::vector<glm::vec3> points = Bezier::evaluateEntireBezierCurve(computed, 100);
+    std::vector<glm::vec3> points = Spline::evaluateEntireCurve(computed, 100, pop.getCurveType());
 
-    _solutions = Genetics::getEval();
+    RouteResult result;
 
-    _time = pod.timeForCurve(points);
-    _length = Bezier::bezierLength(points);
+    result.time = pod.timeForCurve(points);
+    result.length = Bezier::bezierLength(points);
 
-    _route_id = Genetics::getRouteId();
+    result.route_id = solved.route_id;
 
-    std::vector<glm::vec2> elev;
     std::vector<float> velocities = pod.getVelocities(points);
-    std::vector<glm::vec2> speeds;
-    std::vector<glm::vec2> g_elev;
-    std::vector<glm::vec2> grades;
+
+    // Sample the ground the same way the cost function saw it
+    TerrainFilter filter = ElevationData::parseTerrainFilter(config.getTerrainFilter());
 
     std::unordered_map<int, float> lengthMap = Bezier::bezierLengthMap(points);
 
     for (int i = 0; i < points.size(); i++) {
-        elev.push_back({lengthMap[i], points[i].z});
-        speeds.push_back({lengthMap[i], velocities[i]});
+        result.elevations.push_back({lengthMap[i], points[i].z});
+        result.speeds.push_back({lengthMap[i], velocities[i]});
         glm::vec2 newPoint = {points[i].x, points[i].y};
-        float newElev = data.metersToElevation(newPoint);
-        g_elev.push_back({lengthMap[i], newElev});
+        float newElev = data.metersToElevation(newPoint, filter);
+        result.ground_elevations.push_back({lengthMap[i], newElev});
     }
 
     float spacing = 0.0f;
@@ -82,14 +72,9 @@ std::vector<glm::vec3> Routes::calculateRoute(glm::vec2 start, glm::vec2 dest) {
     for (int i = 1; i < points.size(); i++) {
         spacing = sqrt(glm::pow(points[i].x - points[i-1].x, 2) + glm::pow(points[i].y - points[i-1].y, 2));
 
-        grades.push_back({lengthMap[i], fabs(((points[i].z - points[i-1].z) * 100) / spacing)});
+        result.grades.push_back({lengthMap[i], fabs(((points[i].z - points[i-1].z) * 100) / spacing)});
     }
 
-    _elevations = elev;
-    _ground_elevations = g_elev;
-    _speeds = speeds;
-    _grades = grades;
-
     // Convert to longitude, latitude and elevation
     for (int i = 0; i < computed.size(); i++) {
 
@@ -101,175 +86,51 @@ std::vector<glm::vec3> Routes::calculateRoute(glm::vec2 start, glm::vec2 dest) {
 
     }
 
-    time_t after = time(0);
-    std::cout << "time to compute: " + std::to_string(after-now) << std::endl;
-
-    return computed;
-
-}
-
-void Routes::configureParams() {
-
-    _pop_size = _config.getPopulationSize();
-    _num_generations = _config.getNumGenerations();
-
-}
-
-float Routes::getTime() {
-    return _time;
-}
-
-float Routes::getLength() {
-    return _length;
-}
-
-std::vector<glm::vec2> Routes::getElevations() {
-    return _elevations;
-}
-
-std::vector<glm::vec2> Routes::getSpeeds() {
-    return _speeds;
-}
-
-std::vector<glm::vec2> Routes::getGElevations() {
-    return _ground_elevations;
-}
-
-std::vector<glm::vec2> Routes::getGrades() {
-    return _grades;
-}
-
-int Routes::getId() {
-    return _route_id;
-}
-
-std::string Routes::getSolutions() {
-
-    std::string result;
-
-    if (_useDb) {
-
-        std::string toExec = "SELECT \"Controls\".evaluated FROM \"Controls\" "
-                             "JOIN \"Generation\" ON (\"Controls\".controls_id = \"Generation\".controls_id) "
-                             "JOIN \"Route\" ON (\"Route\".route_id = \"Generation\".route_id) "
-                             "WHERE \"Route\".route_id = " + std::to_string(_route_id);
-        result = _db.selectSolutions(toExec);
-    } else {
-        result = "[[]]";
-    }
-
-    return result;
+    // The converted control points are handed off to the result rather than copied
+    result.evaluated = Spline::evaluateEntireCurve(computed, 2400, pop.getCurveType());
+    result.controls = std::move(computed);
 
-}
+    // Get the history of the route out of the database
+    loadHistory(result, use_db);
 
-std::string Routes::getTotalFitness() {
-
-    std::string result;
-
-    if (_useDb) {
-
-        std::string toExec = "SELECT \"Fitness\".total_fitness FROM \"Fitness\" "
-                             "JOIN \"Generation\" ON (\"Fitness\".generation_id = \"Generation\".generation_id) "
-                             "JOIN \"Controls\" ON (\"Controls\".controls_id = \"Generation\".controls_id) "
-                             "JOIN \"Route\" ON (\"Route\".route_id = \"Generation\".route_id) "
-                             "WHERE \"Route\".route_id = " + std::to_string(_route_id)
-                             + " ORDER BY \"Generation\".generation";
-        result = _db.selectTotalFitness(toExec);
-    } else {
-        result = "[[]]";
-    }
+    time_t after = time(0);
+    std::cout << "time to compute: " + std::to_string(after-now) << std::endl;
 
     return result;
 
 }
 
-std::string Routes::getTrackFitness() {
-
-    std::string result;
-
-    if (_useDb) {
+void Routes::loadHistory(RouteResult& result, bool use_db) {
 
-        std::string toExec = "SELECT \"Fitness\".track_fitness FROM \"Fitness\" "
-                             "JOIN \"Generation\" ON (\"Fitness\".generation_id = \"Generation\".generation_id) "
-                             "JOIN \"Controls\" ON (\"Controls\".controls_id = \"Generation\".controls_id) "
-                             "JOIN \"Route\" ON (\"Route\".route_id = \"Generation\".route_id) "
-                             "WHERE \"Route\".route_id = " + std::to_string(_route_id)
-                             + " ORDER BY \"Generation\".generation";
-        result = _db.selectTrackFitness(toExec);
-    } else {
-        result = "[[]]";
-    }
+    if (use_db) {
 
-    return result;
-
-}
+        // Everything comes back from a single query
+        RouteHistory history = _db.selectHistory(result.route_id);
 
-std::string Routes::getCurveFitness() {
+        result.solutions = std::move(history.solutions);
+        result.total_fitness = std::move(history.total_fitness);
+        result.track_fitness = std::move(history.track_fitness);
+        result.curve_fitness = std::move(history.curve_fitness);
+        result.grade_fitness = std::move(history.grade_fitness);
+        result.length_fitness = std::move(history.length_fitness);
 
-    std::string result;
-
-    if (_useDb) {
-
-        std::string toExec = "SELECT \"Fitness\".curve_fitness FROM \"Fitness\" "
-                             "JOIN \"Generation\" ON (\"Fitness\".generation_id = \"Generation\".generation_id) "
-                             "JOIN \"Controls\" ON (\"Controls\".controls_id = \"Generation\".controls_id) "
-                             "JOIN \"Route\" ON (\"Route\".route_id = \"Generation\".route_id) "
-                             "WHERE \"Route\".route_id = " + std::to_string(_route_id)
-                             + " ORDER BY \"Generation\".generation";
-        result = _db.selectCurveFitness(toExec);
     } else {
-        result = "[[]]";
-    }
 
-    return result;
-}
-
-std::string Routes::getGradeFitness() {
-
-    std::string result;
+        result.solutions = "[[]]";
+        result.total_fitness = "[[]]";
+        result.track_fitness = "[[]]";
+        result.curve_fitness = "[[]]";
+        result.grade_fitness = "[[]]";
+        result.length_fitness = "[[]]";
 
-    if (_useDb) {
-
-        std::string toExec = "SELECT \"Fitness\".grade_fitness FROM \"Fitness\" "
-                             "JOIN \"Generation\" ON (\"Fitness\".generation_id = \"Generation\".generation_id) "
-                             "JOIN \"Controls\" ON (\"Controls\".controls_id = \"Generation\".controls_id) "
-                             "JOIN \"Route\" ON (\"Route\".route_id = \"Generation\".route_id) "
-                             "WHERE \"Route\".route_id = " + std::to_string(_route_id)
-                             + " ORDER BY \"Generation\".generation";
-        result = _db.selectGradeFitness(toExec);
-    } else {
-        result = "[[]]";
     }
 
-    return result;
-
-}
-
-std::string Routes::getLengthFitness() {
-
-    std::string result;
-
-    if (_useDb) {
-
-        std::string toExec = "SELECT \"Fitness\".length_fitness FROM \"Fitness\" "
-                             "JOIN \"Generation\" ON (\"Fitness\".generation_id = \"Generation\".generation_id) "
-                             "JOIN \"Controls\" ON (\"Controls\".controls_id = \"Generation\".controls_id) "
-                             "JOIN \"Route\" ON (\"Route\".route_id = \"Generation\".route_id) "
-                             "WHERE \"Route\".route_id = " + std::to_string(_route_id)
-                             + " ORDER BY \"Generation\".generation";
-        result = _db.selectLengthFitness(toExec);
-    } else {
-        result = "[[]]";
-    }
-
-    return result;
-
 }
 
 bool Routes::validatePoint(const glm::vec3& point) {
 
     // Make sure that the z is not past a crazy number
-    if (fabs(point.z) < 1000000.0)
+    if (fabs(point.z) < ELEVATION_NODATA_LIMIT)
         return true;
 
     return false;
@@ -8,6 +8,83 @@
 #include "genetics/genetics.h"
 #include "database/database.h"
 
+/**
+ * Everything that was calculated about a single route.
+ * Every call to Routes::calculateRoute creates its own result so that several routes can be calculated at once.
+ */
+struct RouteResult {
+
+    /** The control points of the curve. X and Y are longitude and latitude and Z is the elevation */
+    std::vector<glm::vec3> controls;
+
+    /** The evaluated points of the curve*/
+    std::vector<glm::vec3> evaluated;
+
+    /** The time needed to traverse the route in seconds*/
+    float time;
+
+    /** The length of the track in meters*/
+    float length;
+
+    /** The elevations of the track. The x values are the current distance(m) on
+     * the track and the y values are the elevations(m)
+     */
+    std::vector<glm::vec2> elevations;
+
+    /** The elevations of the ground. The x values are the current distance(m) on
+     * the track and the y values are the elevations(m)
+     */
+    std::vector<glm::vec2> ground_elevations;
+
+    /**
+     * The speed of the pod along the track. The x values are the current distance(m) on the
+     * track and the y values are the speeds(m/s)
+     */
+    std::vector<glm::vec2> speeds;
+
+    /**
+     * The grade of the pod as it moves along the track. The x values are the current distance(m)
+     * on the track and the y value are the grade.
+     */
+    std::vector<glm::vec2> grades;
+
+    /**
+     * The route_id for database querying
+     */
+    int route_id;
+
+    /**
+     * A JSON array of the best solutions at each generation of the route.
+     */
+    std::string solutions;
+
+    /**
+     * A JSON array of the total fitness at each generation of the route.
+     */
+    std::string total_fitness;
+
+    /**
+     * A JSON array of the track fitness at each generation of the route.
+     */
+    std::string track_fitness;
+
+    /**
+     * A JSON array of the curve fitness at each generation of the route.
+     */
+    std::string curve_fitness;
+
+    /**
+     * A JSON array of the grade fitness at each generation of the route.
+     */
+    std::string grade_fitness;
+
+    /**
+     * A JSON array of the length fitness at each generation of the route.
+     */
+    std::string length_fitness;
+
+};
+
 /** This is a simple class to handle the complete calculation of a route. */
 class Routes {
 
@@ -17,6 +94,7 @@ class Routes {
          * Performs the complete calculation of a route from one point to another given the start and destination.
          * This will calculate which datasets need to be stitched, stitch them, calculate the route and output
          * an HTML file.
+         * No state is shared between calls, so this may be called from several threads at once.
          *
          * @param start
          * The start position in longitude latitude of the route.
@@ -24,128 +102,27 @@ class Routes {
          * @param dest
          * The end position in longitude latitude of the route.
          *
-         * @return
-         * The computed points of the route in longitude latitude and elevation.
-         */
-        static std::vector<glm::vec3> calculateRoute(glm::vec2 start, glm::vec2 dest);
-
-        /**
-         * Gets the time to traverse the calculated route.
-         * Should always be called after calculateRoute.
-         *
-         * @return
-         * Time to traverse route in seconds
-         */
-        static float getTime();
-
-        /**
-         * Gets the length of the calculated route.
-         * Should always be called after calculateRoute.
-         *
-         * @return
-         * Length of the track in meters
-         */
-        static float getLength();
-
-        /**
-         * Gets the elevations of the route.
-         * Should always be called after calculateRoute.
-         *
-         * @return
-         * Pairs of distance along track and the elevation at that point in meters
-         */
-        static std::vector<glm::vec2> getElevations();
-
-        /**
-         * Gets the elevations of the ground along the route.
-         * Should always be called after calculateRoute.
-         *
-         * @return
-         * Pairs of distance along track and the elevation at that point in meters
-         */
-        static std::vector<glm::vec2> getGElevations();
-
-        /**
-         * Gets the speeds along the route.
-         * Should always be called after calculateRoute.
-         *
-         * @return
-         * Pairs of distance along track and the speed at that point in meters / second
-         */
-        static std::vector<glm::vec2> getSpeeds();
-
-        /**
-         * Gets the grade of the track along the route.
-         * Should always be called after calculateRoute.
-         *
-         * @return
-         * Pairs of distance along the track and the grade at that point
-         */
-        static std::vector<glm::vec2> getGrades();
-
-        /**
-         * Gets the route_id for querying the database.
-         * Should always be called after calculateRoute.
-         *
-         * @return
-         * The primary key for accessing the database for this route
-         */
-        static int getId();
-
-        /**
-         * Gets the solutions at each generation
-         *
-         * @return
-         * A String representing the JSON array of solutions at each generation
-         */
-        static std::string getSolutions();
-
-        /**
-         * Gets the total fitness at each generation
+         * @param progress
+         * Called after every generation with how far the calculation has gotten. This may be empty.
          *
          * @return
-         * A String representing the JSON array of total fitness at each generation
+         * Everything that was calculated about the route. The control points are in longitude latitude and elevation.
          */
-        static std::string getTotalFitness();
+        static RouteResult calculateRoute(glm::vec2 start, glm::vec2 dest,
+                                          const ProgressCallback& progress = ProgressCallback());
 
-        /**
-         * Gets the track fitness at each generation
-         *
-         * @return
-         * A String representing the JSON array of track fitness at each generation
-         */
-        static std::string getTrackFitness();
-
-        /**
-         * Gets the curve fitness at each generation
-         *
-         * @return
-         * A String representing the JSON array of curve fitness at each generation
-         */
-        static std::string getCurveFitness();
+    private:
 
         /**
-         * Gets the grade fitness at each generation
+         * Fills in the solutions and fitness at each generation of a route
          *
-         * @return
-         * A String representing the JSON array of grade fitness at each generation
-         */
-        static std::string getGradeFitness();
-
-        /**
-         * Gets the length fitness at each generation
+         * @param result
+         * The route, its route_id must already be set
          *
-         * @return
-         * A String representing the JSON array of length fitness at each generation
-         */
-        static std::string getLengthFitness();
-
-    private:
-
-        /**
-         * Reloads the paramaters if needed
+         * @param use_db
+         * True if the database was used to store the generations
          */
-        static void configureParams();
+        static void loadHistory(RouteResult& result, bool use_db);
 
         /**
          * In some areas we have a no data value in the elevation data. In this case we have no idea what to compute
@@ -159,86 +136,8 @@ class Routes {
          */
         static bool validatePoint(const glm::vec3& point);
 
-        /**
-         * Time to traverse route in seconds
-         */
-        static float _time;
-
-        /**
-         * Length of the track in meters
-         */
-        static float _length;
-
-        /**
-         * pairs of distance along track and the elevation at that point in meters
-         */
-        static std::vector<glm::vec2> _elevations;
-
-        /**
-         * pairs of distance along track and the elevation of the ground at that point in meters
-         */
-        static std::vector<glm::vec2> _ground_elevations;
-
-        /**
-         * pairs of distance along track and the speed at that point in meters / second
-         */
-        static std::vector<glm::vec2> _speeds;
-
-        /**
-         * pairs of distance along track and the grade at that point
-         */
-         static std::vector<glm::vec2> _grades;
-
-         /**
-          * The id of this route for querying the database
-          */
-         static int _route_id;
-
-         /**
-          * The solutions at each generation
-          */
-         static std::string _solutions;
-
-         /**
-          * The total fitness at each generation
-          */
-         static std::string total_fitness;
-
-         /**
-          * The track fitness at each generation
-          */
-         static std::string track_fitness;
-
-         /**
-          * The curve fitness at each generation
-          */
-         static std::string curve_fitness;
-
-         /**
-          * The grade fitness at each generation
-          */
-         static std::string grade_fitness;
-
-         /**
-          * The length fitness at each generation
-          */
-         static std::string length_fitness;
-
-         /** The default size of the population for calculating a route */
-         static int _pop_size;
-
-         /** This is a simplelass to handle the complete calculation of a route. */
-         static int _num_generations;
-
-         /**
-          * The current configuration
-          */
-         static Configure _config;
-
-         /** True if the database should be used */
-         static bool _useDb;
-
-         static Database _db;
+        /** The database that the generations of every route are stored in */
+        static Database _db;
 };
 
-#endif //ROUTES_ROUTES_H
\ No newline at end of file
+#endif //ROUTES_ROUTES_H
@@ -0,0 +1,151 @@
+//
+//  binary.cpp
+//  Routes
+//
+
+#include "binary.h"
+#include "../routes.h"
+
+BinaryWriter::BinaryWriter(size_t reserve) {
+
+    _buffer.reserve(reserve);
+
+}
+
+void BinaryWriter::writeUInt32(uint32_t value) {
+
+    _buffer.push_back((uint8_t)(value));
+    _buffer.push_back((uint8_t)(value >> 8));
+    _buffer.push_back((uint8_t)(value >> 16));
+    _buffer.push_back((uint8_t)(value >> 24));
+
+}
+
+void BinaryWriter::writeInt32(int32_t value) {
+
+    writeUInt32((uint32_t)value);
+
+}
+
+void BinaryWriter::writeFloat(float value) {
+
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    writeUInt32(bits);
+
+}
+
+void BinaryWriter::writePoints(const std::vector<glm::vec3>& points) {
+
+    // The components of a vec3 are packed together so the points can be treated as one array of floats
+    static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "glm::vec3 must be tightly packed");
+
+    if (!points.empty())
+        writeFloats(&points[0].x, points.size() * 3);
+
+}
+
+void BinaryWriter::writePoints(const std::vector<glm::vec2>& points) {
+
+    static_assert(sizeof(glm::vec2) == 2 * sizeof(float), "glm::vec2 must be tightly packed");
+
+    if (!points.empty())
+        writeFloats(&points[0].x, points.size() * 2);
+
+}
+
+void BinaryWriter::writeBytes(const std::string& str) {
+
+    _buffer.insert(_buffer.end(), str.begin(), str.end());
+
+}
+
+const std::vector<uint8_t>& BinaryWriter::bytes() const {
+
+    return _buffer;
+
+}
+
+std::vector<uint8_t> BinaryWriter::release() {
+
+    return std::move(_buffer);
+
+}
+
+void BinaryWriter::writeFloats(const float* values, size_t count) {
+
+    // Nothing needs to be swapped so the whole array can be copied at once
+    if (isLittleEndian()) {
+
+        size_t offset = _buffer.size();
+        _buffer.resize(offset + count * sizeof(float));
+        memcpy(&_buffer[offset], values, count * sizeof(float));
+
+    } else {
+
+        for (size_t i = 0; i < count; i++)
+            writeFloat(values[i]);
+
+    }
+
+}
+
+bool BinaryWriter::isLittleEndian() {
+
+    const uint32_t one = 1;
+    return *(const uint8_t*)&one == 1;
+
+}
+
+std::vector<uint8_t> BinaryWriter::routeToBinary(const RouteResult& route) {
+
+    const std::vector<glm::vec3>* point3_arrays[] = {&route.controls, &route.evaluated};
+    const std::vector<glm::vec2>* point2_arrays[] = {&route.elevations, &route.ground_elevations,
+                                                     &route.speeds, &route.grades};
+    const std::string* strings[] = {&route.solutions, &route.total_fitness, &route.track_fitness,
+                                    &route.curve_fitness, &route.grade_fitness, &route.length_fitness};
+
+    // Work out the exact size so the buffer is only allocated once
+    size_t size = 17 * sizeof(uint32_t);
+
+    for (const std::vector<glm::vec3>* points : point3_arrays)
+        size += points->size() * sizeof(glm::vec3);
+
+    for (const std::vector<glm::vec2>* points : point2_arrays)
+        size += points->size() * sizeof(glm::vec2);
+
+    for (const std::string* str : strings)
+        size += str->size();
+
+    BinaryWriter writer = BinaryWriter(size);
+
+    // The header, every field is 4 bytes so the arrays that follow are aligned for a Float32Array
+    writer.writeUInt32(BINARY_MAGIC);
+    writer.writeFloat(route.time);
+    writer.writeFloat(route.length);
+    writer.writeInt32(route.route_id);
+
+    // The number of points in each array followed by the number of bytes in each string
+    for (const std::vector<glm::vec3>* points : point3_arrays)
+        writer.writeUInt32((uint32_t)points->size());
+
+    for (const std::vector<glm::vec2>* points : point2_arrays)
+        writer.writeUInt32((uint32_t)points->size());
+
+    for (const std::string* str : strings)
+        writer.writeUInt32((uint32_t)str->size());
+
+    // The arrays and then the strings
+    for (const std::vector<glm::vec3>* points : point3_arrays)
+        writer.writePoints(*points);
+
+    for (const std::vector<glm::vec2>* points : point2_arrays)
+        writer.writePoints(*points);
+
+    for (const std::string* str : strings)
+        writer.writeBytes(*str);
+
+    return writer.release();
+
+}
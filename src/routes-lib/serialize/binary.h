@@ -0,0 +1,146 @@
+//
+//  binary.h
+//  Routes
+//
+
+#ifndef ROUTES_BINARY_H
+#define ROUTES_BINARY_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/** The first four bytes of the binary version of a route, "RTB1" when read as characters */
+#define BINARY_MAGIC 0x31425452
+
+struct RouteResult;
+
+/**
+ * Writes values into a byte buffer in little endian order, which is what browsers use for typed arrays. Arrays of
+ * points are written as tightly packed float32 values so that the client can view them with a Float32Array without
+ * parsing anything. On little endian machines, which is nearly all of them, whole arrays are copied at once.
+ */
+class BinaryWriter {
+
+    public:
+
+        /**
+         * Creates an empty writer.
+         *
+         * @param reserve
+         * The number of bytes to reserve in the buffer.
+         */
+        BinaryWriter(size_t reserve = 0);
+
+        /**
+         * Writes an unsigned 32 bit integer.
+         *
+         * @param value
+         * The value to write.
+         */
+        void writeUInt32(uint32_t value);
+
+        /**
+         * Writes a signed 32 bit integer.
+         *
+         * @param value
+         * The value to write.
+         */
+        void writeInt32(int32_t value);
+
+        /**
+         * Writes a 32 bit float.
+         *
+         * @param value
+         * The value to write.
+         */
+        void writeFloat(float value);
+
+        /**
+         * Writes the X, Y and Z of every point one after the other.
+         *
+         * @param points
+         * The points to write.
+         */
+        void writePoints(const std::vector<glm::vec3>& points);
+
+        /**
+         * Writes the X and Y of every point one after the other.
+         *
+         * @param points
+         * The points to write.
+         */
+        void writePoints(const std::vector<glm::vec2>& points);
+
+        /**
+         * Writes the characters of a string without its length or a terminator.
+         *
+         * @param str
+         * The string to write.
+         */
+        void writeBytes(const std::string& str);
+
+        /**
+         * Gets everything that has been written.
+         *
+         * @return
+         * The bytes.
+         */
+        const std::vector<uint8_t>& bytes() const;
+
+        /**
+         * Takes the buffer out of the writer without copying it. The writer should not be used afterwards.
+         *
+         * @return
+         * The bytes.
+         */
+        std::vector<uint8_t> release();
+
+        /**
+         * Converts a calculated route to a compact binary layout. Everything is little endian.
+         *
+         * The header is 17 four byte fields: BINARY_MAGIC, the time (float32), the length (float32), the route id
+         * (int32), the number of points in controls, evaluated, elevations, groundElevations, speeds and grades
+         * (uint32 each) and the number of bytes in solutions, totalFitness, trackFitness, curveFitness, gradeFitness
+         * and lengthFitness (uint32 each).
+         *
+         * The point arrays follow in the same order as packed float32 values, 3 per point for controls and evaluated
+         * and 2 per point for the rest. The strings come last as UTF-8 JSON without terminators.
+         *
+         * @param route
+         * The route to be converted.
+         *
+         * @return
+         * The bytes to send.
+         */
+        static std::vector<uint8_t> routeToBinary(const RouteResult& route);
+
+    private:
+
+        /**
+         * Writes an array of floats.
+         *
+         * @param values
+         * The first float.
+         *
+         * @param count
+         * The number of floats.
+         */
+        void writeFloats(const float* values, size_t count);
+
+        /**
+         * Checks the byte order of this machine.
+         *
+         * @return
+         * True if this machine is little endian.
+         */
+        static bool isLittleEndian();
+
+        /** The bytes that have been written */
+        std::vector<uint8_t> _buffer;
+
+};
+
+#endif //ROUTES_BINARY_H
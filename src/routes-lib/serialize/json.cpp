@@ -0,0 +1,251 @@
+//
+//  json.cpp
+//  Routes
+//
+
+#include "json.h"
+
+JSONWriter::JSONWriter(bool compact, size_t reserve) : _after_key(false), _compact(compact) {
+
+    _buffer.reserve(reserve);
+
+}
+
+void JSONWriter::beginObject() {
+
+    separate();
+    _buffer.push_back('{');
+    _has_values.push_back(false);
+
+}
+
+void JSONWriter::endObject() {
+
+    bool had_values = _has_values.back();
+    _has_values.pop_back();
+
+    if (had_values)
+        newLine();
+
+    _buffer.push_back('}');
+
+}
+
+void JSONWriter::beginArray() {
+
+    separate();
+    _buffer.push_back('[');
+    _has_values.push_back(false);
+
+}
+
+void JSONWriter::endArray() {
+
+    bool had_values = _has_values.back();
+    _has_values.pop_back();
+
+    if (had_values)
+        newLine();
+
+    _buffer.push_back(']');
+
+}
+
+void JSONWriter::key(const char* name) {
+
+    separate();
+
+    _buffer.push_back('"');
+    _buffer.append(name);
+    _buffer.append(_compact ? "\":" : "\": ");
+
+    _after_key = true;
+
+}
+
+void JSONWriter::value(float value) {
+
+    separate();
+    writeFloat(value);
+
+}
+
+void JSONWriter::value(double value) {
+
+    separate();
+    writeFloat(value);
+
+}
+
+void JSONWriter::value(int value) {
+
+    this->value((long long)value);
+
+}
+
+void JSONWriter::value(long long value) {
+
+    separate();
+
+    char digits[24];
+    std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+    _buffer.append(digits, result.ptr);
+
+}
+
+void JSONWriter::value(unsigned long long value) {
+
+    separate();
+
+    char digits[24];
+    std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+    _buffer.append(digits, result.ptr);
+
+}
+
+void JSONWriter::value(const std::string& value) {
+
+    separate();
+
+    _buffer.push_back('"');
+
+    for (char c : value) {
+
+        switch (c) {
+
+            case '"':  _buffer.append("\\\""); break;
+            case '\\': _buffer.append("\\\\"); break;
+            case '\n': _buffer.append("\\n"); break;
+            case '\r': _buffer.append("\\r"); break;
+            case '\t': _buffer.append("\\t"); break;
+
+            default:
+
+                // The rest of the control characters need to be written as unicode escapes
+                if ((unsigned char)c < 0x20) {
+
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)c);
+                    _buffer.append(escaped);
+
+                } else
+                    _buffer.push_back(c);
+
+        }
+
+    }
+
+    _buffer.push_back('"');
+
+}
+
+void JSONWriter::raw(const std::string& json) {
+
+    separate();
+    _buffer.append(json);
+
+}
+
+void JSONWriter::value(const std::vector<glm::vec3>& points) {
+
+    beginArray();
+
+    // Keep each point on one line, it is much easier to read than three lines per point
+    bool compact = _compact;
+
+    for (const glm::vec3& point : points) {
+
+        beginArray();
+        _compact = true;
+
+        value(point.x);
+        value(point.y);
+        value(point.z);
+
+        endArray();
+        _compact = compact;
+
+    }
+
+    endArray();
+
+}
+
+void JSONWriter::value(const std::vector<glm::vec2>& points) {
+
+    beginArray();
+
+    bool compact = _compact;
+
+    for (const glm::vec2& point : points) {
+
+        beginArray();
+        _compact = true;
+
+        value(point.x);
+        value(point.y);
+
+        endArray();
+        _compact = compact;
+
+    }
+
+    endArray();
+
+}
+
+const std::string& JSONWriter::str() const {
+
+    return _buffer;
+
+}
+
+std::string JSONWriter::release() {
+
+    return std::move(_buffer);
+
+}
+
+void JSONWriter::separate() {
+
+    // A value that follows a key goes right after it
+    if (_after_key) {
+        _after_key = false;
+        return;
+    }
+
+    // Nothing needs to come before the top level value
+    if (_has_values.empty())
+        return;
+
+    if (_has_values.back())
+        _buffer.push_back(',');
+
+    _has_values.back() = true;
+    newLine();
+
+}
+
+void JSONWriter::newLine() {
+
+    if (_compact)
+        return;
+
+    _buffer.push_back('\n');
+    _buffer.append(_has_values.size() * 4, ' ');
+
+}
+
+template <typename T>
+void JSONWriter::writeFloat(T value) {
+
+    if (!std::isfinite(value)) {
+        _buffer.append("null");
+        return;
+    }
+
+    char digits[32];
+    std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+    _buffer.append(digits, result.ptr);
+
+}
@@ -0,0 +1,183 @@
+//
+//  json.h
+//  Routes
+//
+
+#ifndef ROUTES_JSON_H
+#define ROUTES_JSON_H
+
+#include <glm/glm.hpp>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/**
+ * A single pass writer for JSON. Everything is appended to one buffer, which can be reserved up front, so a
+ * response is built without any temporary strings. Floats are written with std::to_chars which gives the shortest
+ * text that reads back as the exact same float.
+ *
+ * Commas are placed automatically, so writing an array is just a matter of calling beginArray, the values and then
+ * endArray. Keys must be written before every value inside of an object.
+ */
+class JSONWriter {
+
+    public:
+
+        /**
+         * Creates an empty writer.
+         *
+         * @param compact
+         * True if the JSON should be written without any whitespace, false if every value should be on its own
+         * indented line to make it easier for humans to read.
+         *
+         * @param reserve
+         * The number of bytes to reserve in the buffer.
+         */
+        JSONWriter(bool compact = true, size_t reserve = 0);
+
+        /** Starts an object, this needs to be matched with endObject */
+        void beginObject();
+
+        /** Ends the object started with beginObject */
+        void endObject();
+
+        /** Starts an array, this needs to be matched with endArray */
+        void beginArray();
+
+        /** Ends the array started with beginArray */
+        void endArray();
+
+        /**
+         * Writes the key of the next value in an object.
+         *
+         * @param name
+         * The key. This is not escaped so it should only contain plain characters.
+         */
+        void key(const char* name);
+
+        /**
+         * Writes a float. Infinite and NaN values are written as null since JSON can not represent them.
+         *
+         * @param value
+         * The value to write.
+         */
+        void value(float value);
+
+        /**
+         * Writes a double. Infinite and NaN values are written as null since JSON can not represent them.
+         *
+         * @param value
+         * The value to write.
+         */
+        void value(double value);
+
+        /**
+         * Writes an integer.
+         *
+         * @param value
+         * The value to write.
+         */
+        void value(int value);
+
+        /**
+         * Writes an integer.
+         *
+         * @param value
+         * The value to write.
+         */
+        void value(long long value);
+
+        /**
+         * Writes an unsigned integer.
+         *
+         * @param value
+         * The value to write.
+         */
+        void value(unsigned long long value);
+
+        /**
+         * Writes a string, escaping any characters that need to be.
+         *
+         * @param value
+         * The value to write.
+         */
+        void value(const std::string& value);
+
+        /**
+         * Writes a value that is already JSON without escaping it.
+         *
+         * @param json
+         * The JSON to write.
+         */
+        void raw(const std::string& json);
+
+        /**
+         * Writes an array of points where every point is an array of its X, Y and Z.
+         *
+         * @param points
+         * The points to write.
+         */
+        void value(const std::vector<glm::vec3>& points);
+
+        /**
+         * Writes an array of points where every point is an array of its X and Y.
+         *
+         * @param points
+         * The points to write.
+         */
+        void value(const std::vector<glm::vec2>& points);
+
+        /**
+         * Gets everything that has been written.
+         *
+         * @return
+         * The JSON string.
+         */
+        const std::string& str() const;
+
+        /**
+         * Takes the buffer out of the writer without copying it. The writer should not be used afterwards.
+         *
+         * @return
+         * The JSON string.
+         */
+        std::string release();
+
+    private:
+
+        /**
+         * Writes the comma and whitespace that needs to come before the next value or key.
+         */
+        void separate();
+
+        /**
+         * Writes a new line and the indentation for the current depth. Does nothing in compact mode.
+         */
+        void newLine();
+
+        /**
+         * Writes a floating point value.
+         *
+         * @param value
+         * The value to write.
+         */
+        template <typename T>
+        void writeFloat(T value);
+
+        /** The JSON that has been written */
+        std::string _buffer;
+
+        /** For every open object or array, whether it has any values in it yet */
+        std::vector<bool> _has_values;
+
+        /** True if a key was just written so the value should follow it directly */
+        bool _after_key;
+
+        /** True if no whitespace should be written */
+        bool _compact;
+
+};
+
+#endif //ROUTES_JSON_H
@@ -13,44 +13,247 @@ glm::vec3 Spline::evaluateSpline(const std::vector<glm::vec3>& controls, const s
     int n = controls.size() - 1;
     int m = knots.size() - 1;
     int p = m - n - 1;
+
+    std::vector<glm::vec3> d;
     
     // Perform DeBoor's
-    return deBoors(determineK(knots, t), p, p, controls, knots, t);
+    return deBoor(findSpan(knots, p, controls.size(), t), t, p, controls, knots, d);
     
 }
 
-glm::vec3 Spline::deBoors(int i, int r, int p, const std::vector<glm::vec3>& controls, const std::vector<float>& knots, float t) {
-    
-    // d(i,0) is control point at i
-    if (!r)
-        return controls[i];
-    
-    // Perform the unoptimzied De Boor's algorithm becasue on the GPU we dont want to modify the control points
-    float alpha = (t - knots[i]) / (knots[i + p + 1 - r] - knots[i]);
-    return deBoors(i - 1, r - 1, p, controls, knots, t) * (1.0f - alpha) + deBoors(i, r - 1, p, controls, knots, t) * alpha;
-    
+std::vector<glm::vec3> Spline::evaluateSplineBatch(const std::vector<glm::vec3>& controls,
+                                                   const std::vector<float>& knots,
+                                                   const std::vector<float>& ts) {
+
+    int n = controls.size() - 1;
+    int p = knots.size() - controls.size() - 1;
+
+    std::vector<glm::vec3> points = std::vector<glm::vec3>(ts.size());
+    std::vector<glm::vec3> d;
+
+    if (ts.empty())
+        return points;
+
+    int span = findSpan(knots, p, controls.size(), ts[0]);
+
+    for (size_t i = 0; i < ts.size(); i++) {
+
+        float t = ts[i];
+
+        // Walk forward while t is past the span, values in order never need more than a step or two
+        while (span < n && t >= knots[span + 1])
+            span++;
+
+        // Going backwards needs a proper search
+        if (t < knots[span] && span > p)
+            span = findSpan(knots, p, controls.size(), t);
+
+        points[i] = deBoor(span, t, p, controls, knots, d);
+
+    }
+
+    return points;
+
 }
 
-int Spline::determineK(const std::vector<float>& knots, float t) {
-    
-    // Find k, the range that t falls into. Since we are using closed curves we use s to count how many times we have
-    // found a value equal to t. At the end of the curve we need to subtract s so that the final point is the last control
-    // point.
-    int k = 0;
-    int s = 0;
-    
-    // Loop to find the range, k is incremented by the loop
-    for (; k < knots.size(); k++) {
-        
-        if (t == knots[k])
-            s++;
-        else if (t < knots[k])
-            break;
-        
+std::vector<glm::vec3> Spline::evaluateSplineDerivativeBatch(const std::vector<glm::vec3>& controls,
+                                                             const std::vector<float>& knots,
+                                                             const std::vector<float>& ts, int order) {
+
+    std::vector<glm::vec3> derived_controls = controls;
+    std::vector<float> derived_knots = knots;
+
+    for (int i = 0; i < order; i++) {
+
+        // Once the degree is zero the curve is flat pieces which have no derivative
+        if (derived_knots.size() == derived_controls.size() + 1)
+            return std::vector<glm::vec3>(ts.size(), glm::vec3(0.0f));
+
+        differentiate(derived_controls, derived_knots);
+
     }
-    
-    // Eliminate branching with a little trickery
-    return k - 1 - (int)(k != s) * s;
-    
+
+    return evaluateSplineBatch(derived_controls, derived_knots, ts);
+
 }
 
+std::vector<glm::vec3> Spline::evaluateEntireCurve(const std::vector<glm::vec3>& controls, int num_desired, CurveType type) {
+
+    if (type == CurveType::Bezier)
+        return Bezier::evaluateEntireBezierCurve(controls, num_desired);
+
+    std::vector<float> knots = generateClampedKnots(controls.size(), degreeFor(controls.size()));
+    std::vector<float> ts = std::vector<float>(num_desired);
+
+    for (int p = 0; p < num_desired; p++)
+        ts[p] = (float)p / (float)(num_desired - 1);
+
+    return evaluateSplineBatch(controls, knots, ts);
+
+}
+
+CurveType Spline::parseCurveType(const std::string& name) {
+
+    if (name == "bezier")
+        return CurveType::Bezier;
+
+    if (name == "bspline")
+        return CurveType::BSpline;
+
+    throw std::runtime_error("Unknown curve type: " + name);
+
+}
+
+int Spline::degreeFor(int num_controls) {
+
+    return glm::min(SPLINE_DEGREE, num_controls - 1);
+
+}
+
+std::vector<float> Spline::generateClampedKnots(int num_controls, int degree) {
+
+    std::vector<float> knots = std::vector<float>((size_t)num_controls + degree + 1);
+
+    // The first and last degree + 1 knots are repeated so that the curve touches the first and last control points
+    int num_spans = num_controls - degree;
+
+    for (int i = 0; i < knots.size(); i++)
+        knots[i] = (float)glm::clamp(i - degree, 0, num_spans) / (float)num_spans;
+
+    return knots;
+
+}
+
+void Spline::calcSparseBasis(int num_controls, int num_rows, float num_points_1,
+                             std::vector<float>& weights, std::vector<int>& offsets) {
+
+    int degree = degreeFor(num_controls);
+    std::vector<float> knots = generateClampedKnots(num_controls, degree);
+
+    weights = std::vector<float>((size_t)num_rows * (degree + 1));
+    offsets = std::vector<int>((size_t)num_rows);
+
+    std::vector<double> row;
+
+    for (int p = 0; p < num_rows; p++) {
+
+        double t = (double)p / num_points_1;
+        int span = findSpan(knots, degree, num_controls, t);
+
+        calcBasisFunctions(span, t, degree, knots, row);
+
+        for (int i = 0; i <= degree; i++)
+            weights[p * (degree + 1) + i] = (float)row[i];
+
+        offsets[p] = span - degree;
+
+    }
+
+}
+
+int Spline::findSpan(const std::vector<float>& knots, int degree, int num_controls, double t) {
+
+    int n = num_controls - 1;
+
+    // Clamp to the first and last spans that have any length
+    if (t >= knots[n + 1])
+        return n;
+
+    if (t <= knots[degree])
+        return degree;
+
+    int low = degree;
+    int high = n + 1;
+
+    // knots[low] <= t < knots[high] the whole way through
+    while (high - low > 1) {
+
+        int mid = (low + high) / 2;
+
+        if (t < knots[mid])
+            high = mid;
+        else
+            low = mid;
+
+    }
+
+    return low;
+
+}
+
+void Spline::calcBasisFunctions(int span, double t, int degree, const std::vector<float>& knots,
+                                std::vector<double>& out) {
+
+    out.assign((size_t)degree + 1, 0.0);
+
+    std::vector<double> left = std::vector<double>((size_t)degree + 1);
+    std::vector<double> right = std::vector<double>((size_t)degree + 1);
+
+    out[0] = 1.0;
+
+    // Raise the degree one step at a time, each step splits the weights between neighbouring control points
+    for (int j = 1; j <= degree; j++) {
+
+        left[j] = t - knots[span + 1 - j];
+        right[j] = knots[span + j] - t;
+
+        double saved = 0.0;
+
+        for (int r = 0; r < j; r++) {
+
+            double temp = out[r] / (right[r + 1] + left[j - r]);
+            out[r] = saved + right[r + 1] * temp;
+            saved = left[j - r] * temp;
+
+        }
+
+        out[j] = saved;
+
+    }
+
+}
+
+glm::vec3 Spline::deBoor(int span, float t, int degree, const std::vector<glm::vec3>& controls,
+                         const std::vector<float>& knots, std::vector<glm::vec3>& d) {
+
+    // Copy the controls that affect this span
+    d.assign(controls.begin() + (span - degree), controls.begin() + (span + 1));
+
+    // Perform the optimized version of De Boor's algorithm. Taken from https://en.wikipedia.org/wiki/De_Boor%27s_algorithm#Optimizations
+    for (int r = 1; r <= degree; r++) {
+
+        for (int j = degree; j >= r; j--) {
+
+            float denominator = knots[j + 1 + span - r] - knots[j + span - degree];
+
+            // Repeated knots make a span with no length, the point is the control point either way
+            float alpha = denominator == 0.0f ? 0.0f : (t - knots[j + span - degree]) / denominator;
+            d[j] = (1.0f - alpha) * d[j - 1] + alpha * d[j];
+
+        }
+
+    }
+
+    return d[degree];
+
+}
+
+void Spline::differentiate(std::vector<glm::vec3>& controls, std::vector<float>& knots) {
+
+    int degree = knots.size() - controls.size() - 1;
+
+    // Q_i = p * (P_i+1 - P_i) / (u_i+p+1 - u_i+1)
+    for (size_t i = 0; i + 1 < controls.size(); i++) {
+
+        float denominator = knots[i + degree + 1] - knots[i + 1];
+        controls[i] = denominator == 0.0f ? glm::vec3(0.0f) : (float)degree * (controls[i + 1] - controls[i]) / denominator;
+
+    }
+
+    controls.pop_back();
+
+    // The derivative has the same knots without the first and the last
+    knots.erase(knots.begin());
+    knots.pop_back();
+
+}
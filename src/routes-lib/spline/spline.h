@@ -11,8 +11,26 @@
 #include <glm/glm.hpp>
 #include <iostream>
 #include <map>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
+#include "../bezier/bezier.h"
+
+/** The degree of the B-splines that routes are made of. Each point of a route only depends on this many + 1 controls */
+#define SPLINE_DEGREE 3
+
+/** The kinds of curves that a route can be made of */
+enum class CurveType {
+
+    /** A single bezier curve, every control point moves the whole route */
+    Bezier,
+
+    /** A clamped uniform cubic B-spline, every control point only moves the part of the route around it */
+    BSpline
+
+};
+
 /** This class provides the utilities to evaluate a B-spline curve on the CPU */
 class Spline {
     
@@ -32,23 +50,31 @@ class Spline {
          * The parametric parameter of the B-spline curve. Should be in the range [*knots.begin(), *knots.end()].
          */
         static glm::vec3 evaluateSpline(const std::vector<glm::vec3>& controls, const std::vector<float>& knots, float t);
-    
-    private:
-    
+
         /**
-         * Performs De Boor's algorithm recursively to evaluate a B-Spline.
-         * Algorithm can be found at https://en.wikipedia.org/wiki/De_Boor%27s_algorithm
-         * There appears to be different representation of variables depending on what article you are reading. The parameters here match the ones
-         * outlined in the Wikipedia article.
+         * Evaluates the B-Spline curve at many parametric values at once. The span of each value is found by moving
+         * forward from the span of the value before it, so values in ascending order are found in constant time.
+         * Values out of order still work, they are found with a binary search.
          *
-         * @param i
-         * The i value in De Boor's algorithm according to the Wikipedia article.
+         * @param controls
+         * The control points that make up the B-Spline.
          *
-         * @param r
-         * The r value in De Boor's algorithm according to the Wikipedia article.
+         * @param knots
+         * The knot vector.
          *
-         * @param p
-         * The degree of the B-spline.
+         * @param ts
+         * The parametric values to evaluate at.
+         *
+         * @return
+         * The point on the curve at each parametric value.
+         */
+        static std::vector<glm::vec3> evaluateSplineBatch(const std::vector<glm::vec3>& controls,
+                                                          const std::vector<float>& knots,
+                                                          const std::vector<float>& ts);
+
+        /**
+         * Evaluates a derivative of the B-Spline curve at many parametric values at once. The derivative of a B-spline
+         * is another B-spline with one less degree, so this builds that B-spline and evaluates it.
          *
          * @param controls
          * The control points that make up the B-Spline.
@@ -56,21 +82,180 @@ class Spline {
          * @param knots
          * The knot vector.
          *
-         * @param t
-         * The parametric parameter of the B-spline curve. Should be in the range [*knots.begin(), *knots.end()].
+         * @param ts
+         * The parametric values to evaluate at.
+         *
+         * @param order
+         * Which derivative to take, 1 for the tangent and 2 for what is needed for the curvature.
+         *
+         * @return
+         * The derivative at each parametric value. This is all zeros if the order is higher than the degree.
+         */
+        static std::vector<glm::vec3> evaluateSplineDerivativeBatch(const std::vector<glm::vec3>& controls,
+                                                                    const std::vector<float>& knots,
+                                                                    const std::vector<float>& ts, int order = 1);
+
+        /**
+         * Evaluates a route at evenly spaced points from its start to its destination.
+         *
+         * @param controls
+         * The control points of the route, including the start and destination.
+         *
+         * @param num_desired
+         * The number of points to evaluate.
+         *
+         * @param type
+         * The kind of curve the route is made of.
+         *
+         * @return
+         * num_desired points that are on the route.
          */
-        static glm::vec3 deBoors(int i, int r, int p, const std::vector<glm::vec3>& controls, const std::vector<float>& knots, float t);
+        static std::vector<glm::vec3> evaluateEntireCurve(const std::vector<glm::vec3>& controls, int num_desired, CurveType type);
+
+        /**
+         * Gets the curve type with the given name.
+         *
+         * @param name
+         * Either "bezier" or "bspline".
+         *
+         * @return
+         * The curve type. Throws a std::runtime_error if the name is not known.
+         */
+        static CurveType parseCurveType(const std::string& name);
+
+        /**
+         * Gets the degree of the B-spline of a route. This is SPLINE_DEGREE unless there are too few control points,
+         * in which case it is as high as it can be, which makes the B-spline the same as a bezier curve.
+         *
+         * @param num_controls
+         * The number of control points, including the start and destination.
+         *
+         * @return
+         * The degree.
+         */
+        static int degreeFor(int num_controls);
+
+        /**
+         * Generates the knots of a clamped B-spline over [0, 1] with evenly spaced interior knots. A clamped B-spline
+         * starts on its first control point and ends on its last.
+         *
+         * @param num_controls
+         * The number of control points.
+         *
+         * @param degree
+         * The degree of the B-spline.
+         *
+         * @return
+         * num_controls + degree + 1 knots.
+         */
+        static std::vector<float> generateClampedKnots(int num_controls, int degree);
+
+        /**
+         * Calculates the weights of the control points of a clamped uniform B-spline at evenly spaced parametric
+         * values. Only degree + 1 control points have a weight at any value, so each row holds just those along with
+         * the index of the first one.
+         *
+         * @param num_controls
+         * The number of control points.
+         *
+         * @param num_rows
+         * The number of parametric values to calculate the weights at.
+         *
+         * @param num_points_1
+         * The divisor of the parametric values, row p is at t = p / num_points_1.
+         *
+         * @param weights
+         * Filled with num_rows rows of degreeFor(num_controls) + 1 weights.
+         *
+         * @param offsets
+         * Filled with the index of the control point that the first weight of each row belongs to.
+         */
+        static void calcSparseBasis(int num_controls, int num_rows, float num_points_1,
+                                    std::vector<float>& weights, std::vector<int>& offsets);
     
+    private:
+
         /**
-         * This determines which range created by the knots t lies in.
+         * Finds the knot span that t lies in using a binary search. Values past the end of the knots are put in the
+         * last span so that the spline keeps going smoothly.
          *
          * @param knots
          * The knot vector.
          *
+         * @param degree
+         * The degree of the B-spline.
+         *
+         * @param num_controls
+         * The number of control points.
+         *
          * @param t
-         * The parametric parameter of the B-spline curve. Should be in the range [*knots.begin(), *knots.end()].
+         * The parametric parameter.
+         *
+         * @return
+         * The index of the knot that starts the span.
+         */
+        static int findSpan(const std::vector<float>& knots, int degree, int num_controls, double t);
+
+        /**
+         * Calculates the B-spline basis functions that are not zero at t, without any recursion.
+         * Algorithm A2.2 from The NURBS Book.
+         *
+         * @param span
+         * The knot span that t lies in.
+         *
+         * @param t
+         * The parametric parameter.
+         *
+         * @param degree
+         * The degree of the B-spline.
+         *
+         * @param knots
+         * The knot vector.
+         *
+         * @param out
+         * Resized to degree + 1 and set to the weights of the control points span - degree through span.
+         */
+        static void calcBasisFunctions(int span, double t, int degree, const std::vector<float>& knots,
+                                       std::vector<double>& out);
+    
+        /**
+         * Performs De Boor's algorithm without recursion, overwriting a copy of the degree + 1 control points that
+         * affect t. Algorithm can be found at https://en.wikipedia.org/wiki/De_Boor%27s_algorithm#Optimizations
+         *
+         * @param span
+         * The knot span that t lies in.
+         *
+         * @param t
+         * The parametric parameter of the B-spline curve.
+         *
+         * @param degree
+         * The degree of the B-spline.
+         *
+         * @param controls
+         * The control points that make up the B-Spline.
+         *
+         * @param knots
+         * The knot vector.
+         *
+         * @param d
+         * Space for degree + 1 points so that it doesn't need to be allocated for every value.
+         *
+         * @return
+         * The point on the curve.
+         */
+        static glm::vec3 deBoor(int span, float t, int degree, const std::vector<glm::vec3>& controls,
+                                const std::vector<float>& knots, std::vector<glm::vec3>& d);
+
+        /**
+         * Calculates the control points and knots of the derivative of a B-spline.
+         *
+         * @param controls
+         * The control points of the B-spline, these are replaced by the ones of the derivative.
+         *
+         * @param knots
+         * The knot vector of the B-spline, this is replaced by the one of the derivative.
          */
-        static int determineK(const std::vector<float>& knots, float t);
+        static void differentiate(std::vector<glm::vec3>& controls, std::vector<float>& knots);
     
 };
 
@@ -0,0 +1,171 @@
+//
+//  cache.cpp
+//  Routes
+//
+
+#include "cache.h"
+
+ResultCache::ResultCache(int num_shards, size_t memory_budget, std::chrono::seconds ttl) : _ttl(ttl), _hits(0),
+                                                                                          _misses(0), _evictions(0),
+                                                                                          _expirations(0) {
+
+    num_shards = std::max(num_shards, 1);
+
+    for (int i = 0; i < num_shards; i++)
+        _shards.push_back(std::make_unique<_Shard>());
+
+    _shard_budget = memory_budget / num_shards;
+
+}
+
+void ResultCache::insert(size_t id, std::shared_ptr<const RouteResult> result) {
+
+    size_t size = estimateSize(*result);
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+    _Shard& shard = shardFor(id);
+    std::lock_guard<std::mutex> lock(shard.lock);
+
+    // Replace the old route if there was one
+    auto found = shard.index.find(id);
+    if (found != shard.index.end())
+        erase(shard, found->second);
+
+    expire(shard, now);
+
+    // Make room for the new route. It is always kept even if it is bigger than the budget on its own
+    while (!shard.entries.empty() && shard.bytes + size > _shard_budget) {
+
+        erase(shard, std::prev(shard.entries.end()));
+        _evictions++;
+
+    }
+
+    shard.entries.push_front({id, std::move(result), size, now});
+    shard.index[id] = shard.entries.begin();
+    shard.bytes += size;
+
+}
+
+std::shared_ptr<const RouteResult> ResultCache::find(size_t id) {
+
+    _Shard& shard = shardFor(id);
+    std::lock_guard<std::mutex> lock(shard.lock);
+
+    auto found = shard.index.find(id);
+
+    if (found == shard.index.end()) {
+
+        _misses++;
+        return nullptr;
+
+    }
+
+    // Expired routes are treated as if they were never there
+    if (std::chrono::steady_clock::now() - found->second->inserted > _ttl) {
+
+        erase(shard, found->second);
+        _expirations++;
+        _misses++;
+        return nullptr;
+
+    }
+
+    // Move it to the front since it was just used
+    shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+    _hits++;
+
+    return found->second->result;
+
+}
+
+bool ResultCache::contains(size_t id) {
+
+    _Shard& shard = shardFor(id);
+    std::lock_guard<std::mutex> lock(shard.lock);
+
+    auto found = shard.index.find(id);
+
+    // Expired routes are left for find or insert to drop
+    return found != shard.index.end() && std::chrono::steady_clock::now() - found->second->inserted <= _ttl;
+
+}
+
+ResultCache::Metrics ResultCache::getMetrics() {
+
+    Metrics metrics = {_hits.load(), _misses.load(), _evictions.load(), _expirations.load(), 0, 0};
+
+    for (std::unique_ptr<_Shard>& shard : _shards) {
+
+        std::lock_guard<std::mutex> lock(shard->lock);
+        metrics.entries += shard->entries.size();
+        metrics.bytes += shard->bytes;
+
+    }
+
+    return metrics;
+
+}
+
+size_t ResultCache::estimateSize(const RouteResult& result) {
+
+    size_t size = sizeof(RouteResult);
+
+    size += result.controls.capacity() * sizeof(glm::vec3);
+    size += result.evaluated.capacity() * sizeof(glm::vec3);
+    size += result.elevations.capacity() * sizeof(glm::vec2);
+    size += result.ground_elevations.capacity() * sizeof(glm::vec2);
+    size += result.speeds.capacity() * sizeof(glm::vec2);
+    size += result.grades.capacity() * sizeof(glm::vec2);
+
+    size += result.solutions.capacity();
+    size += result.total_fitness.capacity();
+    size += result.track_fitness.capacity();
+    size += result.curve_fitness.capacity();
+    size += result.grade_fitness.capacity();
+    size += result.length_fitness.capacity();
+
+    return size;
+
+}
+
+ResultCache::_Shard& ResultCache::shardFor(size_t id) {
+
+    return *_shards[shardOf(id)];
+
+}
+
+size_t ResultCache::shardOf(size_t id) const {
+
+    // Mix the bits so that ids that only differ in the high bits still spread out over the shards
+    size_t hash = std::hash<size_t>()(id);
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+
+    return hash % _shards.size();
+
+}
+
+void ResultCache::erase(_Shard& shard, std::list<_Entry>::iterator it) {
+
+    shard.bytes -= it->size;
+    shard.index.erase(it->id);
+    shard.entries.erase(it);
+
+}
+
+void ResultCache::expire(_Shard& shard, std::chrono::steady_clock::time_point now) {
+
+    // Only look at the back of the list so that inserting stays cheap. An expired route that was used recently is
+    // further forward and gets dropped by find instead
+    while (!shard.entries.empty() && now - shard.entries.back().inserted > _ttl) {
+
+        erase(shard, std::prev(shard.entries.end()));
+        _expirations++;
+
+    }
+
+}
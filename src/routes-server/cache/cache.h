@@ -0,0 +1,228 @@
+//
+//  cache.h
+//  Routes
+//
+
+#ifndef ROUTES_CACHE_H
+#define ROUTES_CACHE_H
+
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <routes.h>
+
+/**
+ * A bounded store for routes that have finished calculating.
+ *
+ * The cache is split into shards that each have their own lock, so the workers inserting routes and the request
+ * handlers reading them only contend when they touch the same shard. Every shard keeps its entries in least recently
+ * used order and evicts from the back once its share of the memory budget is used up. Entries that are older than
+ * the time to live are dropped from the back of their shard when something is inserted, and any that are still in
+ * the middle of the list are dropped when they are looked up.
+ */
+class ResultCache {
+
+    public:
+
+        /** A snapshot of how the cache has been used */
+        struct Metrics {
+
+            /** The number of lookups that found a route */
+            uint64_t hits;
+
+            /** The number of lookups that did not find a route */
+            uint64_t misses;
+
+            /** The number of routes that were removed to stay inside of the memory budget */
+            uint64_t evictions;
+
+            /** The number of routes that were removed because they outlived the time to live */
+            uint64_t expirations;
+
+            /** The number of routes currently stored */
+            size_t entries;
+
+            /** The approximate number of bytes that the stored routes are using */
+            size_t bytes;
+
+        };
+
+        /**
+         * Creates an empty cache.
+         *
+         * @param num_shards
+         * The number of independently locked shards. At least one shard is always created.
+         *
+         * @param memory_budget
+         * The approximate number of bytes that all of the stored routes may use together.
+         *
+         * @param ttl
+         * How long a route is kept after it was inserted.
+         */
+        ResultCache(int num_shards, size_t memory_budget, std::chrono::seconds ttl);
+
+        /**
+         * Stores a route, replacing any route that was already stored with the same id.
+         *
+         * @param id
+         * The unique id of the route.
+         *
+         * @param result
+         * The calculated route.
+         */
+        void insert(size_t id, std::shared_ptr<const RouteResult> result);
+
+        /**
+         * Looks up a route and marks it as the most recently used in its shard.
+         *
+         * @param id
+         * The unique id of the route.
+         *
+         * @return
+         * The route if it is stored, nullptr otherwise.
+         */
+        std::shared_ptr<const RouteResult> find(size_t id);
+
+        /**
+         * Checks whether a route is stored without counting a hit or a miss or changing the order of the shard, so that
+         * looking before queueing a route does not show up in the metrics.
+         *
+         * @param id
+         * The unique id of the route.
+         *
+         * @return
+         * True if the route is stored and has not expired.
+         */
+        bool contains(size_t id);
+
+        /**
+         * Gets the current metrics of the cache.
+         *
+         * @return
+         * The metrics. The counters are read without stopping the workers so they are only approximately consistent
+         * with each other.
+         */
+        Metrics getMetrics();
+
+        /**
+         * Estimates how much memory a route uses. This counts the capacity of the vectors and strings that the route
+         * holds onto, which is where nearly all of the memory is.
+         *
+         * @param result
+         * The route to estimate.
+         *
+         * @return
+         * The approximate size of the route in bytes.
+         */
+        static size_t estimateSize(const RouteResult& result);
+
+        /**
+         * Gets the index of the shard that a route belongs to.
+         *
+         * @param id
+         * The unique id of the route.
+         *
+         * @return
+         * The index of the shard, less than the number of shards.
+         */
+        size_t shardOf(size_t id) const;
+
+    private:
+
+        /** A single stored route */
+        struct _Entry {
+
+            /** The unique id of the route */
+            size_t id;
+
+            /** The route itself */
+            std::shared_ptr<const RouteResult> result;
+
+            /** The result of estimateSize for the route */
+            size_t size;
+
+            /** When the route was inserted */
+            std::chrono::steady_clock::time_point inserted;
+
+        };
+
+        /** One independently locked part of the cache */
+        struct _Shard {
+
+            /** Guards everything else in the shard */
+            std::mutex lock;
+
+            /** The entries with the most recently used at the front */
+            std::list<_Entry> entries;
+
+            /** Finds an entry in the list from its id */
+            std::unordered_map<size_t, std::list<_Entry>::iterator> index;
+
+            /** The sum of the sizes of the entries */
+            size_t bytes = 0;
+
+        };
+
+        /**
+         * Gets the shard that a route belongs to.
+         *
+         * @param id
+         * The unique id of the route.
+         *
+         * @return
+         * The shard.
+         */
+        _Shard& shardFor(size_t id);
+
+        /**
+         * Removes an entry from a shard. The shard must be locked.
+         *
+         * @param shard
+         * The shard that holds the entry.
+         *
+         * @param it
+         * The entry to remove.
+         */
+        void erase(_Shard& shard, std::list<_Entry>::iterator it);
+
+        /**
+         * Removes the least recently used entries of a shard for as long as they have outlived the time to live. The
+         * shard must be locked.
+         *
+         * @param shard
+         * The shard to clean up.
+         *
+         * @param now
+         * The current time.
+         */
+        void expire(_Shard& shard, std::chrono::steady_clock::time_point now);
+
+        /** The shards. These are pointers since a mutex can not be moved. */
+        std::vector<std::unique_ptr<_Shard>> _shards;
+
+        /** The number of bytes each shard may use */
+        size_t _shard_budget;
+
+        /** How long a route is kept */
+        std::chrono::seconds _ttl;
+
+        /** The number of lookups that found a route */
+        std::atomic<uint64_t> _hits;
+
+        /** The number of lookups that did not find a route */
+        std::atomic<uint64_t> _misses;
+
+        /** The number of routes removed to stay inside the budget */
+        std::atomic<uint64_t> _evictions;
+
+        /** The number of routes removed because they expired */
+        std::atomic<uint64_t> _expirations;
+
+};
+
+#endif //ROUTES_CACHE_H
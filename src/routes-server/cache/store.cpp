@@ -0,0 +1,142 @@
+//
+//  store.cpp
+//  Routes
+//
+
+#include "store.h"
+
+/** Written at the start of every file so that files from an incompatible version are not misread */
+#define STORE_MAGIC 0x31535452
+
+bool ResultStore::save(const std::string& directory, const std::string& key, const RouteResult& result) {
+
+    std::string path = pathFor(directory, key);
+    std::string temp = path + ".tmp";
+
+    {
+
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+
+        uint32_t magic = STORE_MAGIC;
+        out.write((const char*)&magic, sizeof(magic));
+
+        writeVector(out, result.controls);
+        writeVector(out, result.evaluated);
+        out.write((const char*)&result.time, sizeof(result.time));
+        out.write((const char*)&result.length, sizeof(result.length));
+        writeVector(out, result.elevations);
+        writeVector(out, result.ground_elevations);
+        writeVector(out, result.speeds);
+        writeVector(out, result.grades);
+        out.write((const char*)&result.route_id, sizeof(result.route_id));
+        writeString(out, result.solutions);
+        writeString(out, result.total_fitness);
+        writeString(out, result.track_fitness);
+        writeString(out, result.curve_fitness);
+        writeString(out, result.grade_fitness);
+        writeString(out, result.length_fitness);
+
+        if (!out)
+            return false;
+
+    }
+
+    // Only make the route visible once it was completely written
+    std::remove(path.c_str());
+    return std::rename(temp.c_str(), path.c_str()) == 0;
+
+}
+
+std::shared_ptr<RouteResult> ResultStore::load(const std::string& directory, const std::string& key) {
+
+    std::ifstream in(pathFor(directory, key), std::ios::binary);
+    if (!in)
+        return nullptr;
+
+    uint32_t magic = 0;
+    in.read((char*)&magic, sizeof(magic));
+    if (magic != STORE_MAGIC)
+        return nullptr;
+
+    std::shared_ptr<RouteResult> result = std::make_shared<RouteResult>();
+
+    readVector(in, result->controls);
+    readVector(in, result->evaluated);
+    in.read((char*)&result->time, sizeof(result->time));
+    in.read((char*)&result->length, sizeof(result->length));
+    readVector(in, result->elevations);
+    readVector(in, result->ground_elevations);
+    readVector(in, result->speeds);
+    readVector(in, result->grades);
+    in.read((char*)&result->route_id, sizeof(result->route_id));
+    readString(in, result->solutions);
+    readString(in, result->total_fitness);
+    readString(in, result->track_fitness);
+    readString(in, result->curve_fitness);
+    readString(in, result->grade_fitness);
+    readString(in, result->length_fitness);
+
+    // A truncated file is treated as if it was never saved
+    if (!in)
+        return nullptr;
+
+    return result;
+
+}
+
+std::string ResultStore::pathFor(const std::string& directory, const std::string& key) {
+
+    return directory + "/" + key + ".route";
+
+}
+
+template <typename T>
+void ResultStore::writeVector(std::ofstream& out, const std::vector<T>& vec) {
+
+    uint64_t size = vec.size();
+    out.write((const char*)&size, sizeof(size));
+    out.write((const char*)vec.data(), size * sizeof(T));
+
+}
+
+template <typename T>
+void ResultStore::readVector(std::ifstream& in, std::vector<T>& vec) {
+
+    uint64_t size = 0;
+    in.read((char*)&size, sizeof(size));
+
+    // Guard against a corrupt size asking for an enormous allocation
+    if (!in || size > (1 << 24)) {
+        in.setstate(std::ios::failbit);
+        return;
+    }
+
+    vec.resize(size);
+    in.read((char*)vec.data(), size * sizeof(T));
+
+}
+
+void ResultStore::writeString(std::ofstream& out, const std::string& str) {
+
+    uint64_t size = str.size();
+    out.write((const char*)&size, sizeof(size));
+    out.write(str.data(), size);
+
+}
+
+void ResultStore::readString(std::ifstream& in, std::string& str) {
+
+    uint64_t size = 0;
+    in.read((char*)&size, sizeof(size));
+
+    if (!in || size > (1 << 30)) {
+        in.setstate(std::ios::failbit);
+        return;
+    }
+
+    str.resize(size);
+    in.read(&str[0], size);
+
+}
@@ -0,0 +1,121 @@
+//
+//  store.h
+//  Routes
+//
+
+#ifndef ROUTES_STORE_H
+#define ROUTES_STORE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include <routes.h>
+
+/**
+ * Saves completed routes to disk so that a restarted server can serve routes that were calculated before it
+ * restarted. Every route is stored in its own file named after the key of the request that produced it.
+ */
+class ResultStore {
+
+    public:
+
+        /**
+         * Saves a route. The route is written to a temporary file first and then renamed so that a crash
+         * never leaves a partially written route behind.
+         *
+         * @param directory
+         * The directory to save the route into. This must already exist.
+         *
+         * @param key
+         * The key of the request that produced the route. This must be safe to use as a file name.
+         *
+         * @param result
+         * The route to save.
+         *
+         * @return
+         * True if the route was saved, false otherwise.
+         */
+        static bool save(const std::string& directory, const std::string& key, const RouteResult& result);
+
+        /**
+         * Loads a route that was saved with save.
+         *
+         * @param directory
+         * The directory that the route was saved into.
+         *
+         * @param key
+         * The key of the request that produced the route.
+         *
+         * @return
+         * The route, or nullptr if it was never saved or the file could not be read.
+         */
+        static std::shared_ptr<RouteResult> load(const std::string& directory, const std::string& key);
+
+    private:
+
+        /**
+         * Gets the file that a route is stored in.
+         *
+         * @param directory
+         * The directory that routes are saved into.
+         *
+         * @param key
+         * The key of the request that produced the route.
+         *
+         * @return
+         * The path to the file.
+         */
+        static std::string pathFor(const std::string& directory, const std::string& key);
+
+        /**
+         * Writes a vector as its length followed by its raw contents.
+         *
+         * @param out
+         * The stream to write to.
+         *
+         * @param vec
+         * The vector to write.
+         */
+        template <typename T>
+        static void writeVector(std::ofstream& out, const std::vector<T>& vec);
+
+        /**
+         * Reads a vector that was written with writeVector.
+         *
+         * @param in
+         * The stream to read from.
+         *
+         * @param vec
+         * The vector to read into.
+         */
+        template <typename T>
+        static void readVector(std::ifstream& in, std::vector<T>& vec);
+
+        /**
+         * Writes a string as its length followed by its characters.
+         *
+         * @param out
+         * The stream to write to.
+         *
+         * @param str
+         * The string to write.
+         */
+        static void writeString(std::ofstream& out, const std::string& str);
+
+        /**
+         * Reads a string that was written with writeString.
+         *
+         * @param in
+         * The stream to read from.
+         *
+         * @param str
+         * The string to read into.
+         */
+        static void readString(std::ifstream& in, std::string& str);
+
+};
+
+#endif //ROUTES_STORE_H
@@ -4,13 +4,68 @@
 
 #include "queue.h"
 
-boost::lockfree::queue<RoutesQueue::_RouteItem> RoutesQueue::_routes(0);
-std::unordered_map<size_t, RoutesQueue::forJSON> RoutesQueue::_completed;
+std::deque<RoutesQueue::_RouteItem> RoutesQueue::_routes;
+std::mutex RoutesQueue::_routes_lock;
+std::condition_variable RoutesQueue::_routes_available;
+std::vector<std::thread> RoutesQueue::_workers;
+std::unique_ptr<ResultCache> RoutesQueue::_completed;
+std::chrono::seconds RoutesQueue::_ttl;
+std::unordered_map<size_t, RoutesQueue::_StateItem> RoutesQueue::_states;
+std::mutex RoutesQueue::_states_lock;
+size_t RoutesQueue::_node_prefix = 0;
+std::atomic<size_t> RoutesQueue::_next_id(1);
+std::unordered_map<std::string, size_t> RoutesQueue::_requests;
+std::string RoutesQueue::_persist_directory;
 
 size_t RoutesQueue::queueRoute(const glm::vec2& start, const glm::vec2& dest) {
 
-    // Get the current time
-    size_t identifier = time(0);
+    // Identical requests with identical parameters share a key
+    Configure config = Configure();
+    std::string key = requestKey(start, dest, config.getRequestPrecision(), config.hash());
+
+    size_t identifier;
+
+    {
+
+        std::lock_guard<std::mutex> lock(_states_lock);
+        pruneStates();
+
+        // Attach to the existing route if it is still being calculated or can still be retrieved
+        auto found = _requests.find(key);
+        if (found != _requests.end()) {
+
+            RouteStatus status = _states[found->second].state.status;
+
+            if (status == Queued || status == Running)
+                return found->second;
+
+            if (status == Done && _completed->contains(found->second))
+                return found->second;
+
+        }
+
+        // Every call gets its own value from the counter, even if several requests come in at once
+        identifier = _node_prefix | (_next_id++ & 0xFFFFFFFFFFFFULL);
+
+        _states[identifier] = {{Queued, 0.0f}, std::chrono::steady_clock::time_point(), key, nullptr};
+        _requests[key] = identifier;
+
+    }
+
+    // Serve routes that were saved by a previous run straight from the disk
+    if (!_persist_directory.empty()) {
+
+        std::shared_ptr<RouteResult> saved = ResultStore::load(_persist_directory, key);
+
+        if (saved) {
+
+            _completed->insert(identifier, std::move(saved));
+            setRouteState(identifier, Done, 1.0f);
+            return identifier;
+
+        }
+
+    }
 
     // Make a new _RouteItem and add it to the queue
     _RouteItem item;
@@ -20,67 +75,264 @@ size_t RoutesQueue::queueRoute(const glm::vec2& start, const glm::vec2& dest) {
     item.start_lon = start.y;
     item.dest_lat = dest.x;
     item.dest_lon = dest.y;
+    item.key = key;
+
+    {
+
+        std::lock_guard<std::mutex> lock(_routes_lock);
+        _routes.push_back(item);
+
+    }
 
-    _routes.push(item);
+    // Wake up a worker to calculate it
+    _routes_available.notify_one();
 
     return identifier;
 
 }
 
+void RoutesQueue::createCache(int num_shards, size_t memory_budget, std::chrono::seconds ttl) {
 
-void RoutesQueue::calculateRoutes() {
+    _completed = std::make_unique<ResultCache>(num_shards, memory_budget, ttl);
+    _ttl = ttl;
+
+}
+
+void RoutesQueue::setNodeId(int node_id) {
+
+    _node_prefix = ((size_t)node_id & 0xFFFF) << 48;
+
+}
+
+void RoutesQueue::setPersistDirectory(const std::string& directory) {
+
+    _persist_directory = directory;
+
+}
+
+void RoutesQueue::startWorkers(int num_workers) {
+
+    // Always have at least a single worker or nothing would ever get calculated
+    num_workers = std::max(num_workers, 1);
+
+    std::cout << "Starting " << num_workers << " route workers" << std::endl;
+
+    for (int i = 0; i < num_workers; i++)
+        _workers.push_back(std::thread(workerLoop));
+
+}
+
+void RoutesQueue::workerLoop() {
+
+    // Loop infinitely
+    while (true) {
+
+        _RouteItem item;
+
+        {
+
+            // Sleep until there is a route to calculate
+            std::unique_lock<std::mutex> lock(_routes_lock);
+            _routes_available.wait(lock, [] { return !_routes.empty(); });
+
+            item = _routes.front();
+            _routes.pop_front();
 
-    _RouteItem item;
-    while (_routes.pop(item)) {
-
-        try {
-
-            // Calculate the route and insert it into the map
-            // This can be done because the [] operator behaves like it is const for the purposes of thread safety
-            glm::vec2 start = glm::vec2(item.start_lat, item.start_lon);
-            glm::vec2 dest = glm::vec2(item.dest_lat, item.dest_lon);
-            std::vector<glm::vec3> controls = Routes::calculateRoute(start, dest);
-            std::vector<glm::vec3> evaluated = Bezier::evaluateEntireBezierCurve(controls, 2400);
-            float time = Routes::getTime();
-            float length = Routes::getLength();
-            std::vector<glm::vec2> elevations = Routes::getElevations();
-            std::vector<glm::vec2> ground_elevations = Routes::getGElevations();
-            std::vector<glm::vec2> speeds = Routes::getSpeeds();
-            std::vector<glm::vec2> grades = Routes::getGrades();
-            int route_id = Routes::getId();
-            std::string solutions = Routes::getSolutions();
-            std::string totalFitness = Routes::getTotalFitness();
-            std::string trackFitness = Routes::getTrackFitness();
-            std::string curveFitness = Routes::getCurveFitness();
-            std::string gradeFitness = Routes::getGradeFitness();
-            std::string lengthFitness = Routes::getLengthFitness();
-            _completed[item.id] = {controls, evaluated, time, length, elevations,
-                                   ground_elevations, speeds, grades, route_id, solutions,
-                                   totalFitness, trackFitness, curveFitness, gradeFitness, lengthFitness};
-
-        } catch (std::runtime_error e) {
-
-            // Print out that the server had an exception
-            std::cout << "Exception: " << e.what() << std::endl;
-            std::vector<glm::vec3> maxVec3 = {glm::vec3(std::numeric_limits<float>::max())};
-            std::vector<glm::vec2> maxVec2 = {glm::vec2(std::numeric_limits<float>::max())};
-            _completed[item.id] = {maxVec3, maxVec3, 0.0f, 0.0f, maxVec2, maxVec2};
         }
 
+        calculateRoute(item);
+
+    }
+
+}
+
+void RoutesQueue::calculateRoute(const _RouteItem& item) {
+
+    setRouteState(item.id, Running, 0.0f);
+
+    // Keep the progress up to date as the generations complete
+    size_t id = item.id;
+    ProgressCallback progress = [id](const GenerationProgress& generation) {
+        setLatestGeneration(id, generation);
+    };
+
+    try {
+
+        // Calculate the route and insert it into the map
+        glm::vec2 start = glm::vec2(item.start_lat, item.start_lon);
+        glm::vec2 dest = glm::vec2(item.dest_lat, item.dest_lon);
+        std::shared_ptr<const forJSON> result = std::make_shared<const forJSON>(Routes::calculateRoute(start, dest,
+                                                                                                      progress));
+
+        if (!_persist_directory.empty() && !ResultStore::save(_persist_directory, item.key, *result))
+            std::cout << "Could not save route " << item.id << " to " << _persist_directory << std::endl;
+
+        _completed->insert(item.id, std::move(result));
+        setRouteState(item.id, Done, 1.0f);
+
+    } catch (const std::exception& e) {
+
+        // Print out that the server had an exception
+        std::cout << "Exception: " << e.what() << std::endl;
+        failRoute(item.id);
+
+    } catch (...) {
+
+        // Nothing may escape, it would take the worker and the whole server down with it
+        std::cout << "Unknown exception calculating route " << item.id << std::endl;
+        failRoute(item.id);
+
     }
 
 }
 
+void RoutesQueue::failRoute(size_t id) {
+
+    std::vector<glm::vec3> maxVec3 = {glm::vec3(std::numeric_limits<float>::max())};
+    std::vector<glm::vec2> maxVec2 = {glm::vec2(std::numeric_limits<float>::max())};
+
+    std::shared_ptr<forJSON> result = std::make_shared<forJSON>();
+    result->controls = maxVec3;
+    result->evaluated = maxVec3;
+    result->time = 0.0f;
+    result->length = 0.0f;
+    result->elevations = maxVec2;
+    result->ground_elevations = maxVec2;
+    result->route_id = 0;
+
+    _completed->insert(id, std::move(result));
+    setRouteState(id, Failed, 1.0f);
+
+}
+
 
 bool RoutesQueue::isRouteCompleted(size_t id) {
 
-    // Return whether or not the completed map had the route that was asked for
-    return (bool)_completed.count(id);
+    // Return whether or not the cache had the route that was asked for
+    return _completed->contains(id);
+
+}
+
+RoutesQueue::RouteState RoutesQueue::getRouteState(size_t id) {
+
+    std::lock_guard<std::mutex> lock(_states_lock);
+
+    auto found = _states.find(id);
+    if (found == _states.end())
+        return {Unknown, 0.0f};
+
+    return found->second.state;
+
+}
+
+std::shared_ptr<const GenerationProgress> RoutesQueue::getLatestGeneration(size_t id) {
+
+    std::lock_guard<std::mutex> lock(_states_lock);
+
+    auto found = _states.find(id);
+    if (found == _states.end())
+        return nullptr;
+
+    return found->second.latest;
+
+}
+
+std::string RoutesQueue::statusToString(RouteStatus status) {
+
+    switch (status) {
+
+        case Queued:
+            return "queued";
+
+        case Running:
+            return "running";
+
+        case Done:
+            return "done";
+
+        case Failed:
+            return "failed";
+
+        default:
+            return "unknown";
+
+    }
+
+}
+
+void RoutesQueue::setRouteState(size_t id, RouteStatus status, float progress) {
+
+    std::lock_guard<std::mutex> lock(_states_lock);
+
+    _StateItem& item = _states[id];
+    item.state = {status, progress};
+
+    if (status == Done || status == Failed)
+        item.finished = std::chrono::steady_clock::now();
+
+}
+
+void RoutesQueue::setLatestGeneration(size_t id, const GenerationProgress& generation) {
+
+    // Copy the generation before taking the lock
+    std::shared_ptr<const GenerationProgress> latest = std::make_shared<const GenerationProgress>(generation);
+
+    std::lock_guard<std::mutex> lock(_states_lock);
+
+    _StateItem& item = _states[id];
+    item.state = {Running, (float)generation.generation / generation.num_generations};
+    item.latest = std::move(latest);
+
+}
+
+std::string RoutesQueue::requestKey(const glm::vec2& start, const glm::vec2& dest, float precision, uint64_t config_hash) {
+
+    // Don't let a bad precision divide by zero
+    if (precision <= 0.0f)
+        precision = 1e-7f;
+
+    char key[128];
+    snprintf(key, sizeof(key), "%lld_%lld_%lld_%lld_%016llx",
+             (long long)std::llround(start.x / precision), (long long)std::llround(start.y / precision),
+             (long long)std::llround(dest.x / precision), (long long)std::llround(dest.y / precision),
+             (unsigned long long)config_hash);
+
+    return std::string(key);
+
+}
+
+void RoutesQueue::pruneStates() {
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+    for (auto it = _states.begin(); it != _states.end();) {
+
+        RouteStatus status = it->second.state.status;
+
+        if ((status == Done || status == Failed) && now - it->second.finished > _ttl) {
+
+            // Only forget the request if a newer route has not taken it over
+            auto request = _requests.find(it->second.key);
+            if (request != _requests.end() && request->second == it->first)
+                _requests.erase(request);
+
+            it = _states.erase(it);
+
+        } else
+            it++;
+
+    }
+
+}
+
+std::shared_ptr<const RoutesQueue::forJSON> RoutesQueue::getCompletedRoute(size_t id) {
+
+    return _completed->find(id);
 
 }
 
-RoutesQueue::forJSON RoutesQueue::getCompletedRoute(size_t id) {
+ResultCache::Metrics RoutesQueue::getCacheMetrics() {
 
-    return _completed[id];
+    return _completed->getMetrics();
 
-}
\ No newline at end of file
+}
@@ -5,99 +5,76 @@
 #ifndef ROUTES_QUEUE_H
 #define ROUTES_QUEUE_H
 
-#include <boost/lockfree/queue.hpp>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
 #include <glm/glm.hpp>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <unordered_map>
 #include <ctime>
 
 #include <routes.h>
 #include <bezier/bezier.h>
 
+#include "../cache/cache.h"
+#include "../cache/store.h"
+
 /** */
 
 /**
- * This class is responsible for handling calculation of routes. It contains a queue of routes to be calculated.
- * Once the route is calculated it is placed into the completed map until it is retrieved.
+ * This class is responsible for handling calculation of routes. It contains a queue of routes to be calculated
+ * and a pool of workers that calculate them. Workers sleep until a route is queued so there is no polling delay.
+ * Once the route is calculated it is placed into a bounded cache until it expires or is evicted.
  */
 class RoutesQueue {
 
 public:
 
-    struct forJSON {
-
-        /** The control points of the curve*/
-        std::vector<glm::vec3> controls;
-
-        /** The evaluated points of the curve*/
-        std::vector<glm::vec3> evaluated;
-
-        /** The time needed to traverse the route in seconds*/
-        float time;
-
-        /** The length of the track in meters*/
-        float length;
-
-        /** The elevations of the track. The x values are the current distance(m) on
-         * the track and the y values are the elevations(m)
-         */
-        std::vector<glm::vec2> elevations;
-
-        /** The elevations of the ground. The x values are the current distance(m) on
-         * the track and the y values are the elevations(m)
-         */
-        std::vector<glm::vec2> ground_elevations;
-
-        /**
-         * The speed of the pod along the track. The x values are the current distance(m) on the
-         * track and the y values are the speeds(m/s)
-         */
-        std::vector<glm::vec2> speeds;
-
-        /**
-         * The grade of the pod as it moves along the track. The x values are the current distance(m)
-         * on the track and the y value are the grade.
-         */
-        std::vector<glm::vec2> grades;
-
-        /**
-         * The route_id for database querying
-         */
-        int route_id;
-
-        /**
-         * A vector of the best solutions at each generation of the route.
-         */
-        std::string solutions;
-
-        /**
-         * A vector of the total fitness at each generation of the route.
-         */
-        std::string total_fitness;
-
-        /**
-         * A vector of the track fitness at each generation of the route.
-         */
-        std::string track_fitness;
-
-        /**
-         * A vector of the curve fitness at each generation of the route.
-         */
-        std::string curve_fitness;
-
-        /**
-         * A vector of the grade fitness at each generation of the route.
-         */
-        std::string grade_fitness;
-
-        /**
-         * A vector of the length fitness at each generation of the route.
-         */
-        std::string length_fitness;
+    /**
+     * Everything that the server sends back about a calculated route. The result of the calculation is handed off
+     * as is, so no copy is made between the worker and the request handler.
+     */
+    typedef RouteResult forJSON;
+
+    /** Where a route is in its life */
+    enum RouteStatus {
+
+        /** The id was never handed out or the route was forgotten */
+        Unknown,
+
+        /** The route is waiting for a worker */
+        Queued,
+
+        /** A worker is calculating the route */
+        Running,
+
+        /** The route was calculated and can be retrieved */
+        Done,
+
+        /** An exception was encountered calculating the route */
+        Failed
+
+    };
+
+    /** The status of a route along with how far along it is */
+    struct RouteState {
+
+        /** Where the route is in its life */
+        RouteStatus status;
+
+        /** The fraction of the generations that have been completed, from 0 to 1 */
+        float progress;
 
     };
 
     /**
-     * Queues a route to be calculated.
+     * Queues a route to be calculated. If the same route was already requested with the same parameters and it is
+     * still queued, running or completed then the id of that route is returned instead so the route is only
+     * calculated once. Routes saved to disk by a previous run are served without being calculated again.
      *
      * @param start
      * The starting position of the route. X and Y are longitude and latitude respectively.
@@ -106,15 +83,52 @@ public:
      * The ending position of the route. X and Y are longitude and latitude respectively.
      *
      * @return
-     * A unique identifier that can be used to reference this route and check if it is complete.
+     * A unique identifier that can be used to reference this route and check if it is complete. The node id is
+     * in the top 16 bits and a counter that never repeats while the server is running is in the rest.
      */
     static size_t queueRoute(const glm::vec2& start, const glm::vec2& dest);
 
-        /**
-     * A function that will calculate any routes that are in the queue. All routes that are calculated are then
-     * moved to the completed map.
+    /**
+     * Creates the store for completed routes. This needs to be called before any workers are started.
+     *
+     * @param num_shards
+     * The number of independently locked shards of the store.
+     *
+     * @param memory_budget
+     * The approximate number of bytes that completed routes may use before the least recently used are evicted.
+     *
+     * @param ttl
+     * How long a completed route is kept before it expires.
+     */
+    static void createCache(int num_shards, size_t memory_budget, std::chrono::seconds ttl);
+
+    /**
+     * Sets the id of this server. Every route id handed out afterwards starts with it so that the ids of several
+     * servers behind the same frontend never collide.
+     *
+     * @param node_id
+     * The id of this server, only the low 16 bits are used.
+     */
+    static void setNodeId(int node_id);
+
+    /**
+     * Sets the directory that completed routes are saved to. Saved routes are loaded instead of being calculated
+     * again when they are requested, even after the server restarts.
+     *
+     * @param directory
+     * The directory to save routes to, this must already exist. Routes are not saved if this is empty.
+     */
+    static void setPersistDirectory(const std::string& directory);
+
+    /**
+     * Starts the pool of workers that calculate the queued routes. Each worker takes the next route off of the
+     * queue as soon as it is free, so up to num_workers routes are calculated at the same time.
+     * This should only be called once.
+     *
+     * @param num_workers
+     * The number of threads that should calculate routes.
      */
-    static void calculateRoutes();
+    static void startWorkers(int num_workers);
 
     /**
      * Checks if the route has been calculated.
@@ -128,18 +142,60 @@ public:
     static bool isRouteCompleted(size_t id);
 
     /**
-     * Returns the control points of a calculated path. This assumes that isRouteCompleted has been called so the
-     * completed route exists.
+     * Gets the status of a route.
+     *
+     * @param id
+     * The unique id of the route that was given by queueRoute.
+     *
+     * @return
+     * The status and progress of the route. Unknown if the id was never handed out or the route has been forgotten.
+     */
+    static RouteState getRouteState(size_t id);
+
+    /**
+     * Gets the latest generation reported by a route that is being calculated.
+     *
+     * @param id
+     * The unique id of the route that was given by queueRoute.
+     *
+     * @return
+     * The generation, the fitness of its best solution and the control points of that solution, or nullptr if the
+     * route has not completed a generation yet or is unknown.
+     */
+    static std::shared_ptr<const GenerationProgress> getLatestGeneration(size_t id);
+
+    /**
+     * Converts the status of a route to a string to send to the client.
+     *
+     * @param status
+     * The status to convert.
+     *
+     * @return
+     * The name of the status in lower case.
+     */
+    static std::string statusToString(RouteStatus status);
+
+    /**
+     * Returns the calculated path.
      *
      * @param id
      * The unique id of the route that was given by queueRoute.
      *
      * @return
-     * The control points of the calculated route. X and Y of the vectors are longitude and latitude respectively
-     * and Z is the elevation.
+     * The calculated route or nullptr if it is not complete or was evicted. X and Y of the control points are
+     * longitude and latitude respectively and Z is the elevation. The result is shared with the cache rather than
+     * copied out of it.
+     *
+     */
+    static std::shared_ptr<const forJSON> getCompletedRoute(size_t id);
+
+    /**
+     * Gets the hit, miss and eviction counts of the completed routes.
      *
+     * @return
+     * The metrics of the completed route cache.
      */
-    static forJSON getCompletedRoute(size_t id);
+    static ResultCache::Metrics getCacheMetrics();
 
 private:
 
@@ -161,22 +217,141 @@ private:
         /** The end longitude of the route */
         double dest_lon;
 
+        /** The key of the request, see requestKey */
+        std::string key;
+
     };
 
     /**
-     * A queue (FIFO) of routes that need to be calculated.
-     * We use Boost's lockfree queue so that we can read from the calculation thread and write from the
-     * request handler thread.
+     * The loop that every worker runs. It blocks until a route is available, calculates it and then
+     * goes back to waiting.
+     */
+    static void workerLoop();
+
+    /**
+     * Calculates a single route and moves the result into the completed map.
+     *
+     * @param item
+     * The route that should be calculated.
+     */
+    static void calculateRoute(const _RouteItem& item);
+
+    /**
+     * Stores a result full of max values for a route that could not be calculated and marks it as failed.
+     *
+     * @param id
+     * The unique id of the route.
+     */
+    static void failRoute(size_t id);
+
+    /**
+     * Moves a route to a new status.
+     *
+     * @param id
+     * The unique id of the route.
+     *
+     * @param status
+     * The new status of the route.
+     *
+     * @param progress
+     * The fraction of the generations that have been completed.
+     */
+    static void setRouteState(size_t id, RouteStatus status, float progress);
+
+    /**
+     * Records a generation that a route has completed.
+     *
+     * @param id
+     * The unique id of the route.
+     *
+     * @param generation
+     * The generation that was completed.
+     */
+    static void setLatestGeneration(size_t id, const GenerationProgress& generation);
+
+    /**
+     * Makes the key that identical requests share. The positions are rounded so that clicks on the map that are
+     * only a few meters apart are treated as the same route.
+     *
+     * @param start
+     * The starting position of the route.
+     *
+     * @param dest
+     * The ending position of the route.
+     *
+     * @param precision
+     * The precision in degrees that the positions are rounded to.
+     *
+     * @param config_hash
+     * The hash of the parameters that the route will be calculated with.
+     *
+     * @return
+     * The key, this is safe to use as a file name.
+     */
+    static std::string requestKey(const glm::vec2& start, const glm::vec2& dest, float precision, uint64_t config_hash);
+
+    /**
+     * Forgets about the routes that finished longer ago than the cache keeps them. _states_lock must be held.
      */
-    static boost::lockfree::queue<_RouteItem> _routes;
+    static void pruneStates();
+
+    /** A queue (FIFO) of routes that need to be calculated. Guarded by _routes_lock. */
+    static std::deque<_RouteItem> _routes;
+
+    /** Guards _routes */
+    static std::mutex _routes_lock;
+
+    /** Signaled every time a route is queued so that a sleeping worker can pick it up */
+    static std::condition_variable _routes_available;
+
+    /** The threads that calculate routes */
+    static std::vector<std::thread> _workers;
 
     /**
-     * The map of the completed routes.
+     * The cache of the completed routes.
      * The key represents the unique identifier that was returned by the queueRoute function.
-     * The value is the control points of the bezier curve of the route.
-     * Unordered map is used because it fits the thread safety requirements.
+     * The value is the calculated route.
+     * Written by the workers and read by the request handlers, the cache does its own locking.
      */
-    static std::unordered_map<size_t, forJSON> _completed;
+    static std::unique_ptr<ResultCache> _completed;
+
+    /** How long completed routes are kept, finished states are forgotten after the same amount of time */
+    static std::chrono::seconds _ttl;
+
+    /** A state along with when the route finished */
+    struct _StateItem {
+
+        /** The current state */
+        RouteState state;
+
+        /** When the route was done or failed */
+        std::chrono::steady_clock::time_point finished;
+
+        /** The key of the request that created the route */
+        std::string key;
+
+        /** The last generation that was completed, this is replaced rather than modified so readers can keep it */
+        std::shared_ptr<const GenerationProgress> latest;
+
+    };
+
+    /** The state of every route that is queued, running or recently finished. Guarded by _states_lock. */
+    static std::unordered_map<size_t, _StateItem> _states;
+
+    /** Guards _states and _requests */
+    static std::mutex _states_lock;
+
+    /** The id of the latest route for every request key. Guarded by _states_lock. */
+    static std::unordered_map<std::string, size_t> _requests;
+
+    /** The directory that completed routes are saved to, empty if they are not saved */
+    static std::string _persist_directory;
+
+    /** The node id shifted into the top 16 bits of the route ids */
+    static size_t _node_prefix;
+
+    /** The counter part of the next route id */
+    static std::atomic<size_t> _next_id;
 
 };
 
@@ -4,7 +4,8 @@
 
 #include "server.h"
 
-std::thread RoutesServer::calculation_thread;
+std::vector<RoutesServer::_Stream> RoutesServer::_streams;
+std::mutex RoutesServer::_streams_lock;
 
 void RoutesServer::startServer(int port) {
 
@@ -26,6 +27,24 @@ void RoutesServer::startServer(int port) {
     length_resource->set_method_handler("GET", handleMaxRoute);
     length_resource->set_method_handler("OPTIONS", handleCORS);
 
+    // Make the resource for checking on a route
+    auto status_resource = std::make_shared<restbed::Resource>();
+    status_resource->set_path("/status");
+    status_resource->set_method_handler("GET", handleStatus);
+    status_resource->set_method_handler("OPTIONS", handleCORS);
+
+    // Make the resource for streaming the progress of a route
+    auto stream_resource = std::make_shared<restbed::Resource>();
+    stream_resource->set_path("/stream");
+    stream_resource->set_method_handler("GET", handleStream);
+    stream_resource->set_method_handler("OPTIONS", handleCORS);
+
+    // Make the resource for the completed route cache metrics
+    auto cache_resource = std::make_shared<restbed::Resource>();
+    cache_resource->set_path("/cache-stats");
+    cache_resource->set_method_handler("GET", handleCacheStats);
+    cache_resource->set_method_handler("OPTIONS", handleCORS);
+
     // Make the settings to start up the server
     auto settings = std::make_shared<restbed::Settings>();
     settings->set_port(port);
@@ -36,11 +55,20 @@ void RoutesServer::startServer(int port) {
     service->publish(compute_resource);
     service->publish(retrieve_resource);
     service->publish(length_resource);
+    service->publish(status_resource);
+    service->publish(stream_resource);
+    service->publish(cache_resource);
     service->set_ready_handler(onServerReady);
 
-    // Start the server
+    // Push the progress of the routes to the open streams
+    service->schedule(pushStreams, std::chrono::milliseconds(STREAM_INTERVAL));
+
+    // Start the server, this returns once the service is stopped
     service->start(settings);
 
+    // Write out the last of the history and join the writer
+    GenerationLogger::stop();
+
 }
 
 void RoutesServer::handleCORS(const std::shared_ptr<restbed::Session>& session) {
@@ -76,52 +104,36 @@ void RoutesServer::handleRetrieval(const std::shared_ptr<restbed::Session>& sess
 
     auto request = session->get_request();
 
-    // Parse the arguments
-    size_t id = request->get_query_parameter("id", 0);
-
-    // Check that the route is finished
-    if (RoutesQueue::isRouteCompleted(id)) {
+    // Parse the arguments, the id is read as a string since it does not fit in an int
+    size_t id = std::strtoull(request->get_query_parameter("id", "0").c_str(), nullptr, 10);
 
-        // Get the control points
-        RoutesQueue::forJSON ans = RoutesQueue::getCompletedRoute(id);
+    // Get the route, this is null if the route is not finished
+    std::shared_ptr<const RoutesQueue::forJSON> ans = RoutesQueue::getCompletedRoute(id);
 
-        std::vector<glm::vec3> controls = ans.controls;
-        float time = ans.time;
+    // Check that the route is finished
+    if (ans) {
 
         // Check if there was an exception
-        if (controls[0].x == std::numeric_limits<float>::max()) {
+        if (ans->controls[0].x == std::numeric_limits<float>::max()) {
 
             // Send some error text
             sendResponse(session, "An error was encountered calculating the route");
 
         } else {
 
-            // Evaluate it
-            std::vector<glm::vec3> evaluated = ans.evaluated;
+            // Clients that can read typed arrays ask for the binary version
+            if (request->get_header("Accept", "").find(BINARY_CONTENT_TYPE) != std::string::npos) {
 
-            std::string timeJSON = std::to_string(time);
+                sendResponse(session, BinaryWriter::routeToBinary(*ans));
 
-            std::string distanceJSON = std::to_string(ans.length);
+            } else {
 
-            // Convert to a  JSON string
-            std::string JSON = "{\"controls\":\n" + vector3ToJSON(controls) +
-                    + ", \n\"evaluated\":\n" + vector3ToJSON(evaluated) +
-                    + ", \n\"timeForCurve\":\n    " + timeJSON +
-                    + ", \n\"distance\":\n    " + distanceJSON +
-                    + ", \n\"elevations\":\n" + vector2ToJSON(ans.elevations) +
-                    + ", \n\"groundElevations\":\n" + vector2ToJSON(ans.ground_elevations) +
-                    + ", \n\"speeds\":\n" + vector2ToJSON(ans.speeds) +
-                    + ", \n\"grades\":\n" + vector2ToJSON(ans.grades) +
-                    + ", \n\"route_id\":\n" + std::to_string(ans.route_id) +
-                    + ", \n\"solutions\":\n" + ans.solutions +
-                    + ", \n\"totalFitness\":\n" + ans.total_fitness +
-                    + ", \n\"trackFitness\":\n" + ans.track_fitness +
-                    + ", \n\"curveFitness\":\n" + ans.curve_fitness +
-                    + ", \n\"gradeFitness\":\n" + ans.grade_fitness +
-                    + ", \n\"lengthFitness\":\n" + ans.length_fitness +"}";
+                // Indented unless the client asks for the smaller compact version
+                bool compact = request->get_query_parameter("compact", "0") == "1";
 
+                sendResponse(session, routeToJSON(*ans, compact));
 
-            sendResponse(session, JSON);
+            }
 
         }
 
@@ -142,77 +154,229 @@ void RoutesServer::handleMaxRoute(const std::shared_ptr <restbed::Session>& sess
     
 }
 
-void RoutesServer::onServerReady(restbed::Service &service) {
+void RoutesServer::handleStatus(const std::shared_ptr<restbed::Session>& session) {
 
-    fprintf( stderr, "Rest server for route calculation is running.\n");
+    auto request = session->get_request();
 
-    // Add a new thread so that the server doesnt get locked
-    calculation_thread = std::thread([] {
+    // Parse the arguments
+    size_t id = std::strtoull(request->get_query_parameter("id", "0").c_str(), nullptr, 10);
 
-        // Loop infinitely
-        while (true) {
+    RoutesQueue::RouteState state = RoutesQueue::getRouteState(id);
 
-            // Sleep for a single second and then try to calculate some new routes
-            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-            RoutesQueue::calculateRoutes();
-        }
+    std::string JSON = "{\"status\": \"" + RoutesQueue::statusToString(state.status) + "\"" +
+                       ", \"progress\": " + std::to_string(state.progress) + "}";
 
-    });
+    sendResponse(session, JSON);
 
 }
 
-void RoutesServer::sendResponse(const std::shared_ptr<restbed::Session>& session, const std::string& message) {
+void RoutesServer::handleStream(const std::shared_ptr<restbed::Session>& session) {
 
-    session->close(restbed::OK, message.c_str(),
-                   {{"Access-Control-Allow-Origin",  "*"},
-                    {"Content-Length", std::to_string(message.length())},
-                    {"Connection", "close"}});
-    
-}
+    auto request = session->get_request();
 
-std::string RoutesServer::vector3ToJSON(const std::vector<glm::vec3> points) {
-    
-    std::string JSON = "   [";
-    
-    for (int i = 0; i < points.size(); i++) {
-        
-        // Add an indent to make it a little easier for humans to read
-        if (i)
-            JSON += "    ";
-        
-        JSON += "[" + std::to_string(points[i].x) + ", " +
-        std::to_string(points[i].y) + ", " +
-        std::to_string(points[i].z) + "]";
-        
-        // Make sure there aren't trailing commas
-        if (i != points.size() - 1)
-            JSON += ", \n";
-        
+    // Parse the arguments, the id is read as a string since it does not fit in an int
+    size_t id = std::strtoull(request->get_query_parameter("id", "0").c_str(), nullptr, 10);
+
+    // There is nothing to stream for a route that doesn't exist
+    if (RoutesQueue::getRouteState(id).status == RoutesQueue::Unknown) {
+        sendResponse(session, "false");
+        return;
     }
-    
-    return JSON + "]";
-    
+
+    // Send the headers and keep the connection open, the events are sent by pushStreams
+    session->yield(restbed::OK, {{"Access-Control-Allow-Origin", "*"},
+                                 {"Content-Type", "text/event-stream"},
+                                 {"Cache-Control", "no-cache"},
+                                 {"Connection", "keep-alive"}},
+                   [id](const std::shared_ptr<restbed::Session> session) {
+
+                       std::lock_guard<std::mutex> lock(_streams_lock);
+                       _streams.push_back({session, id, 0, std::chrono::steady_clock::now()});
+
+                   });
+
 }
 
-std::string RoutesServer::vector2ToJSON(const std::vector<glm::vec2> points) {
+void RoutesServer::pushStreams() {
+
+    std::lock_guard<std::mutex> lock(_streams_lock);
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+    for (auto it = _streams.begin(); it != _streams.end();) {
+
+        _Stream& stream = *it;
 
-    std::string JSON = "   [";
+        // The client went away
+        if (stream.session->is_closed()) {
+            it = _streams.erase(it);
+            continue;
+        }
+
+        // Get the state first so that the last generation is always sent before the route is reported as done
+        RoutesQueue::RouteState state = RoutesQueue::getRouteState(stream.id);
+        std::shared_ptr<const GenerationProgress> latest = RoutesQueue::getLatestGeneration(stream.id);
 
-    for (int i = 0; i < points.size(); i++) {
+        if (latest && latest->generation != stream.last_generation) {
 
-        // Add an indent to make it a little easier for humans to read
-        if (i)
-            JSON += "    ";
+            stream.session->yield("event: generation\ndata: " + generationToJSON(*latest) + "\n\n");
+            stream.last_generation = latest->generation;
+            stream.last_sent = now;
 
-        JSON += "[" + std::to_string(points[i].x) + ", " +
-                std::to_string(points[i].y) + "]";
+        }
 
-        // Make sure there aren't trailing commas
-        if (i != points.size() - 1)
-            JSON += ", \n";
+        // Tell the client that it can retrieve the route now and end the stream
+        if (state.status == RoutesQueue::Done || state.status == RoutesQueue::Failed ||
+            state.status == RoutesQueue::Unknown) {
+
+            // The status line and headers already went out with the yield, so only the body is sent here
+            stream.session->close("event: " + RoutesQueue::statusToString(state.status) +
+                                  "\ndata: " + std::to_string(stream.id) + "\n\n");
+            it = _streams.erase(it);
+            continue;
+
+        }
+
+        // Comments are ignored by the client but stop proxies from dropping the idle connection
+        if (now - stream.last_sent > std::chrono::seconds(STREAM_KEEP_ALIVE)) {
+
+            stream.session->yield(": keep-alive\n\n");
+            stream.last_sent = now;
+
+        }
+
+        it++;
 
     }
 
-    return JSON + "]";
+}
+
+std::string RoutesServer::generationToJSON(const GenerationProgress& generation) {
+
+    // This has to be compact, a new line would end the data of the event
+    JSONWriter writer = JSONWriter(true, generation.controls.size() * 40 + 256);
+
+    writer.beginObject();
+    writer.key("generation");
+    writer.value(generation.generation);
+    writer.key("numGenerations");
+    writer.value(generation.num_generations);
+    writer.key("totalFitness");
+    writer.value(generation.total_fitness);
+    writer.key("trackFitness");
+    writer.value(generation.fitness.x);
+    writer.key("curveFitness");
+    writer.value(generation.fitness.y);
+    writer.key("gradeFitness");
+    writer.value(generation.fitness.z);
+    writer.key("lengthFitness");
+    writer.value(generation.fitness.w);
+    writer.key("controls");
+    writer.value(generation.controls);
+    writer.endObject();
+
+    return writer.release();
+
+}
+
+void RoutesServer::handleCacheStats(const std::shared_ptr<restbed::Session>& session) {
+
+    ResultCache::Metrics metrics = RoutesQueue::getCacheMetrics();
+
+    std::string JSON = "{\"hits\": " + std::to_string(metrics.hits) +
+                       ", \"misses\": " + std::to_string(metrics.misses) +
+                       ", \"evictions\": " + std::to_string(metrics.evictions) +
+                       ", \"expirations\": " + std::to_string(metrics.expirations) +
+                       ", \"entries\": " + std::to_string(metrics.entries) +
+                       ", \"bytes\": " + std::to_string(metrics.bytes) + "}";
+
+    sendResponse(session, JSON);
+
+}
+
+void RoutesServer::onServerReady(restbed::Service &service) {
+
+    fprintf( stderr, "Rest server for route calculation is running.\n");
+
+    // Start the workers on their own threads so that the server doesnt get locked
+    Configure config = Configure();
+    RoutesQueue::createCache(config.getCacheShards(), (size_t)config.getCacheMemoryMB() * 1024 * 1024,
+                             std::chrono::seconds(config.getCacheTTL()));
+    RoutesQueue::setNodeId(config.getNodeId());
+    RoutesQueue::setPersistDirectory(config.getPersistDirectory());
+    RoutesQueue::startWorkers(config.getNumServerWorkers());
+
+}
+
+void RoutesServer::sendResponse(const std::shared_ptr<restbed::Session>& session, const std::string& message) {
+
+    // Routes are sent as JSON or binary depending on Accept, so shared caches have to keep them apart
+    session->close(restbed::OK, message.c_str(),
+                   {{"Access-Control-Allow-Origin",  "*"},
+                    {"Vary", "Accept"},
+                    {"Content-Length", std::to_string(message.length())},
+                    {"Connection", "close"}});
+    
+}
+
+void RoutesServer::sendResponse(const std::shared_ptr<restbed::Session>& session, const std::vector<uint8_t>& message) {
+
+    // restbed::Bytes is a vector of uint8_t so this is sent without a copy
+    session->close(restbed::OK, message,
+                   {{"Access-Control-Allow-Origin",  "*"},
+                    {"Vary", "Accept"},
+                    {"Content-Type", BINARY_CONTENT_TYPE},
+                    {"Content-Length", std::to_string(message.size())},
+                    {"Connection", "close"}});
+
+}
+
+std::string RoutesServer::routeToJSON(const RoutesQueue::forJSON& route, bool compact) {
+
+    // Reserve enough for every point so the buffer never needs to grow
+    size_t num_points = route.controls.size() + route.evaluated.size() + route.elevations.size() +
+                        route.ground_elevations.size() + route.speeds.size() + route.grades.size();
+    size_t num_characters = route.solutions.size() + route.total_fitness.size() + route.track_fitness.size() +
+                            route.curve_fitness.size() + route.grade_fitness.size() + route.length_fitness.size();
+
+    JSONWriter writer = JSONWriter(compact, num_points * (compact ? 40 : 52) + num_characters + 512);
+
+    writer.beginObject();
+
+    writer.key("controls");
+    writer.value(route.controls);
+    writer.key("evaluated");
+    writer.value(route.evaluated);
+    writer.key("timeForCurve");
+    writer.value(route.time);
+    writer.key("distance");
+    writer.value(route.length);
+    writer.key("elevations");
+    writer.value(route.elevations);
+    writer.key("groundElevations");
+    writer.value(route.ground_elevations);
+    writer.key("speeds");
+    writer.value(route.speeds);
+    writer.key("grades");
+    writer.value(route.grades);
+    writer.key("route_id");
+    writer.value(route.route_id);
+
+    // These are already JSON arrays that came out of the database
+    writer.key("solutions");
+    writer.raw(route.solutions);
+    writer.key("totalFitness");
+    writer.raw(route.total_fitness);
+    writer.key("trackFitness");
+    writer.raw(route.track_fitness);
+    writer.key("curveFitness");
+    writer.raw(route.curve_fitness);
+    writer.key("gradeFitness");
+    writer.raw(route.grade_fitness);
+    writer.key("lengthFitness");
+    writer.raw(route.length_fitness);
+
+    writer.endObject();
+
+    return writer.release();
 
 }
@@ -5,15 +5,29 @@
 #ifndef ROUTES_SERVER_H
 #define ROUTES_SERVER_H
 
+#include <chrono>
 #include <map>
+#include <mutex>
 #include <thread>
 #include <memory>
 #include <functional>
 
 #include <restbed>
 
+#include <serialize/binary.h>
+#include <serialize/json.h>
+
 #include "../queue/queue.h"
 
+/** The content type of the binary version of a route, this is also what the client puts in its Accept header */
+#define BINARY_CONTENT_TYPE "application/octet-stream"
+
+/** How often in milliseconds the open progress streams are sent the latest generation of their route */
+#define STREAM_INTERVAL 250
+
+/** How long in seconds a progress stream can go without sending anything before a keep-alive is sent */
+#define STREAM_KEEP_ALIVE 15
+
 /**
  * This class sets up a HTTP (not HTTPS!) REST server for computing routes.
  *
@@ -23,13 +37,24 @@
  * later to get the finished route.
  *
  * GET server_addr/retrieve?id=unique where unique is the identifier returned by compute/ This will either return
- * the computed route's control points or false
+ * the computed route's control points or false. Add compact=0 to get the JSON indented. If the Accept header contains
+ * application/octet-stream the route is sent in the binary layout described in BinaryWriter::routeToBinary instead.
  *
  * GET server_addr/max-route-length
  * Returns the theretical max length of a route that can be computed with this compute device. Response is in meters.
  *
  * GET server_addr/route-time
  * Returns the time needed to traverse the computed route in seconds;
+ *
+ * GET server_addr/status?id=unique where unique is the identifier returned by compute. Returns JSON with the status
+ * of the route (queued, running, done, failed or unknown) and the fraction of the generations that are complete.
+ *
+ * GET server_addr/stream?id=unique where unique is the identifier returned by compute. Opens a server sent event
+ * stream that sends the fitness and control points of the best solution as the generations complete, followed by a
+ * done or failed event once the route can be retrieved.
+ *
+ * GET server_addr/cache-stats
+ * Returns JSON with the hits, misses, evictions and memory usage of the completed route cache.
  */
 class RoutesServer {
 
@@ -86,33 +111,76 @@ class RoutesServer {
         static void handleMaxRoute(const std::shared_ptr<restbed::Session>& session);
 
         /**
-         * Since the restbed server is blocking, this is called by the server to give a thread that can continue
-         * to do things when the server is running. This should never be called by anything but restbed.
+         * This function handles the GET request for the status of a route. This function shouldn't be called from
+         * anywhere, restbed calls it.
+         *
+         * @param session
+         * The session input from restbed.
          *
-         * @param service
-         * The restbed service.
          */
-        static void onServerReady(restbed::Service &service);
+        static void handleStatus(const std::shared_ptr<restbed::Session>& session);
 
         /**
-         * Converts a vector of glm::vec3's to a JSON string.
+         * This function handles the GET request for a progress stream. The response headers are sent right away
+         * and the session is kept open so that pushStreams can send the events. This function shouldn't be called
+         * from anywhere, restbed calls it.
          *
-         * @param points
-         * The vector of points to be converted to JSON
+         * @param session
+         * The session input from restbed.
          *
          */
-        static std::string vector3ToJSON(const std::vector<glm::vec3> points);
+        static void handleStream(const std::shared_ptr<restbed::Session>& session);
 
         /**
-         * Converts a vector of glm::vec2's to a JSON string.
+         * Sends every open progress stream the latest generation of its route if it changed, closes the streams of
+         * routes that finished and keeps idle streams alive. restbed calls this every STREAM_INTERVAL milliseconds
+         * on its own thread. Generations that complete between two calls are skipped, only the latest is sent.
+         */
+        static void pushStreams();
+
+        /**
+         * Converts a generation to a single line of JSON so it can be sent as the data of an event.
          *
-         * @param points
-         * The vector of points to be converted to JSON
+         * @param generation
+         * The generation to be converted.
          *
+         * @return
+         * The JSON string.
          */
-        static std::string vector2ToJSON(const std::vector<glm::vec2> points);
+        static std::string generationToJSON(const GenerationProgress& generation);
 
+        /**
+         * This function handles the GET request for the metrics of the completed route cache. This function
+         * shouldn't be called from anywhere, restbed calls it.
+         *
+         * @param session
+         * The session input from restbed.
+         *
+         */
+        static void handleCacheStats(const std::shared_ptr<restbed::Session>& session);
 
+        /**
+         * Since the restbed server is blocking, this is called by the server once it is running so that the
+         * route workers can be started. This should never be called by anything but restbed.
+         *
+         * @param service
+         * The restbed service.
+         */
+        static void onServerReady(restbed::Service &service);
+
+        /**
+         * Converts a calculated route to the JSON that is sent back by retrieve.
+         *
+         * @param route
+         * The route to be converted.
+         *
+         * @param compact
+         * True if the JSON should not have any whitespace, false if it should be indented for humans to read.
+         *
+         * @return
+         * The JSON string.
+         */
+        static std::string routeToJSON(const RoutesQueue::forJSON& route, bool compact);
 
         /**
          * This is a simple method to make sure that every outgoing response is CORS complient by addind in the required headers.
@@ -126,8 +194,40 @@ class RoutesServer {
          */
         static void sendResponse(const std::shared_ptr<restbed::Session>& session, const std::string& message);
 
-        /** A thread to perform route calculation on. */
-        static std::thread calculation_thread;
+        /**
+         * Sends a binary response with the same CORS headers as the text responses.
+         *
+         * @param session
+         * The session input from restbed.
+         *
+         * @param message
+         * The bytes to be sent to the client
+         *
+         */
+        static void sendResponse(const std::shared_ptr<restbed::Session>& session, const std::vector<uint8_t>& message);
+
+        /** An open progress stream */
+        struct _Stream {
+
+            /** The session that the events are sent on */
+            std::shared_ptr<restbed::Session> session;
+
+            /** The unique id of the route being streamed */
+            size_t id;
+
+            /** The last generation that was sent */
+            int last_generation;
+
+            /** When anything was last sent */
+            std::chrono::steady_clock::time_point last_sent;
+
+        };
+
+        /** The open progress streams. Guarded by _streams_lock. */
+        static std::vector<_Stream> _streams;
+
+        /** Guards _streams */
+        static std::mutex _streams_lock;
 
 };
 
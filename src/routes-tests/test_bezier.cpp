@@ -54,6 +54,68 @@ BOOST_AUTO_TEST_CASE(test_bezier_binom) {
     
 }
 
+BOOST_AUTO_TEST_CASE(test_bezier_high_degree) {
+
+    // These used to overflow an int and take exponential time
+    BOOST_CHECK_EQUAL(Bezier::calcBinomialCoefficient(40, 20), 137846528820.0);
+    BOOST_CHECK_CLOSE(Bezier::calcBinomialCoefficient(100, 50), 1.0089134454556418e29, 1e-9);
+
+    // A long route has a curve with a degree well past where that happened. If every control is the same point
+    // then the whole curve is that point, which only works out if the weights are right
+    glm::vec3 point = glm::vec3(-122.4f, 37.7f, 150.0f);
+    std::vector<glm::vec3> controls = std::vector<glm::vec3>(120, point);
+
+    std::vector<glm::vec3> evaluated = Bezier::evaluateEntireBezierCurve(controls, 101);
+
+    for (const glm::vec3& p : evaluated) {
+        VEC_CLOSE_EQUAL(p, point, 1e-3)
+    }
+
+    // A straight line with evenly spaced controls is evaluated at constant speed
+    std::vector<glm::vec3> line;
+
+    for (int i = 0; i < 120; i++)
+        line.push_back(glm::vec3(i, 2 * i, 0.0f));
+
+    glm::vec3 middle = Bezier::evaluateBezierCurve(line, 0.25f);
+    BOOST_CHECK_CLOSE(middle.x, 119 * 0.25f, 1e-3);
+    BOOST_CHECK_CLOSE(middle.y, 238 * 0.25f, 1e-3);
+
+}
+
+BOOST_AUTO_TEST_CASE(test_bezier_basis) {
+
+    std::vector<glm::vec3> controls = {glm::vec3(0.0, 0.0, 0.0), glm::vec3(0.4, 2.1, 0.2),
+                                       glm::vec3(2.0, -1.0, 3.0), glm::vec3(1.0, 1.0, 1.0)};
+
+    // One extra row past the end, like the cost kernel uses
+    std::vector<float> basis = Bezier::calcBernsteinBasis(3, 6, 4.0f);
+    BOOST_CHECK_EQUAL(basis.size(), 24);
+
+    for (int p = 0; p < 6; p++) {
+
+        // The weighted sum of the controls should be the same as evaluating the curve
+        glm::vec3 point = glm::vec3(0.0, 0.0, 0.0);
+        float sum = 0.0f;
+
+        for (int i = 0; i < 4; i++) {
+            point += controls[i] * basis[p * 4 + i];
+            sum += basis[p * 4 + i];
+        }
+
+        glm::vec3 expected = Bezier::evaluateBezierCurve(controls, p / 4.0f);
+
+        BOOST_CHECK_SMALL(point.x - expected.x, 1e-4f);
+        BOOST_CHECK_SMALL(point.y - expected.y, 1e-4f);
+        BOOST_CHECK_SMALL(point.z - expected.z, 1e-4f);
+
+        // The basis polynomials always add up to one
+        BOOST_CHECK_CLOSE(sum, 1.0f, 1e-3);
+
+    }
+
+}
+
 BOOST_AUTO_TEST_CASE(test_bezier_GPU) {
     
     const boost::compute::context& ctx = Kernel::getContext();
@@ -102,7 +164,9 @@ BOOST_AUTO_TEST_CASE(test_bezier_GPU) {
     boost::compute::vector<glm::vec4> buffer = boost::compute::vector<glm::vec4>(1, ctx);
     std::vector<glm::vec4> buffer_CPU = std::vector<glm::vec4>(1);
     
-    std::vector<int> coeff_CPU = Bezier::getBinomialCoefficients(2);
+    // The kernel takes integers, which are exact for a degree this small
+    const std::vector<double>& binoms = Bezier::getBinomialCoefficients(2);
+    std::vector<int> coeff_CPU = std::vector<int>(binoms.begin(), binoms.end());
     boost::compute::vector<int> coeff = boost::compute::vector<int>(coeff_CPU.size(), ctx);
     
     boost::compute::copy(coeff_CPU.begin(), coeff_CPU.end(), coeff.begin(), queue);
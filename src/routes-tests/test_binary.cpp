@@ -0,0 +1,145 @@
+//
+//  test_binary.cpp
+//  Routes
+//
+
+#include <boost/test/unit_test.hpp>
+#include <routes.h>
+#include <serialize/binary.h>
+
+BOOST_AUTO_TEST_CASE(test_binary_little_endian) {
+
+    BinaryWriter writer = BinaryWriter();
+
+    writer.writeUInt32(0x31425452);
+    writer.writeInt32(-2);
+    writer.writeFloat(1.0f);
+
+    std::vector<uint8_t> expected = {'R', 'T', 'B', '1',
+                                     0xFE, 0xFF, 0xFF, 0xFF,
+                                     0x00, 0x00, 0x80, 0x3F};
+
+    BOOST_CHECK(writer.bytes() == expected);
+
+}
+
+BOOST_AUTO_TEST_CASE(test_binary_points) {
+
+    std::vector<glm::vec3> points3 = {{1, 2, 3}, {4, 5, 6}};
+    std::vector<glm::vec2> points2 = {{-1.5f, 2.5f}};
+
+    BinaryWriter writer = BinaryWriter();
+    writer.writePoints(points3);
+    writer.writePoints(points2);
+    writer.writeBytes("[[]]");
+
+    const std::vector<uint8_t>& bytes = writer.bytes();
+    BOOST_REQUIRE_EQUAL(bytes.size(), 8 * sizeof(float) + 4);
+
+    // Read the floats back the way a Float32Array would
+    float expected[] = {1, 2, 3, 4, 5, 6, -1.5f, 2.5f};
+
+    for (int i = 0; i < 8; i++) {
+
+        uint32_t bits = bytes[i * 4] | (bytes[i * 4 + 1] << 8) | (bytes[i * 4 + 2] << 16) |
+                        ((uint32_t)bytes[i * 4 + 3] << 24);
+
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+
+        BOOST_CHECK_EQUAL(value, expected[i]);
+
+    }
+
+    BOOST_CHECK_EQUAL(std::string(bytes.end() - 4, bytes.end()), "[[]]");
+
+}
+
+/** Reads the little endian word at offset and moves offset past it */
+static uint32_t readWord(const std::vector<uint8_t>& bytes, size_t& offset) {
+
+    uint32_t word = bytes[offset] | (bytes[offset + 1] << 8) | (bytes[offset + 2] << 16) |
+                    ((uint32_t)bytes[offset + 3] << 24);
+    offset += 4;
+
+    return word;
+
+}
+
+static float readFloat(const std::vector<uint8_t>& bytes, size_t& offset) {
+
+    uint32_t bits = readWord(bytes, offset);
+
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+
+    return value;
+
+}
+
+BOOST_AUTO_TEST_CASE(test_binary_route) {
+
+    RouteResult route;
+    route.controls = {{1, 2, 3}, {4, 5, 6}};
+    route.evaluated = {{7, 8, 9}};
+    route.elevations = {{0, 10}, {1, 11}};
+    route.ground_elevations = {{0, 12}};
+    route.speeds = {};
+    route.grades = {{2, 0.5f}};
+    route.time = 12.5f;
+    route.length = 1000.0f;
+    route.route_id = -3;
+    route.solutions = "[[1]]";
+    route.total_fitness = "[2]";
+    route.track_fitness = "[]";
+    route.curve_fitness = "";
+    route.grade_fitness = "[0.5]";
+    route.length_fitness = "[4]";
+
+    std::vector<uint8_t> bytes = BinaryWriter::routeToBinary(route);
+    size_t offset = 0;
+
+    // The header
+    BOOST_REQUIRE(bytes.size() >= 17 * 4);
+    BOOST_CHECK_EQUAL(readWord(bytes, offset), (uint32_t)BINARY_MAGIC);
+    BOOST_CHECK_EQUAL(readFloat(bytes, offset), route.time);
+    BOOST_CHECK_EQUAL(readFloat(bytes, offset), route.length);
+    BOOST_CHECK_EQUAL((int32_t)readWord(bytes, offset), route.route_id);
+
+    const std::vector<glm::vec3>* point3_arrays[] = {&route.controls, &route.evaluated};
+    const std::vector<glm::vec2>* point2_arrays[] = {&route.elevations, &route.ground_elevations,
+                                                     &route.speeds, &route.grades};
+    const std::string* strings[] = {&route.solutions, &route.total_fitness, &route.track_fitness,
+                                    &route.curve_fitness, &route.grade_fitness, &route.length_fitness};
+
+    for (const std::vector<glm::vec3>* points : point3_arrays)
+        BOOST_CHECK_EQUAL(readWord(bytes, offset), points->size());
+
+    for (const std::vector<glm::vec2>* points : point2_arrays)
+        BOOST_CHECK_EQUAL(readWord(bytes, offset), points->size());
+
+    for (const std::string* str : strings)
+        BOOST_CHECK_EQUAL(readWord(bytes, offset), str->size());
+
+    // The arrays, in the same order as the counts
+    for (const std::vector<glm::vec3>* points : point3_arrays)
+        for (const glm::vec3& point : *points)
+            for (int c = 0; c < 3; c++)
+                BOOST_CHECK_EQUAL(readFloat(bytes, offset), point[c]);
+
+    for (const std::vector<glm::vec2>* points : point2_arrays)
+        for (const glm::vec2& point : *points)
+            for (int c = 0; c < 2; c++)
+                BOOST_CHECK_EQUAL(readFloat(bytes, offset), point[c]);
+
+    // Then the strings and nothing else
+    for (const std::string* str : strings) {
+
+        BOOST_CHECK_EQUAL(std::string(bytes.begin() + offset, bytes.begin() + offset + str->size()), *str);
+        offset += str->size();
+
+    }
+
+    BOOST_CHECK_EQUAL(offset, bytes.size());
+
+}
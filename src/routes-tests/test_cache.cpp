@@ -0,0 +1,124 @@
+//
+//  test_cache.cpp
+//  Routes
+//
+
+#include <boost/test/unit_test.hpp>
+#include <cache/cache.h>
+#include <thread>
+
+/** Makes a route that estimateSize puts at about the given number of bytes */
+static std::shared_ptr<const RouteResult> makeResult(size_t bytes) {
+
+    std::shared_ptr<RouteResult> result = std::make_shared<RouteResult>();
+    result->controls.reserve(bytes / sizeof(glm::vec3));
+
+    return result;
+
+}
+
+BOOST_AUTO_TEST_CASE(test_cache_eviction) {
+
+    // One shard so every route competes for the same budget
+    size_t size = ResultCache::estimateSize(*makeResult(1000));
+    ResultCache cache = ResultCache(1, size * 3, std::chrono::seconds(60));
+
+    for (size_t id = 0; id < 3; id++)
+        cache.insert(id, makeResult(1000));
+
+    // Using 0 makes 1 the least recently used, so it goes first
+    BOOST_CHECK(cache.find(0) != nullptr);
+    cache.insert(3, makeResult(1000));
+
+    BOOST_CHECK(cache.find(1) == nullptr);
+    BOOST_CHECK(cache.find(0) != nullptr);
+    BOOST_CHECK(cache.find(2) != nullptr);
+    BOOST_CHECK(cache.find(3) != nullptr);
+
+    ResultCache::Metrics metrics = cache.getMetrics();
+
+    BOOST_CHECK_EQUAL(metrics.evictions, 1u);
+    BOOST_CHECK_EQUAL(metrics.entries, 3u);
+    BOOST_CHECK(metrics.bytes <= size * 3);
+
+}
+
+BOOST_AUTO_TEST_CASE(test_cache_expiry) {
+
+    // Nothing outlives a time to live of 0
+    ResultCache cache = ResultCache(1, 1 << 20, std::chrono::seconds(0));
+
+    cache.insert(0, makeResult(100));
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+    // The old route is at the back so inserting drops it
+    cache.insert(1, makeResult(100));
+
+    BOOST_CHECK_EQUAL(cache.getMetrics().expirations, 1u);
+    BOOST_CHECK_EQUAL(cache.getMetrics().entries, 1u);
+
+    // Looking up an expired route drops it too
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+    BOOST_CHECK(cache.find(1) == nullptr);
+    BOOST_CHECK_EQUAL(cache.getMetrics().expirations, 2u);
+    BOOST_CHECK_EQUAL(cache.getMetrics().entries, 0u);
+
+}
+
+BOOST_AUTO_TEST_CASE(test_cache_shards) {
+
+    // Each shard gets half of the budget, enough for two routes
+    size_t size = ResultCache::estimateSize(*makeResult(1000));
+    ResultCache cache = ResultCache(2, size * 4, std::chrono::seconds(60));
+
+    // Find a couple of ids in each shard
+    std::vector<size_t> ids[2];
+
+    for (size_t id = 0; ids[0].size() < 3 || ids[1].size() < 1; id++) {
+
+        size_t shard = cache.shardOf(id);
+
+        BOOST_REQUIRE(shard < 2);
+        ids[shard].push_back(id);
+
+    }
+
+    cache.insert(ids[1][0], makeResult(1000));
+
+    // Overfilling the first shard only evicts from it
+    for (int i = 0; i < 3; i++)
+        cache.insert(ids[0][i], makeResult(1000));
+
+    BOOST_CHECK(cache.find(ids[0][0]) == nullptr);
+    BOOST_CHECK(cache.find(ids[0][1]) != nullptr);
+    BOOST_CHECK(cache.find(ids[0][2]) != nullptr);
+    BOOST_CHECK(cache.find(ids[1][0]) != nullptr);
+
+    BOOST_CHECK_EQUAL(cache.getMetrics().evictions, 1u);
+
+}
+
+BOOST_AUTO_TEST_CASE(test_cache_contains) {
+
+    size_t size = ResultCache::estimateSize(*makeResult(1000));
+    ResultCache cache = ResultCache(1, size * 2, std::chrono::seconds(60));
+
+    cache.insert(0, makeResult(1000));
+    cache.insert(1, makeResult(1000));
+
+    BOOST_CHECK(cache.contains(0));
+    BOOST_CHECK(!cache.contains(2));
+
+    // Looking doesn't count and doesn't make 0 the most recently used, so it is still the one evicted
+    ResultCache::Metrics metrics = cache.getMetrics();
+
+    BOOST_CHECK_EQUAL(metrics.hits, 0u);
+    BOOST_CHECK_EQUAL(metrics.misses, 0u);
+
+    cache.insert(2, makeResult(1000));
+
+    BOOST_CHECK(!cache.contains(0));
+    BOOST_CHECK(cache.contains(1));
+
+}
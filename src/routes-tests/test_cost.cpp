@@ -0,0 +1,147 @@
+//
+//  test_cost.cpp
+//  Routes
+//
+
+#include <boost/test/unit_test.hpp>
+#include <cost/native_evaluator.h>
+#include <routes.h>
+
+BOOST_AUTO_TEST_CASE(test_cost_backends) {
+
+    const int num_points = 400;
+    const int num_workers = 100;
+    const int pop_size = 16;
+    const int genome_size = 4;
+    const int individual_size = genome_size + 3;
+
+    // Rolling terrain so that every point sees a different elevation
+    glm::ivec2 pixels_size = glm::ivec2(64, 64);
+    std::vector<float> pixels = std::vector<float>((size_t)pixels_size.x * pixels_size.y);
+
+    for (int y = 0; y < pixels_size.y; y++)
+        for (int x = 0; x < pixels_size.x; x++)
+            pixels[y * pixels_size.x + x] = 50.0f + 20.0f * sinf(x / 5.0f) * cosf(y / 7.0f);
+
+    boost::compute::image_format format = boost::compute::image_format(CL_INTENSITY, CL_FLOAT);
+    boost::compute::image2d image = boost::compute::image2d(Kernel::getContext(), pixels_size.x, pixels_size.y, format,
+                                                            CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, pixels.data());
+
+    glm::vec4 start = glm::vec4(100.0f, 100.0f, 60.0f, 0.0f);
+    glm::vec4 dest  = glm::vec4(6000.0f, 5800.0f, 40.0f, 0.0f);
+
+    // Paths that wander around the straight line
+    std::vector<glm::vec4> individuals = std::vector<glm::vec4>((size_t)pop_size * individual_size, glm::vec4(0.0f));
+    std::mt19937 generator = std::mt19937(4);
+    std::normal_distribution<float> noise = std::normal_distribution<float>(0.0f, 1.0f);
+
+    for (int i = 0; i < pop_size; i++) {
+
+        glm::vec4* individual = &individuals[i * individual_size];
+
+        individual[1] = start;
+        individual[individual_size - 1] = dest;
+
+        for (int g = 0; g < genome_size; g++) {
+
+            float s = (g + 1) / (float)(genome_size + 1);
+            individual[2 + g] = glm::mix(start, dest, s) + glm::vec4(400.0f * noise(generator),
+                                                                     400.0f * noise(generator),
+                                                                     30.0f * noise(generator), 0.0f);
+
+        }
+
+    }
+
+    // A bezier curve through every control point
+    std::vector<float> basis = Bezier::calcBernsteinBasis(genome_size + 1, num_points + 1, num_points - 1.0f);
+    std::vector<int> offsets = std::vector<int>(num_points + 1, 0);
+
+    CostParams params;
+    params.path_length = genome_size + 2;
+    params.num_points = num_points;
+    params.num_workers = num_workers;
+    params.max_grade = MAX_SLOPE_GRADE;
+    params.min_curve = 2000.0f;
+    params.excavation_depth = EXCAVATION_DEPTH;
+    params.data_size = glm::vec2(6400.0f, 6400.0f);
+    params.data_origin = glm::vec2(0.0f, 0.0f);
+    params.straight_distance = glm::length(dest - start);
+    params.image = &image;
+    params.pixels = pixels.data();
+    params.pixels_size = pixels_size;
+
+    // Bilinear and bicubic have to read the same pixels with the same weights as the kernel, not just nearest
+    TerrainFilter filters[3] = {TerrainFilter::Nearest, TerrainFilter::Bilinear, TerrainFilter::Bicubic};
+
+    for (TerrainFilter filter : filters) {
+
+        params.filter = filter;
+
+        // Evaluate the same individuals on both backends, in two chunks like a pipelined population
+        std::vector<glm::vec4> results[2] = {individuals, individuals};
+        CostBackend backends[2] = {CostBackend::OpenCL, CostBackend::Native};
+
+        for (int b = 0; b < 2; b++) {
+
+            std::unique_ptr<CostEvaluator> evaluator = CostEvaluator::create(backends[b]);
+
+            evaluator->setIndividuals(results[b].data(), pop_size, individual_size);
+            evaluator->setBasis(basis, offsets, genome_size + 2);
+            evaluator->setParams(params);
+
+            evaluator->enqueue(results[b].data(), 0, pop_size / 2);
+            evaluator->enqueue(results[b].data(), pop_size / 2, pop_size);
+            evaluator->finish();
+
+        }
+
+        // The GPU rounds differently, so a point can land on the other side of a pixel or a penalty threshold.
+        // Hardware bilinear filtering is only accurate to about 1/256 of a pixel, which the track cost tolerance covers
+        for (int i = 0; i < pop_size; i++) {
+
+            glm::vec4 opencl = results[0][i * individual_size];
+            glm::vec4 native = results[1][i * individual_size];
+
+            BOOST_CHECK_CLOSE(opencl.x, native.x, 2.0);
+            BOOST_CHECK_SMALL(opencl.y - native.y, 3.0f / num_points);
+            BOOST_CHECK_SMALL(opencl.z - native.z, 3.0f / num_points);
+            BOOST_CHECK_SMALL(opencl.w - native.w, 0.001f);
+
+        }
+
+    }
+
+    BOOST_CHECK_THROW(CostEvaluator::parseBackend("cuda"), std::runtime_error);
+
+}
+
+BOOST_AUTO_TEST_CASE(test_cost_sampling) {
+
+    // The elevations that are sent back have to be the ones the cost was evaluated on
+    ElevationData data = ElevationData(glm::vec2(-118.9016667,34.9016667),
+                                       glm::vec2(-118.5000,34.08877925439021), 1, false);
+
+    glm::dvec2 origin = glm::dvec2(data.getCroppedOriginMeters());
+    glm::dvec2 size = data.getCroppedSizeMeters();
+
+    TerrainFilter filters[3] = {TerrainFilter::Nearest, TerrainFilter::Bilinear, TerrainFilter::Bicubic};
+
+    for (TerrainFilter filter : filters) {
+
+        // Spots that fall at different places inside of their pixels
+        for (int i = 1; i < 10; i++) {
+
+            glm::dvec2 coord = glm::dvec2(i * 0.0973 + 0.013, 0.9 - i * 0.0871);
+
+            float cpu = data.metersToElevation(origin + coord * size, filter);
+            float native = NativeCostEvaluator::sampleElevation(data.getPixels().data(), data.getPixelSize(),
+                                                                glm::vec2(coord), filter);
+
+            BOOST_CHECK_CLOSE(cpu, native, 0.01);
+
+        }
+
+    }
+
+}
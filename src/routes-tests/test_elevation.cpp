@@ -7,6 +7,7 @@
 
 #define BOOST_TEST_MODULE Routes-Tests
 #include <boost/test/unit_test.hpp>
+#include <limits>
 #include <routes.h>
 
 BOOST_AUTO_TEST_CASE(test_elevation_conversions) {
@@ -69,6 +70,208 @@ BOOST_AUTO_TEST_CASE(test_elevation_sampling) {
     
 }
 
+BOOST_AUTO_TEST_CASE(test_elevation_filtering) {
+
+    // Both filters should go through the pixels themselves
+    float bilinear[4] = {1.0, 2.0, 3.0, 5.0};
+    BOOST_CHECK_CLOSE(ElevationData::interpolate(bilinear, glm::vec2(0.0, 0.0), TerrainFilter::Bilinear), 1.0, 0.001);
+    BOOST_CHECK_CLOSE(ElevationData::interpolate(bilinear, glm::vec2(0.5, 0.5), TerrainFilter::Bilinear), 2.75, 0.001);
+
+    // On a sloped plane the filtered elevation should be exactly the plane
+    float plane[16];
+
+    for (int y = 0; y < 4; y++)
+        for (int x = 0; x < 4; x++)
+            plane[y * 4 + x] = 100.0f + 3.0f * (x - 1) - 2.0f * (y - 1);
+
+    BOOST_CHECK_CLOSE(ElevationData::interpolate(plane, glm::vec2(0.0, 0.0), TerrainFilter::Bicubic), 100.0, 0.001);
+    BOOST_CHECK_CLOSE(ElevationData::interpolate(plane, glm::vec2(0.25, 0.75), TerrainFilter::Bicubic), 99.25, 0.001);
+
+    // Moving across a pixel should never jump
+    float last = ElevationData::interpolate(plane, glm::vec2(0.0, 0.5), TerrainFilter::Bicubic);
+
+    for (int i = 1; i <= 10; i++) {
+
+        float z = ElevationData::interpolate(plane, glm::vec2(i / 10.0f * 0.99f, 0.5), TerrainFilter::Bicubic);
+        BOOST_CHECK_SMALL(z - last - 0.3f * 0.99f, 0.01f);
+        last = z;
+
+    }
+
+    BOOST_CHECK(ElevationData::parseTerrainFilter("bicubic") == TerrainFilter::Bicubic);
+    BOOST_CHECK_THROW(ElevationData::parseTerrainFilter("trilinear"), std::runtime_error);
+
+}
+
+BOOST_AUTO_TEST_CASE(test_elevation_downsample) {
+
+    // A 3x3 image, the last row and column have no neighbor to be averaged with
+    std::vector<float> image = {1.0, 3.0, 5.0,
+                                5.0, 7.0, 9.0,
+                                2.0, 4.0, 8.0};
+    glm::ivec2 size = glm::ivec2(3, 3);
+
+    std::vector<float> half = ElevationData::downsample(image, size);
+    std::vector<float> expected = {4.0, 7.0,
+                                   3.0, 8.0};
+
+    BOOST_CHECK(size == glm::ivec2(2, 2));
+    BOOST_CHECK_EQUAL_COLLECTIONS(half.begin(), half.end(), expected.begin(), expected.end());
+
+    // Keep going down to a single pixel
+    std::vector<float> single = ElevationData::downsample(half, size);
+
+    BOOST_CHECK(size == glm::ivec2(1, 1));
+    BOOST_CHECK_CLOSE(single[0], 5.5, 0.001);
+
+}
+
+BOOST_AUTO_TEST_CASE(test_elevation_extrema) {
+
+    // A crop with a NODATA pixel in it, the way GDAL reads a hole in the data
+    std::vector<float> crop = {120.0, 95.5, -std::numeric_limits<float>::max(),
+                               130.0, 101.0, 88.0,
+                               1e7f, 110.0, 97.0};
+
+    glm::vec2 extrema = ElevationData::findExtrema(crop);
+
+    BOOST_CHECK_CLOSE(extrema.x, 88.0, 0.001);
+    BOOST_CHECK_CLOSE(extrema.y, 130.0, 0.001);
+
+    // Nothing but NODATA gives the same extrema that the old min max kernel did
+    std::vector<float> hole = std::vector<float>(4, -std::numeric_limits<float>::max());
+    extrema = ElevationData::findExtrema(hole);
+
+    BOOST_CHECK(extrema == glm::vec2(ELEVATION_NODATA_LIMIT, -ELEVATION_NODATA_LIMIT));
+
+}
+
+BOOST_AUTO_TEST_CASE(test_elevation_tile_cache) {
+
+    // A raster whose pixels are their own coordinates, with edge tiles that are cut short
+    glm::ivec2 raster_size = glm::ivec2(TILE_SIZE * 2 + 10, TILE_SIZE + 5);
+    int loads = 0;
+
+    TileLoader loader = [&loads](const glm::ivec2& origin, const glm::ivec2& size, float* out) {
+
+        loads++;
+
+        for (int y = 0; y < size.y; y++)
+            for (int x = 0; x < size.x; x++)
+                out[y * size.x + x] = (float)((origin.y + y) * 1000 + origin.x + x);
+
+    };
+
+    // Only room for the four tiles in the upper left
+    size_t budget = (2 * TILE_SIZE * TILE_SIZE + 2 * TILE_SIZE * 5) * sizeof(float);
+    TileCache cache = TileCache(raster_size, budget, loader);
+
+    // A rect across four tiles
+    glm::ivec2 origin = glm::ivec2(TILE_SIZE - 3, TILE_SIZE - 2);
+    glm::ivec2 size = glm::ivec2(6, 4);
+    std::vector<float> pixels = std::vector<float>(size.x * size.y);
+
+    cache.read(origin, size, &pixels[0]);
+    BOOST_CHECK_EQUAL(loads, 4);
+
+    for (int y = 0; y < size.y; y++) {
+        for (int x = 0; x < size.x; x++) {
+            BOOST_CHECK_EQUAL(pixels[y * size.x + x], (float)((origin.y + y) * 1000 + origin.x + x));
+        }
+    }
+
+    // The same area again should not go back to the loader. This only touches the two tiles on the left
+    cache.read(origin + 1, glm::ivec2(2, 2), &pixels[0]);
+    BOOST_CHECK_EQUAL(loads, 4);
+    BOOST_CHECK_EQUAL(cache.getMemoryUsed(), budget);
+
+    // A new tile pushes out the least recently used one, the upper right
+    cache.read(glm::ivec2(TILE_SIZE * 2, 0), glm::ivec2(1, 1), &pixels[0]);
+    BOOST_CHECK_EQUAL(loads, 5);
+    BOOST_CHECK_EQUAL(pixels[0], (float)(TILE_SIZE * 2));
+    BOOST_CHECK(cache.getMemoryUsed() <= budget);
+
+    cache.read(glm::ivec2(0, 0), glm::ivec2(1, 1), &pixels[0]);
+    BOOST_CHECK_EQUAL(loads, 5);
+
+    cache.read(glm::ivec2(TILE_SIZE, 0), glm::ivec2(1, 1), &pixels[0]);
+    BOOST_CHECK_EQUAL(loads, 6);
+
+    BOOST_CHECK_THROW(cache.read(glm::ivec2(0, 0), raster_size + 1, &pixels[0]), std::runtime_error);
+
+}
+
+BOOST_AUTO_TEST_CASE(test_elevation_tile_store) {
+
+    // Write a store by hand, two tiles wide with the second one mostly padding
+    TileStoreHeader header;
+    memset(&header, 0, sizeof(header));
+
+    header.magic = TILE_STORE_MAGIC;
+    header.version = TILE_STORE_VERSION;
+    header.width = TILE_SIZE + 3;
+    header.height = 2;
+    header.tile_size = TILE_SIZE;
+    header.tiles_x = 2;
+    header.tiles_y = 1;
+    header.transform[1] = 1.0;
+
+    std::string path = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+    std::ofstream out = std::ofstream(path, std::ios::binary);
+
+    std::vector<char> index = std::vector<char>(TILE_STORE_DATA_OFFSET, 0);
+    memcpy(&index[0], &header, sizeof(header));
+    out.write(&index[0], index.size());
+
+    // Every pixel is its own coordinates
+    std::vector<float> tile = std::vector<float>(TILE_SIZE * TILE_SIZE);
+
+    for (int tx = 0; tx < 2; tx++) {
+
+        for (int y = 0; y < TILE_SIZE; y++)
+            for (int x = 0; x < TILE_SIZE; x++)
+                tile[y * TILE_SIZE + x] = (float)(y * 1000 + tx * TILE_SIZE + x);
+
+        out.write((const char*)&tile[0], tile.size() * sizeof(float));
+
+    }
+
+    out.close();
+
+    {
+
+        TileStore store = TileStore(path);
+
+        BOOST_CHECK(store.getSize() == glm::ivec2(TILE_SIZE + 3, 2));
+        BOOST_CHECK_EQUAL(store.getTransform()[1], 1.0);
+
+        // Across the edge between the tiles
+        std::vector<float> pixels = std::vector<float>(8);
+        store.read(glm::ivec2(TILE_SIZE - 2, 0), glm::ivec2(4, 2), &pixels[0]);
+
+        for (int y = 0; y < 2; y++) {
+            for (int x = 0; x < 4; x++) {
+                BOOST_CHECK_EQUAL(pixels[y * 4 + x], (float)(y * 1000 + TILE_SIZE - 2 + x));
+            }
+        }
+
+        BOOST_CHECK_THROW(store.read(glm::ivec2(TILE_SIZE, 0), glm::ivec2(4, 1), &pixels[0]), std::runtime_error);
+
+    }
+
+    // A store from another version should not be read
+    header.version = TILE_STORE_VERSION + 1;
+
+    std::fstream patch = std::fstream(path, std::ios::binary | std::ios::in | std::ios::out);
+    patch.write((const char*)&header, sizeof(header));
+    patch.close();
+
+    BOOST_CHECK_THROW(TileStore store = TileStore(path), std::runtime_error);
+
+    boost::filesystem::remove(path);
+
+}
+
 //BOOST_AUTO_TEST_CASE(test_elevation_samplingNE) {
 //
 //    // Load up a fake route to get some data
@@ -0,0 +1,149 @@
+//
+//  test_genetics.cpp
+//  Routes
+//
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+#include <routes.h>
+
+/**
+ * Writes a copy of the params file with some of the values replaced.
+ *
+ * @param name
+ * The name of the copy, it is put in the temporary directory
+ *
+ * @param values
+ * The paths of the values to replace and what to replace them with
+ *
+ * @return
+ * The path of the copy
+ */
+static std::string writeParams(const std::string& name, const std::map<std::string, std::string>& values) {
+
+    boost::property_tree::ptree root;
+    boost::property_tree::read_json(FILE_PATH, root);
+
+    for (const auto& value : values)
+        root.put(value.first, value.second);
+
+    std::string path = (boost::filesystem::temp_directory_path() / name).string();
+    boost::property_tree::write_json(path, root);
+
+    return path;
+
+}
+
+BOOST_AUTO_TEST_CASE(test_genetics_levels) {
+
+    // One level never leaves the full resolution
+    for (int generation = 0; generation < 100; generation++)
+        BOOST_CHECK_EQUAL(Genetics::levelForGeneration(generation, 100, 1, 0.5f), 0);
+
+    // Without coarse generations everything is on the full resolution
+    BOOST_CHECK_EQUAL(Genetics::levelForGeneration(0, 100, 3, 0.0f), 0);
+
+    // The coarsest level comes first and the levels only ever get finer
+    BOOST_CHECK_EQUAL(Genetics::levelForGeneration(0, 100, 3, 0.5f), 2);
+
+    int last = 2;
+
+    for (int generation = 0; generation < 100; generation++) {
+
+        int level = Genetics::levelForGeneration(generation, 100, 3, 0.5f);
+
+        BOOST_CHECK(level >= 0 && level <= last);
+
+        // Past the coarse fraction only the full resolution is used
+        if (generation >= 50)
+            BOOST_CHECK_EQUAL(level, 0);
+
+        // Every coarse level gets an equal share
+        if (generation < 50)
+            BOOST_CHECK_EQUAL(level, generation < 25 ? 2 : 1);
+
+        last = level;
+
+    }
+
+}
+
+BOOST_AUTO_TEST_CASE(test_genetics_pipeline) {
+
+    const int pop_size = 64;
+    const int steps = 3;
+
+    glm::dvec2 start = glm::dvec2(-118.9016667, 34.9016667);
+    glm::dvec2 dest  = glm::dvec2(-118.5000, 34.08877925439021);
+
+    // The native backend evaluates every individual on its own, so chunking can't change a single bit of the cost
+    std::string sequential = writeParams("routes-sequential.json", {{"cost.backend", "native"},
+                                                                    {"population.pipeline-chunks", "1"}});
+    std::string pipelined = writeParams("routes-pipelined.json", {{"cost.backend", "native"},
+                                                                  {"population.pipeline-chunks", "4"}});
+
+    ElevationData data = ElevationData(start, dest, 1, false);
+
+    glm::dvec3 start_meter = data.metersToMetersAndElevation(data.longitudeLatitudeToMeters(start));
+    glm::dvec3 dest_meter  = data.metersToMetersAndElevation(data.longitudeLatitudeToMeters(dest));
+
+    glm::vec4 start_point = glm::vec4(start_meter.x, start_meter.y, start_meter.z + 10.0, 0.0);
+    glm::vec4 dest_point  = glm::vec4(dest_meter.x, dest_meter.y, dest_meter.z + 10.0, 0.0);
+
+    Pod pod = Pod(DEFAULT_POD_MAX_SPEED);
+
+    Population pops[2] = {Population(pop_size, start_point, dest_point, data, Configure(sequential)),
+                          Population(pop_size, start_point, dest_point, data, Configure(pipelined))};
+
+    // Both draw the same Philox streams, the pipelined one just draws them while the last chunk is evaluated
+    for (int step = 0; step < steps; step++) {
+
+        pops[0].step(pod);
+        pops[1].step(pod);
+
+        for (int i = 0; i < pop_size; i++)
+            BOOST_CHECK(*pops[0].getIndividual(i).header == *pops[1].getIndividual(i).header);
+
+        std::vector<glm::vec3> means[2] = {pops[0].getSolution(), pops[1].getSolution()};
+
+        BOOST_REQUIRE_EQUAL(means[0].size(), means[1].size());
+
+        for (size_t p = 0; p < means[0].size(); p++)
+            BOOST_CHECK(means[0][p] == means[1][p]);
+
+    }
+
+    boost::filesystem::remove(sequential);
+    boost::filesystem::remove(pipelined);
+
+}
+
+BOOST_AUTO_TEST_CASE(test_genetics_decomposition_interval) {
+
+    // Roughly the effective selection mass of the default population size
+    float mu_weight = 78.0f;
+
+    int setting = Configure().getDecompositionInterval();
+
+    // The shipped configuration has to skip decompositions for this to save anything
+    BOOST_CHECK_GT(setting, 1);
+
+    // Genomes of 10 to 50 points, the sizes that routes are made with
+    for (int N = 30; N <= 150; N += 3) {
+
+        float c1 = 2.0f / (N * N);
+        float c_mu = mu_weight / (N * N);
+
+        // The CMA-ES rule alone never gets past decomposing every generation for these sizes
+        BOOST_CHECK_EQUAL(Population::decompositionInterval(0, N, c1, c_mu), 1);
+
+        // The configured interval is what actually spaces the decompositions out
+        BOOST_CHECK_EQUAL(Population::decompositionInterval(setting, N, c1, c_mu), setting);
+        BOOST_CHECK_GT(Population::decompositionInterval(setting, N, c1, c_mu), 1);
+
+    }
+
+    // The rule does give a real interval once the search space dwarfs the selection mass
+    BOOST_CHECK_GT(Population::decompositionInterval(0, 10000, 2.0f / 1e8f, mu_weight / 1e8f), 1);
+
+}
@@ -0,0 +1,125 @@
+//
+//  test_json.cpp
+//  Routes
+//
+
+#include <boost/test/unit_test.hpp>
+#include <serialize/json.h>
+
+#include <cstdlib>
+#include <limits>
+
+BOOST_AUTO_TEST_CASE(test_json_compact) {
+
+    JSONWriter writer = JSONWriter(true);
+
+    writer.beginObject();
+    writer.key("id");
+    writer.value(12);
+    writer.key("name");
+    writer.value(std::string("a \"quoted\"\nline"));
+    writer.key("points");
+    writer.value(std::vector<glm::vec2>{{1.5f, -2.0f}, {0.1f, 3.0f}});
+    writer.key("empty");
+    writer.beginArray();
+    writer.endArray();
+    writer.key("solutions");
+    writer.raw("[[]]");
+    writer.endObject();
+
+    BOOST_CHECK_EQUAL(writer.str(), "{\"id\":12,\"name\":\"a \\\"quoted\\\"\\nline\","
+                                    "\"points\":[[1.5,-2],[0.1,3]],\"empty\":[],\"solutions\":[[]]}");
+
+}
+
+BOOST_AUTO_TEST_CASE(test_json_indented) {
+
+    JSONWriter writer = JSONWriter(false);
+
+    writer.beginObject();
+    writer.key("distance");
+    writer.value(2.5f);
+    writer.key("controls");
+    writer.value(std::vector<glm::vec3>{{1, 2, 3}, {4, 5, 6}});
+    writer.endObject();
+
+    BOOST_CHECK_EQUAL(writer.str(), "{\n    \"distance\": 2.5,\n    \"controls\": [\n        [1,2,3],\n"
+                                    "        [4,5,6]\n    ]\n}");
+
+}
+
+BOOST_AUTO_TEST_CASE(test_json_floats) {
+
+    float values[] = {0.1f, 1.0f / 3.0f, -122.41942f, 3.4028235e38f, 1e-30f};
+
+    // Every float should read back exactly
+    for (float value : values) {
+
+        JSONWriter writer = JSONWriter();
+        writer.value(value);
+
+        BOOST_CHECK_EQUAL(std::strtof(writer.str().c_str(), nullptr), value);
+
+    }
+
+    // JSON has no infinity so it becomes null
+    JSONWriter writer = JSONWriter();
+    writer.value(std::numeric_limits<float>::infinity());
+    BOOST_CHECK_EQUAL(writer.str(), "null");
+
+}
+
+BOOST_AUTO_TEST_CASE(test_json_size) {
+
+    // A route is usually about this big
+    std::vector<glm::vec3> evaluated;
+    std::vector<glm::vec2> elevations;
+
+    for (int i = 0; i < 2400; i++) {
+        evaluated.push_back(glm::vec3(-122.41942f + i * 1e-4f, 37.77493f + i * 1e-4f, 12.5f + i));
+        elevations.push_back(glm::vec2(i * 173.2f, 12.5f + i));
+    }
+
+    // The way the server used to build the response
+    std::string JSON = "   [";
+
+    for (int i = 0; i < evaluated.size(); i++) {
+
+        if (i)
+            JSON += "    ";
+
+        JSON += "[" + std::to_string(evaluated[i].x) + ", " +
+                std::to_string(evaluated[i].y) + ", " +
+                std::to_string(evaluated[i].z) + "]";
+
+        if (i != evaluated.size() - 1)
+            JSON += ", \n";
+
+    }
+
+    JSON += "]   [";
+
+    for (int i = 0; i < elevations.size(); i++) {
+
+        if (i)
+            JSON += "    ";
+
+        JSON += "[" + std::to_string(elevations[i].x) + ", " + std::to_string(elevations[i].y) + "]";
+
+        if (i != elevations.size() - 1)
+            JSON += ", \n";
+
+    }
+
+    // The writer
+    JSONWriter writer = JSONWriter(true, evaluated.size() * 40 + elevations.size() * 30);
+
+    writer.beginArray();
+    writer.value(evaluated);
+    writer.value(elevations);
+    writer.endArray();
+
+    // Without the indentation and the fixed six decimals of std::to_string the payload is smaller
+    BOOST_CHECK(writer.str().size() < JSON.size());
+
+}
@@ -20,7 +20,7 @@ BOOST_AUTO_TEST_CASE(test_multinormal) {
                   0.5f, 1.0f, 2.0f;
 
     // Make the objects to sample from
-    SampleGenerator* gen = new SampleGenerator(3, N);
+    SampleGenerator* gen = new SampleGenerator(3, 17);
     MultiNormal normal = MultiNormal(covariance, Eigen::Vector3f(2.0, 2.0, 2.0));
     
     // Generate 10000 _samples
@@ -73,3 +73,110 @@ BOOST_AUTO_TEST_CASE(test_multinormal) {
     delete gen;
     
 }
+
+BOOST_AUTO_TEST_CASE(test_multinormal_factor) {
+
+    // Any factor of the covariance matrix should give the same distribution, not just the Cholesky one
+    Eigen::Matrix3f covariance;
+    covariance << 2.0f, 1.0f, 0.5f,
+                  1.0f, 2.0f, 1.0f,
+                  0.5f, 1.0f, 2.0f;
+
+    Eigen::SelfAdjointEigenSolver<Eigen::MatrixXf> solver(covariance);
+    Eigen::MatrixXf factor = solver.eigenvectors() * solver.eigenvalues().cwiseSqrt().asDiagonal();
+
+    SampleGenerator* gen = new SampleGenerator(3, 17);
+    MultiNormal normal = MultiNormal::fromFactor(factor, Eigen::Vector3f(2.0, 2.0, 2.0));
+
+    std::vector<Eigen::VectorXf> samples(N);
+
+    for (int i = 0; i < N; i++)
+        samples[i] = Eigen::VectorXf::Zero(3);
+
+    normal.generateRandomSamples(samples, *gen);
+
+    Eigen::Matrix3f covariance_prime;
+    covariance_prime.setZero();
+
+    for (int i = 0; i < N; i++)
+        covariance_prime += samples[i] * samples[i].transpose();
+
+    covariance_prime /= N;
+
+    // The step size scales every component by 2, so the covariance by 4
+    for (int r = 0; r < 3; r++)
+        for (int c = 0; c < 3; c++)
+            BOOST_CHECK_CLOSE(covariance_prime(r, c), covariance(r, c) * 4.0f, 5);
+
+    delete gen;
+
+}
+
+BOOST_AUTO_TEST_CASE(test_multinormal_matrix) {
+
+    // Transforming a matrix of samples at once should match transforming each sample on its own
+    Eigen::Matrix3f covariance;
+    covariance << 2.0f, 1.0f, 0.5f,
+                  1.0f, 2.0f, 1.0f,
+                  0.5f, 1.0f, 2.0f;
+
+    MultiNormal normal = MultiNormal(covariance, Eigen::Vector3f(2.0, 1.0, 0.5));
+
+    // An odd number of samples so the last worker gets the remainder
+    Eigen::MatrixXf samples = Eigen::MatrixXf::Random(3, 101);
+    std::vector<Eigen::VectorXf> vectors(samples.cols());
+
+    for (int i = 0; i < samples.cols(); i++)
+        vectors[i] = samples.col(i);
+
+    normal.transformSamples(samples, 4);
+    normal.transformSamples(vectors, 4);
+
+    for (int i = 0; i < samples.cols(); i++)
+        for (int c = 0; c < 3; c++)
+            BOOST_CHECK_SMALL(samples(c, i) - vectors[i](c), 1e-5f);
+
+}
+
+BOOST_AUTO_TEST_CASE(test_multinormal_philox) {
+
+    // Known answers from the Random123 reference implementation
+    uint32_t zero_counter[4] = {0, 0, 0, 0};
+    uint32_t zero_key[2] = {0, 0};
+    uint32_t pi_counter[4] = {0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344};
+    uint32_t pi_key[2] = {0xa4093822, 0x299f31d0};
+    uint32_t out[4];
+
+    SampleGenerator::philox(zero_counter, zero_key, out);
+
+    BOOST_CHECK_EQUAL(out[0], 0x6627e8d5u);
+    BOOST_CHECK_EQUAL(out[1], 0xe169c58du);
+    BOOST_CHECK_EQUAL(out[2], 0xbc57ac4cu);
+    BOOST_CHECK_EQUAL(out[3], 0x9b00dbd8u);
+
+    SampleGenerator::philox(pi_counter, pi_key, out);
+
+    BOOST_CHECK_EQUAL(out[0], 0xd16cfe09u);
+    BOOST_CHECK_EQUAL(out[1], 0x94fdccebu);
+    BOOST_CHECK_EQUAL(out[2], 0x5001e420u);
+    BOOST_CHECK_EQUAL(out[3], 0x24126ea1u);
+
+    // Filling doesn't depend on the number of threads, and different streams give different samples
+    SampleGenerator gen = SampleGenerator(7, 42);
+
+    Eigen::MatrixXf one = Eigen::MatrixXf(7, 1001);
+    Eigen::MatrixXf many = Eigen::MatrixXf(7, 1001);
+    Eigen::MatrixXf other = Eigen::MatrixXf(7, 1001);
+
+    gen.fill(one, 3, 1);
+    gen.fill(many, 3, 6);
+    gen.fill(other, 4, 6);
+
+    BOOST_CHECK(one == many);
+    BOOST_CHECK(one != other);
+
+    // The samples should be standard normal
+    BOOST_CHECK_SMALL(one.mean(), 0.05f);
+    BOOST_CHECK_CLOSE(one.squaredNorm() / one.size(), 1.0f, 5);
+
+}
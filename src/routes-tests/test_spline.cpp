@@ -55,6 +55,198 @@ BOOST_AUTO_TEST_CASE(test_spline_CPU) {
     
 }
 
+BOOST_AUTO_TEST_CASE(test_spline_sparse_basis) {
+
+    std::vector<glm::vec3> controls = {glm::vec3(-1.75, -1.0, 0.0),
+                                       glm::vec3(-1.5, -0.5, 0.2),
+                                       glm::vec3(-1.5, 0.0, 0.4),
+                                       glm::vec3(-1.25, 0.5, 0.1),
+                                       glm::vec3(-0.75, 0.75, 0.0),
+                                       glm::vec3( 0.0, 0.5, -0.3),
+                                       glm::vec3( 0.5, 0.0, 0.0)};
+
+    std::vector<float> knots = Spline::generateClampedKnots(7, 3);
+    std::vector<float> expected_knots = {0, 0, 0, 0, 0.25, 0.5, 0.75, 1, 1, 1, 1};
+    BOOST_CHECK_EQUAL_COLLECTIONS(knots.begin(), knots.end(), expected_knots.begin(), expected_knots.end());
+
+    std::vector<float> weights;
+    std::vector<int> offsets;
+    Spline::calcSparseBasis(7, 11, 10.0f, weights, offsets);
+
+    BOOST_CHECK_EQUAL(weights.size(), 44);
+
+    for (int p = 0; p < 11; p++) {
+
+        // Only four control points should be needed to get the same point as the full evaluation
+        glm::vec3 point = glm::vec3(0.0, 0.0, 0.0);
+
+        for (int i = 0; i < 4; i++)
+            point += controls[offsets[p] + i] * weights[p * 4 + i];
+
+        glm::vec3 expected = Spline::evaluateSpline(controls, knots, p / 10.0f);
+
+        BOOST_CHECK_SMALL(point.x - expected.x, 1e-4f);
+        BOOST_CHECK_SMALL(point.y - expected.y, 1e-4f);
+        BOOST_CHECK_SMALL(point.z - expected.z, 1e-4f);
+
+    }
+
+    // With too few control points for a cubic the spline is the bezier curve
+    std::vector<glm::vec3> short_controls = {glm::vec3(0.0, 0.0, 0.0), glm::vec3(0.4, 2.1, 0.2), glm::vec3(1.0, 1.0, 1.0)};
+    std::vector<glm::vec3> spline = Spline::evaluateEntireCurve(short_controls, 5, CurveType::BSpline);
+    std::vector<glm::vec3> bezier = Spline::evaluateEntireCurve(short_controls, 5, CurveType::Bezier);
+
+    for (int p = 0; p < 5; p++) {
+        BOOST_CHECK_SMALL(spline[p].x - bezier[p].x, 1e-4f);
+        BOOST_CHECK_SMALL(spline[p].y - bezier[p].y, 1e-4f);
+        BOOST_CHECK_SMALL(spline[p].z - bezier[p].z, 1e-4f);
+    }
+
+}
+
+/**
+ * Evaluates a B-Spline basis function with the recursive Cox-de Boor formula. This is slow, but it shares nothing with
+ * the evaluation in Spline so it is a fair reference.
+ *
+ * @param knots
+ * The knot vector
+ *
+ * @param i
+ * The index of the basis function
+ *
+ * @param p
+ * The degree of the basis function
+ *
+ * @param t
+ * The value to evaluate at
+ *
+ * @return
+ * The value of the basis function at t
+ */
+static double coxDeBoor(const std::vector<float>& knots, int i, int p, double t) {
+
+    if (!p) {
+
+        // The spans are half open, except the last one which has to hold the end of the curve
+        bool last_span = knots[i] < knots[i + 1] && knots[i + 1] == knots.back();
+
+        return (knots[i] <= t && t < knots[i + 1]) || (last_span && t == knots.back()) ? 1.0 : 0.0;
+
+    }
+
+    // Terms with a zero length span are dropped
+    double left  = knots[i + p] - knots[i];
+    double right = knots[i + p + 1] - knots[i + 1];
+
+    double value = 0.0;
+
+    if (left != 0.0)
+        value += (t - knots[i]) / left * coxDeBoor(knots, i, p - 1, t);
+
+    if (right != 0.0)
+        value += (knots[i + p + 1] - t) / right * coxDeBoor(knots, i + 1, p - 1, t);
+
+    return value;
+
+}
+
+/**
+ * Evaluates a B-Spline as the sum of every control point times its basis function.
+ *
+ * @param controls
+ * The control points
+ *
+ * @param knots
+ * The knot vector, the degree is taken from how many knots there are
+ *
+ * @param t
+ * The value to evaluate at
+ *
+ * @return
+ * The point on the curve
+ */
+static glm::dvec3 referenceSpline(const std::vector<glm::vec3>& controls, const std::vector<float>& knots, double t) {
+
+    int degree = (int)knots.size() - (int)controls.size() - 1;
+
+    glm::dvec3 point = glm::dvec3(0.0);
+
+    for (int i = 0; i < (int)controls.size(); i++)
+        point += glm::dvec3(controls[i]) * coxDeBoor(knots, i, degree, t);
+
+    return point;
+
+}
+
+BOOST_AUTO_TEST_CASE(test_spline_batch) {
+
+    std::vector<glm::vec3> controls = {glm::vec3(-1.75, -1.0, 0.0),
+                                       glm::vec3(-1.5, -0.5, 0.0),
+                                       glm::vec3(-1.5, 0.0, 0.0),
+                                       glm::vec3(-1.25, 0.5, 0.0),
+                                       glm::vec3(-0.75, 0.75, 0.0),
+                                       glm::vec3( 0.0, 0.5, 0.0),
+                                       glm::vec3( 0.5, 0.0, 0.0)};
+
+    std::vector<float> knots = {0, 0, 0, 0, 0.25, 0.5, 0.75, 1, 1, 1, 1};
+
+    // Out of order values have to be found again instead of walked to
+    std::vector<float> ts = {0.0, 0.1, 0.25, 0.4, 0.6, 0.9, 1.0, 0.3, 0.05, 0.75};
+    std::vector<glm::vec3> points = Spline::evaluateSplineBatch(controls, knots, ts);
+
+    BOOST_CHECK_EQUAL(points.size(), ts.size());
+
+    for (size_t i = 0; i < ts.size(); i++) {
+
+        glm::dvec3 expected = referenceSpline(controls, knots, ts[i]);
+
+        BOOST_CHECK_SMALL(points[i].x - expected.x, 1e-5);
+        BOOST_CHECK_SMALL(points[i].y - expected.y, 1e-5);
+        BOOST_CHECK_SMALL(points[i].z - expected.z, 1e-5);
+
+    }
+
+    VEC_CLOSE_EQUAL(points[3], glm::vec3(-1.33833, 0.288333, 0.0), 1);
+    VEC_CLOSE_EQUAL(points[6], glm::vec3(0.5, 0.0, 0.0), 1);
+
+    // The first derivative should match a central difference
+    std::vector<float> inner = {0.1, 0.3, 0.55, 0.8};
+    std::vector<glm::vec3> tangents = Spline::evaluateSplineDerivativeBatch(controls, knots, inner);
+
+    for (size_t i = 0; i < inner.size(); i++) {
+
+        float h = 0.001f;
+        glm::vec3 difference = (Spline::evaluateSpline(controls, knots, inner[i] + h) -
+                                Spline::evaluateSpline(controls, knots, inner[i] - h)) / (2.0f * h);
+
+        BOOST_CHECK_CLOSE(tangents[i].x, difference.x, 1);
+        BOOST_CHECK_CLOSE(tangents[i].y, difference.y, 1);
+
+    }
+
+    // A curve of degree n is a bezier curve, whose ends have known derivatives
+    std::vector<glm::vec3> bezier = {glm::vec3(0.0, 0.0, 0.0),
+                                     glm::vec3(1.0, 2.0, 0.0),
+                                     glm::vec3(3.0, 2.0, 1.0),
+                                     glm::vec3(4.0, 0.0, 1.0)};
+
+    knots = {0, 0, 0, 0, 1, 1, 1, 1};
+    std::vector<float> ends = {0.0, 1.0};
+
+    tangents = Spline::evaluateSplineDerivativeBatch(bezier, knots, ends);
+    VEC_CLOSE_EQUAL(tangents[0], 3.0f * (bezier[1] - bezier[0]), 0.001);
+    VEC_CLOSE_EQUAL(tangents[1], 3.0f * (bezier[3] - bezier[2]), 0.001);
+
+    std::vector<glm::vec3> second = Spline::evaluateSplineDerivativeBatch(bezier, knots, ends, 2);
+    VEC_CLOSE_EQUAL(second[0], 6.0f * (bezier[2] - 2.0f * bezier[1] + bezier[0]), 0.001);
+    VEC_CLOSE_EQUAL(second[1], 6.0f * (bezier[3] - 2.0f * bezier[2] + bezier[1]), 0.001);
+
+    // Past the degree there is nothing left
+    std::vector<glm::vec3> fourth = Spline::evaluateSplineDerivativeBatch(bezier, knots, ends, 4);
+    BOOST_CHECK(fourth[0] == glm::vec3(0.0f) && fourth[1] == glm::vec3(0.0f));
+
+}
+
 BOOST_AUTO_TEST_CASE(test_spline_GPU) {
     
     const boost::compute::context& ctx = Kernel::getContext();
@@ -160,7 +352,9 @@ BOOST_AUTO_TEST_CASE(test_spline_GPU) {
     boost::compute::vector<glm::vec4> buffer = boost::compute::vector<glm::vec4>(1, ctx);
     std::vector<glm::vec4> buffer_CPU = std::vector<glm::vec4>(1);
     
-    std::vector<int> coeff_CPU = Bezier::getBinomialCoefficients(2);
+    // The kernel takes integers, which are exact for a degree this small
+    const std::vector<double>& binoms = Bezier::getBinomialCoefficients(2);
+    std::vector<int> coeff_CPU = std::vector<int>(binoms.begin(), binoms.end());
     boost::compute::vector<int> coeff = boost::compute::vector<int>(coeff_CPU.size(), ctx);
     
     boost::compute::copy(coeff_CPU.begin(), coeff_CPU.end(), coeff.begin(), queue);